@@ -1,5 +1,14 @@
 #include "Compositor.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #define RETURN_ERR(T) {Compositor::m_lastError=(T);return false;}
 #define RETURN_OK()	  {Compositor::m_lastError=NONE;return true;}
 
@@ -11,11 +20,42 @@ Compositor::Compositor()
 {
 //	glGenFramebuffers(1, &m_fboID);
 
+	initializeCapabilities();
 	initializeVertexShader();
 	initializeBufferObject();
 	setResolution(512, 512);
-	m_passes.clear();
-	m_pipelines.clear();
+	m_uniformStaging = false;
+	m_programCacheDirectory.clear();
+	resetProgramCacheStats();
+	m_uniformBlocksVersion = 0;
+	m_uniformRing = 0;
+	m_uniformRingMapped = nullptr;
+	m_uniformRingSegmentSize = 0;
+	for (int i = 0; i < UNIFORM_RING_SEGMENTS; i++)
+		m_uniformRingFences[i] = 0;
+	m_readbacks.clear();
+	setReadbackRingSize(3);
+	m_nextReadbackID = 0;
+	m_pendingPolicy = PENDING_SKIP;
+	m_passthroughProgram = 0;
+	m_passthroughShader = 0;
+	m_layerProgram = 0;
+	m_layerVertexShader = 0;
+	m_layerFragmentShader = 0;
+	m_layerMaskLocation = -1;
+	m_batchVertexShader = 0;
+	m_batchGeometryShader = 0;
+	m_resourceState = -1;
+	m_resourceHasBuilt = false;
+	m_resourceJobsInFlight = 0;
+	m_nextResourceJobID = 0;
+	m_passesVersion = 0;
+	m_globalVersion = 0;
+	m_nextTransientID = 0;
+	m_pool.clear();
+	m_stateMode = STATE_FULL_RESTORE;
+	invalidateStateCache();
+	resetStateStats();
 	m_shaderErrorString = "";
 
 }
@@ -26,12 +66,33 @@ Compositor::Compositor()
 ///
 Compositor::~Compositor()
 {
+	stopResourceThread();
 	glDeleteShader(m_shaderVertex);
-	while (m_passes.size() > 0)
-		deletePass(m_passes.begin()->first);
+	for (size_t i = 0; i < m_passes.slotCount(); i++)
+		if (m_passes.at(i) != nullptr) deletePass(m_passes.handleAt(i));
 
 	glDeleteBuffers(1, &m_vertexBuffer);
 	glDeleteVertexArrays(1, &m_vertexArray);
+	for (size_t i = 0; i < m_pool.size(); i++)
+		glDeleteTextures(1, &m_pool[i].texture);
+	std::map<std::string, fusedProgram>::iterator f;
+	for (f = m_fusedPrograms.begin(); f != m_fusedPrograms.end(); ++f)
+		deleteProgram(f->second.program, f->second.fragmentShader);
+	deleteProgram(m_passthroughProgram, m_passthroughShader);
+	deleteProgram(m_layerProgram, m_layerFragmentShader);
+	glDeleteShader(m_layerVertexShader);
+	glDeleteShader(m_batchVertexShader);
+	glDeleteShader(m_batchGeometryShader);
+	deleteUniformRing();
+	deleteReadbacks();
+	for (size_t i = 0; i < m_streams.slotCount(); i++)
+		if (m_streams.at(i) != nullptr) deleteStreamTexture(m_streams.handleAt(i));
+	for (size_t i = 0; i < m_pipelines.slotCount(); i++)
+		if (m_pipelines.at(i) != nullptr)
+		{
+			deleteTimings(*m_pipelines.at(i));
+			deleteFrames(*m_pipelines.at(i), true);
+		}
 
 //	glDeleteFramebuffers(1, &m_fboID);
 }
@@ -56,6 +117,48 @@ std::string Compositor::getLastShaderError()
 {
 	return m_shaderErrorString;
 }
+///
+/// \brief To enable the program binary cache.
+/// To enable the program binary cache in an existing directory, or disable it with NULL. 
+/// Linked programs are saved there with glGetProgramBinary and loaded with glProgramBinary the next time the same shader is loaded, 
+/// instead of compiling it. Cache files are keyed by the fragment shader source, the vertex shader source, and the driver vendor, 
+/// renderer and version. Returns Compositor::PROGRAM_BINARY_NOT_SUPPORTED if the driver has no program binary format.
+///
+bool Compositor::setProgramCache(const char* directory)
+{
+	if (directory == NULL || directory[0] == '\0')
+	{
+		m_programCacheDirectory.clear();
+		RETURN_OK()
+	}
+	if (m_programBinaryFormats.empty()) RETURN_ERR(Compositor::PROGRAM_BINARY_NOT_SUPPORTED)
+
+	m_programCacheDirectory = directory;
+	RETURN_OK()
+}
+
+///
+/// \brief To get the counters of the program binary cache.
+/// To get the hits, misses and time saved by the program binary cache since the last reset.
+///
+Compositor::programCacheStats Compositor::getProgramCacheStats()
+{
+	return m_programCacheStats;
+}
+
+///
+/// \brief To reset the counters of the program binary cache.
+/// To reset the counters of the program binary cache.
+///
+void Compositor::resetProgramCacheStats()
+{
+	m_programCacheStats.hits = 0;
+	m_programCacheStats.misses = 0;
+	m_programCacheStats.rejected = 0;
+	m_programCacheStats.secondsCompiling = 0.0;
+	m_programCacheStats.secondsSaved = 0.0;
+}
+
 ///
 /// \brief To create a new pass.
 /// To To create a new pass.
@@ -69,1019 +172,6256 @@ void Compositor::setResolution(int w, int h)
 
 ///
 /// \brief To create a new pass.
-/// To To create a new pass.
+/// To To create a new pass. Returns -1 with PASS_LIMIT_REACHED if no pass slot is left.
 ///
 int Compositor::createNewPass()
 {
-	static int passID = -1;
-	GLuint fboID;
 	pass newPass;
 
-	++passID;
-
 	newPass.initialized = false;
+	newPass.compute = false;
+	newPass.workGroupSize[0] = 1;
+	newPass.workGroupSize[1] = 1;
+	newPass.layered = false;
+	newPass.layerArray = 0;
+	newPass.layerBuffer = 0;
+	newPass.batchSize = 0;
+	newPass.arrayUnits = 0;
+	newPass.sizeScale = 1.0f;
+	newPass.fixedWidth = 0;
+	newPass.fixedHeight = 0;
+	newPass.kernelRadius = 0;
+	newPass.uniformChanges = 0;
+	newPass.memoValid = false;
+	newPass.discards = false;
+	newPass.actions.clearAll = false;
+	newPass.version = ++m_passesVersion;
+	newPass.actionsVersion = newPass.version - 1;
+	newPass.renderedFbo = 0;
 	newPass.texInputs.clear();
 	newPass.texOutputs.clear();
-	newPass.texOutputsChannels = nullptr;
+	newPass.drawBufferCount = 0;
 	newPass.shaderFragment = 0;
 	newPass.shaderProgram = 0;
+	newPass.hasDirtyUniforms = false;
+	newPass.pending = false;
+	newPass.failed = false;
 	glGenFramebuffers(1, &newPass.fbo);
-	m_passes[passID] = newPass;
+	int passID = m_passes.insert(newPass);
+	if (passID < 0)
+	{
+		glDeleteFramebuffers(1, &newPass.fbo);
+		m_lastError = Compositor::PASS_LIMIT_REACHED;
+		return -1;
+	}
 
 	m_lastError = Compositor::NONE;
 	return passID;
 }
 
 ///
-/// \brief To load fragment shader to be used for doing compositing.
-/// To load fragment shader to be used for doing compositing.
+/// \brief To create a new compute pass.
+/// To create a new pass whose shader is a compute shader. Inputs are set with setUniformTexture() for samplers and image uniforms, 
+/// and the texture of output channel N is bound to image unit N. One invocation runs per pixel of the resolution, rounded up to whole 
+/// work groups. Returns -1 if compute shaders are not supported (OpenGL 4.3 or ARB_compute_shader).
 ///
-bool Compositor::loadShader(int passID, char* filename)
+int Compositor::createComputePass()
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) { m_lastError = Compositor::PASS_NOT_FOUND;  return false; }
-	else
-	{
-		//parts of this are taken from http://www.opengl-tutorial.org/beginners-tutorials/tutorial-2-the-first-triangle/
-		GLuint newShader = glCreateShader(GL_FRAGMENT_SHADER);
-		std::string FragmentShaderCode;
-		std::ifstream FragmentShaderStream(filename, std::ios::in);
-		if (FragmentShaderStream.is_open())
-		{
-			std::string Line = "";
-			while (getline(FragmentShaderStream, Line))
-				FragmentShaderCode += "\n" + Line;
-			FragmentShaderStream.close();
-		}
-		else RETURN_ERR(SHADER_FILE_NOT_FOUND);
+	if (!m_hasCompute) { m_lastError = Compositor::PASS_COMPUTE_NOT_SUPPORTED; return -1; }
 
-		char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-		glShaderSource(newShader, 1, &FragmentSourcePointer, NULL);
-		glCompileShader(newShader);
+	int passID = createNewPass();
+	if (passID < 0) return -1;
+	m_passes[passID].compute = true;
+	return passID;
+}
 
-		GLint Result;
-		glGetShaderiv(newShader, GL_COMPILE_STATUS, &Result);
-		if (Result == GL_FALSE)
-		{
-			GLchar msg[1024]; GLsizei length;
-			glGetShaderInfoLog(newShader, 1024, &length, msg);
-			m_shaderErrorString = std::string(msg);
-			RETURN_ERR(Compositor::SHADER_COMPILE_FAIL)
-		}
-		GLuint newProgram = glCreateProgram();
-		glAttachShader(newProgram, m_shaderVertex);
-		glAttachShader(newProgram, newShader);
-		glLinkProgram(newProgram);
-		glGetProgramiv(newProgram, GL_LINK_STATUS, &Result);
-		if (Result == GL_FALSE)
-		{
-			glDeleteProgram(newProgram);
-			RETURN_ERR(Compositor::SHADER_LINKING_FAIL)
-		}
+///
+/// \brief To create a new layer pass.
+/// To create a pass which composites layers (e.g. video planes, overlays, subtitles) into its outputs, instead of running a 
+/// fragment shader over them. Layers are set with setLayers() and their textures with setLayerTexture(), and all layers are 
+/// drawn with one instanced draw per blend mode. Outputs are cleared to (0, 0, 0, 1) first by default. Shaders cannot be loaded 
+/// into a layer pass.
+///
+int Compositor::createLayerPass()
+{
+	if (m_layerProgram == 0 && !initializeLayerProgram()) return -1;
 
-		//need to bind the VAO and array buffer to the vPos in the vertex shader
-		GLint bufferVertexArray, bufferArrayBuffer;
-		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &bufferVertexArray);
-		glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &bufferArrayBuffer);
+	int passID = createNewPass();
+	if (passID < 0) return -1;
+	pass& p = m_passes[passID];
+	p.layered = true;
+	p.discards = true;		//layers do not have to cover the outputs
+	p.shaderProgram = m_layerProgram;
+	p.initialized = true;
+	reflectUniforms(p);
 
-		glBindVertexArray(m_vertexArray);
-		glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	GLint bufferVertexArray, bufferArrayBuffer;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &bufferVertexArray);
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &bufferArrayBuffer);
 
-		GLint uni_vpos = -1;
-		uni_vpos = glGetAttribLocation(newProgram, "vPos");
-		glVertexAttribPointer(uni_vpos, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-		glEnableVertexAttribArray(uni_vpos);
+	glGenVertexArrays(1, &p.layerArray);
+	glGenBuffers(1, &p.layerBuffer);
+	glBindVertexArray(p.layerArray);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, p.layerBuffer);
+	for (GLuint a = 1; a <= 3; a++)
+	{
+		glVertexAttribPointer(a, a == 3 ? 2 : 4, GL_FLOAT, GL_FALSE, LAYER_FLOATS * sizeof(GLfloat), (void*)((a - 1) * 4 * sizeof(GLfloat)));
+		glEnableVertexAttribArray(a);
+		glVertexAttribDivisor(a, 1);
+	}
 
-		glBindVertexArray(bufferVertexArray);
-		glBindBuffer(GL_ARRAY_BUFFER, bufferArrayBuffer);
+	glBindVertexArray(bufferVertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, bufferArrayBuffer);
+	return passID;
+}
 
-		p->second.shaderFragment = newShader;
-		p->second.shaderProgram = newProgram;
-		p->second.initialized = true;
+///
+/// \brief To set a texture of a layer pass.
+/// To set the texture which layers of a layer pass with the given texture index (0 to MAX_LAYER_TEXTURES - 1) sample. 
+/// Textures may have different sizes. Layers whose texture index is not set are not drawn.
+///
+bool Compositor::setLayerTexture(int passID, int index, GLuint texID)
+{
+	if (index < 0 || index >= MAX_LAYER_TEXTURES) return false;
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+	if (!p->layered) RETURN_ERR(Compositor::PASS_WRONG_KIND)
 
-		RETURN_OK()
-	}
+	std::string name = "layer" + std::to_string(index);
+	return setUniformTexture(passID, &name[0], texID);
 }
 
 ///
-/// \brief To delete new pass.
-/// To delete a pass.
+/// \brief To set the layers of a layer pass.
+/// To set the layers a layer pass draws, replacing the previous ones. Layers are sorted by depth, and layers of the same depth by 
+/// blend mode, then uploaded as per-layer vertex attributes, so each run of layers with the same blend mode is one instanced draw. 
+/// Texture colors are taken as not premultiplied. The layers are copied, the array can be freed afterwards. Returns false, keeping 
+/// the previous layers, if a layer has an unknown blend mode or a texture index out of range.
 ///
-bool Compositor::deletePass(int passID)
+bool Compositor::setLayers(int passID, const layer* layers, int count)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+	if (!p->layered) RETURN_ERR(Compositor::PASS_WRONG_KIND)
+	if (count < 0 || (count > 0 && layers == nullptr)) return false;
+	for (int i = 0; i < count; i++)
+		if (layers[i].blend < BLEND_NORMAL || layers[i].blend > BLEND_SCREEN || layers[i].texture < 0 || layers[i].texture >= MAX_LAYER_TEXTURES) return false;
+
+	std::vector<std::pair<std::pair<int, int>, int>> order(count);		//depth and blend mode, then index in layers
+	for (int i = 0; i < count; i++) order[i] = std::make_pair(std::make_pair(layers[i].depth, (int)layers[i].blend), i);
+	std::sort(order.begin(), order.end());
+
+	std::vector<GLfloat> attributes(count * LAYER_FLOATS);
+	p->layerBatches.clear();
+	for (int i = 0; i < count; i++)
 	{
-		//clear everything inside p->second here
-		glDetachShader(p->second.shaderProgram, m_shaderVertex);
-		glDetachShader(p->second.shaderProgram, p->second.shaderFragment);
-		glDeleteShader(p->second.shaderFragment);
-		glDeleteProgram(p->second.shaderProgram);
-		glDeleteFramebuffers(1, &p->second.fbo);
-		if (p->second.texOutputsChannels != nullptr) delete[] p->second.texOutputsChannels;
-		//finally delete the pass here
-		m_passes.erase(p);
+		const layer& l = layers[order[i].second];
+		GLfloat* a = &attributes[i * LAYER_FLOATS];
+		memcpy(a, l.rect, sizeof(l.rect));
+		memcpy(a + 4, l.uvTransform, sizeof(l.uvTransform));
+		a[8] = l.opacity;
+		a[9] = (GLfloat)l.texture;
+		if (p->layerBatches.empty() || p->layerBatches.back().blend != l.blend)
+		{
+			layerBatch batch;
+			batch.blend = l.blend;
+			batch.first = i;
+			batch.count = 0;
+			p->layerBatches.push_back(batch);
+		}
+		++p->layerBatches.back().count;
 	}
+
+	GLint bufferArrayBuffer;
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &bufferArrayBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, p->layerBuffer);
+	glBufferData(GL_ARRAY_BUFFER, attributes.size() * sizeof(GLfloat), attributes.empty() ? NULL : &attributes[0], GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, bufferArrayBuffer);
+	++p->uniformChanges;
+
 	RETURN_OK()
 }
 
 ///
-/// \brief Render the specified pass.
-/// Render the specified pass.
+/// \brief To create a new batch pass.
+/// To create a pass which renders the same shader over a batch of images in one draw: its outputs are array textures (all layers 
+/// attached), and one instance of the quad is drawn into each of the first images layers. The fragment shader reads the layer of 
+/// the image with "flat in int in_layer;", typically to sample array inputs (sampler2DArray) at vec3(in_uv, in_layer) and to index 
+/// per-image parameters in a uniform block. Returns -1 if the batch shaders cannot be built.
 ///
-bool Compositor::renderPass(int passID)
+int Compositor::createBatchPass(int images)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
+	if (images <= 0) return -1;
+	if (m_batchVertexShader == 0)
 	{
-		if (p->second.initialized == false) RETURN_ERR(Compositor::PASS_PROGRAM_NOT_INITIALIZED)
-		if (p->second.texOutputs.size() == 0) RETURN_ERR(Compositor::PASS_OUTPUT_NOT_FOUND)
-
-		pushState();
-
-		renderPassInternal(p);
-
-		popState();
+		//created before the resource thread starts, as the resource thread reads them
+		if (m_resourceThread.joinable()) { m_lastError = Compositor::SHADER_COMPILE_FAIL; return -1; }
+		if (!initializeBatchShaders()) return -1;
 	}
-	RETURN_OK()
+
+	int passID = createNewPass();
+	if (passID < 0) return -1;
+	m_passes[passID].batchSize = images;
+	return passID;
 }
 
 ///
-/// \brief To create a new pipeline, which is a list of sequential passes.
-/// To To create a new pipeline, which is a list of sequential passes.
+/// \brief To set the number of images of a batch pass.
+/// To set the number of images (layers of the outputs, from 0) rendered by a batch pass, e.g. for the last batch of a job, which may 
+/// be smaller. The outputs must have at least that many layers.
 ///
-int Compositor::createSequentialPipeline()
+bool Compositor::setBatchSize(int passID, int images)
 {
-	static int seqID = -1;
-	++seqID;
+	if (images <= 0) return false;
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+	if (p->batchSize == 0) RETURN_ERR(Compositor::PASS_WRONG_KIND)
 
-	std::vector<int> emptyPasses;
-	emptyPasses.clear();
-	m_pipelines[seqID] = emptyPasses;
+	if (p->batchSize != images)
+	{
+		p->batchSize = images;
+		changePass(*p);
+	}
 
-	m_lastError = Compositor::NONE;
-	return seqID;
+	RETURN_OK()
 }
 
 ///
-/// \brief To set passes of a pipeline.
-/// To set passes of a pipeline.
+/// \brief To load fragment shader to be used for doing compositing.
+/// To load fragment shader to be used for doing compositing.
 ///
-bool Compositor::setPipeline(int id, std::vector<int> inputPasses)
+bool Compositor::loadShader(int passID, char* filename)
 {
-	std::map<int, std::vector<int>>::iterator p = m_pipelines.find(id);
-	if (p == m_pipelines.end()) RETURN_ERR(Compositor::PIPELINE_NOT_FOUND)
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) { m_lastError = Compositor::PASS_NOT_FOUND;  return false; }
 	else
 	{
-		if (!verifyPipeline(inputPasses)) RETURN_ERR(Compositor::PIPELINE_NOT_COMPLETE)
-		m_pipelines[id] = inputPasses;
+		std::string FragmentShaderCode;
+		if (!readShaderFile(filename, FragmentShaderCode)) RETURN_ERR(SHADER_FILE_NOT_FOUND);
+
+		return loadShaderSource(passID, FragmentShaderCode.c_str());
 	}
-	RETURN_OK()
 }
 
 ///
-/// \brief To get all the passes index from a pipeline.
-/// To get all the passes index from a pipeline.
+/// \brief To load fragment shader from a string.
+/// To load fragment shader to be used for doing compositing from a string instead of a file. 
+/// If the pass already has a shader, it is replaced only if the new one compiles and links.
 ///
-std::vector<int> Compositor::getPipeline(int id)
+bool Compositor::loadShaderSource(int passID, const char* source)
 {
-	std::vector<int> passes;
-	passes.clear();
-	std::map<int, std::vector<int>>::iterator p = m_pipelines.find(id);
-	if (p != m_pipelines.end())
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+	if (p->layered) RETURN_ERR(Compositor::PASS_WRONG_KIND)
+
+	GLuint newShader = 0;
+	GLuint newProgram = buildProgram(source, &newShader, p->compute, p->batchSize > 0);
+	if (newProgram == 0) return false;
+
+	if (p->pending)
 	{
-		passes = p->second;
-		m_lastError = Compositor::PIPELINE_NOT_FOUND;
+		deleteProgram(p->build.program, p->build.fragmentShader);
+		p->pending = false;
 	}
-	return passes;
+	installProgram(*p, newProgram, newShader, source);
+
+	RETURN_OK()
 }
 
 ///
-/// \brief To delete a pipeline.
-/// To delete a pipeline.
+/// \brief To load a shader into a pass without waiting for it to compile.
+/// To load a shader from a file into a pass without waiting for it to compile, see Compositor::loadShaderSourceAsync().
 ///
-bool Compositor::deletePipeline(int id)
+bool Compositor::loadShaderAsync(int passID, char* filename)
 {
-	std::map<int, std::vector<int>>::iterator p = m_pipelines.find(id);
-	if (p == m_pipelines.end()) RETURN_ERR(Compositor::PIPELINE_NOT_FOUND)
-	else
-		m_pipelines.erase(p);
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
 
-	RETURN_OK()
+	std::string FragmentShaderCode;
+	if (!readShaderFile(filename, FragmentShaderCode)) RETURN_ERR(SHADER_FILE_NOT_FOUND);
+
+	return loadShaderSourceAsync(passID, FragmentShaderCode.c_str());
 }
 
 ///
-/// \brief To render a pipeline.
-/// To render a pipeline by sequentially render the passes.
+/// \brief To load a shader source into a pass without waiting for it to compile.
+/// To submit a shader source for compiling and linking without querying the result, so several shaders can compile at once 
+/// (on driver threads with KHR_parallel_shader_compile). The pass is PASS_PENDING until the program is ready; 
+/// the shader is installed by getPassState(), updatePendingShaders(), renderPass() or renderPipeline() once the driver reports it complete. 
+/// Until then the previous shader of the pass is rendered, or the pending policy applies if there is none. 
+/// Loading another shader into the pass discards the pending one.
 ///
-bool Compositor::renderPipeline(int id)
+bool Compositor::loadShaderSourceAsync(int passID, const char* source)
 {
-	std::map<int, std::vector<int>>::iterator p = m_pipelines.find(id);
-	if (p == m_pipelines.end()) RETURN_ERR(Compositor::PIPELINE_NOT_FOUND)
-	else
-	{
-		if (!verifyPipeline(p->second)) RETURN_ERR(Compositor::PIPELINE_NOT_COMPLETE)
-		pushState();
-		for (int i = 0; i < p->second.size(); i++)
-		{
-			std::map<int, pass>::iterator p2 = m_passes.find(p->second[i]);
-			renderPassInternal(p2);
-		}
-		popState();
-	}
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+	if (p->layered) RETURN_ERR(Compositor::PASS_WRONG_KIND)
+
+	if (p->pending) deleteProgram(p->build.program, p->build.fragmentShader);
+	startProgram(source, p->build, p->compute, p->batchSize > 0);
+	p->pending = true;
+	p->failed = false;
 
 	RETURN_OK()
 }
 
 ///
-/// \brief To set 1D uniform value.
-/// To set 1D uniform value
+/// \brief To get the loading state of the shader of a pass.
+/// To get the loading state of the shader of a pass, installing the shader if it finished compiling. 
+/// For PASS_FAILED, getLastShaderError() returns the compile or link log.
 ///
-bool Compositor::setUniformValue1f(int passID, char* uniName, GLfloat v0)
+Compositor::passState Compositor::getPassState(int passID)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) { m_lastError = Compositor::PASS_NOT_FOUND; return PASS_EMPTY; }
+
+	updatePendingShader(*p);
+	m_lastError = Compositor::NONE;
+	if (p->pending) return PASS_PENDING;
+	if (p->failed)
 	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform1f(loc, v0);
-		glUseProgram(currentProg);
+		m_shaderErrorString = p->failedLog;
+		return PASS_FAILED;
 	}
-
-	RETURN_OK()
+	return p->initialized ? PASS_READY : PASS_EMPTY;
 }
 
 ///
-/// \brief To set 2D uniform value.
-/// To set 2D uniform value
+/// \brief To install the shaders which finished compiling.
+/// To install the shaders of all passes which finished compiling. Returns true if no shader is pending anymore.
 ///
-bool Compositor::setUniformValue2f(int passID, char* uniName, GLfloat v0, GLfloat v1)
+bool Compositor::updatePendingShaders()
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
+	bool done = true;
+	for (size_t i = 0; i < m_passes.slotCount(); i++)
 	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform2f(loc, v0, v1);
-		glUseProgram(currentProg);
+		pass* p = m_passes.at(i);
+		if (p == nullptr) continue;
+		updatePendingShader(*p);
+		if (p->pending) done = false;
 	}
-
-	RETURN_OK()
+	m_lastError = Compositor::NONE;
+	return done;
 }
 
 ///
-/// \brief To set 3D uniform value.
-/// To set 3D uniform value
+/// \brief To set what is rendered for a pass whose shader is still compiling.
+/// To set what renderPass() and renderPipeline() do with a pass which has a pending shader and no previous shader. 
+/// PENDING_PASSTHROUGH builds a small copy shader the first time it is set.
 ///
-bool Compositor::setUniformValue3f(int passID, char* uniName, GLfloat v0, GLfloat v1, GLfloat v2)
+bool Compositor::setPendingPolicy(pendingPolicy policy)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
+	if (policy == PENDING_PASSTHROUGH && m_passthroughProgram == 0)
 	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform3f(loc, v0, v1, v2);
-		glUseProgram(currentProg);
+		static const char* passthrough_shader_text =
+			"#version 330\n"
+			"in vec2 in_uv;\n"
+			"uniform sampler2D tex;\n"
+			"layout(location = 0) out vec4 out0;\n"
+			"layout(location = 1) out vec4 out1;\n"
+			"layout(location = 2) out vec4 out2;\n"
+			"layout(location = 3) out vec4 out3;\n"
+			"layout(location = 4) out vec4 out4;\n"
+			"layout(location = 5) out vec4 out5;\n"
+			"layout(location = 6) out vec4 out6;\n"
+			"layout(location = 7) out vec4 out7;\n"
+			"void main()\n"
+			"{\n"
+			"    vec4 color = texture(tex, in_uv);\n"
+			"    out0 = color; out1 = color; out2 = color; out3 = color;\n"
+			"    out4 = color; out5 = color; out6 = color; out7 = color;\n"
+			"}\n";
+		m_passthroughProgram = buildProgram(passthrough_shader_text, &m_passthroughShader, false, false);
+		if (m_passthroughProgram == 0) return false;
 	}
+	m_pendingPolicy = policy;
 
 	RETURN_OK()
 }
 
 ///
-/// \brief To set 4D uniform value.
-/// To set 4D uniform value
+/// \brief To delete new pass.
+/// To delete a pass.
 ///
-bool Compositor::setUniformValue4f(int passID, char* uniName, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+bool Compositor::deletePass(int passID)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
 	else
 	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform4f(loc, v0, v1, v2, v3);
-		glUseProgram(currentProg);
+		//clear everything inside *p here, OpenGL might reuse the names so they must not stay in the state cache
+		if (m_cache.fbo == p->fbo) m_cache.valid &= ~CACHED_FBO;
+		if (p->layered)		//the program is shared by all layer passes
+		{
+			if (m_cache.bufferVertexArray == (GLint)p->layerArray) m_cache.valid &= ~CACHED_VERTEX_ARRAY;
+			if (m_cache.bufferArrayBuffer == (GLint)p->layerBuffer) m_cache.valid &= ~CACHED_ARRAY_BUFFER;
+			glDeleteVertexArrays(1, &p->layerArray);
+			glDeleteBuffers(1, &p->layerBuffer);
+		}
+		else deleteProgram(p->shaderProgram, p->shaderFragment);
+		if (p->pending) deleteProgram(p->build.program, p->build.fragmentShader);
+		glDeleteFramebuffers(1, &p->fbo);
+		//finally delete the pass here
+		m_passes.erase(passID);
+		m_globalVersion = ++m_passesVersion;
 	}
-
 	RETURN_OK()
 }
 
 ///
-/// \brief To set 1D uniform value.
-/// To set 1D uniform value
+/// \brief Render the specified pass.
+/// Render the specified pass.
 ///
-bool Compositor::setUniformValue1i(int passID, char* uniName, GLint v0)
+bool Compositor::renderPass(int passID)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+	if (m_resourceJobsInFlight.load() != 0) updateResourceJobs();
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
 	else
 	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform1i(loc, v0);
-		glUseProgram(currentProg);
-	}
+		updatePendingShader(*p);
+		if (!isRenderable(*p)) RETURN_ERR(Compositor::PASS_PROGRAM_NOT_INITIALIZED)
+		if (p->texOutputs.size() == 0) RETURN_ERR(Compositor::PASS_OUTPUT_NOT_FOUND)
+		if (!p->transientInputs.empty() || !p->transientOutputs.empty()) RETURN_ERR(Compositor::TRANSIENT_OUTSIDE_PIPELINE)
 
+		if (p->actionsVersion != p->version)
+		{
+			resolveActions(*p, p->discards, nullptr, nullptr, p->actions);
+			p->actionsVersion = p->version;
+		}
+
+		pushState();
+		updateUniformBlocks();
+		setScissor(GL_FALSE, 0, 0, 0, 0);
+
+		renderPassInternal(*p, p->actions);
+		if (p->compute) glMemoryBarrier(HOST_BARRIER_BITS);
+		markOutputsChanged(*p);
+		p->renderedFbo = 0;
+
+		popState();
+	}
 	RETURN_OK()
 }
 
 ///
-/// \brief To set 2D uniform value.
-/// To set 2D uniform value
+/// \brief To create a new pipeline, which is a list of sequential passes.
+/// To To create a new pipeline, which is a list of sequential passes.
 ///
-bool Compositor::setUniformValue2i(int passID, char* uniName, GLint v0, GLint v1)
+int Compositor::createSequentialPipeline()
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
-	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform2i(loc, v0, v1);
-		glUseProgram(currentProg);
-	}
-
-	RETURN_OK()
+	return createPipelineInternal(PIPELINE_SEQUENTIAL);
 }
 
 ///
-/// \brief To set 3D uniform value.
-/// To set 3D uniform value
+/// \brief To create a new graph pipeline.
+/// To create a new pipeline whose rendering order is inferred from the textures the passes write and read.
 ///
-bool Compositor::setUniformValue3i(int passID, char* uniName, GLint v0, GLint v1, GLint v2)
+int Compositor::createGraphPipeline()
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
-	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform3i(loc, v0, v1, v2);
-		glUseProgram(currentProg);
-	}
-
-	RETURN_OK()
+	return createPipelineInternal(PIPELINE_GRAPH);
 }
 
 ///
-/// \brief To set 4D uniform value.
-/// To set 4D uniform value
+/// \brief To create a downsample and upsample pyramid.
+/// To create a sequential pipeline which downsamples the input texture into a pyramid of levels (half size each) with a 13-tap filter, 
+/// then upsamples it back with a 3x3 tent filter, adding each level on the way up, and writes the average of the levels to the output 
+/// texture (e.g. for bloom or wide blurs). The levels are transient textures of the given format, sized for the current resolution. 
+/// The passes are created and owned by the compositor like other passes. Returns the Pipeline ID, or -1 if a shader does not build.
 ///
-bool Compositor::setUniformValue4i(int passID, char* uniName, GLint v0, GLint v1, GLint v2, GLint v3)
+int Compositor::createPyramidPipeline(GLuint input, GLuint output, int levels, GLenum internalFormat)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
+	static const char* downsample_shader_text =
+		"#version 330\n"
+		"in vec2 in_uv;\n"
+		"uniform sampler2D src;\n"
+		"layout(location = 0) out vec4 color;\n"
+		"vec4 tap(vec2 offset) { return texture(src, in_uv + offset / vec2(textureSize(src, 0))); }\n"
+		"void main()\n"
+		"{\n"
+		"    vec4 corners = tap(vec2(-2.0, 2.0)) + tap(vec2(2.0, 2.0)) + tap(vec2(-2.0, -2.0)) + tap(vec2(2.0, -2.0));\n"
+		"    vec4 edges = tap(vec2(0.0, 2.0)) + tap(vec2(-2.0, 0.0)) + tap(vec2(2.0, 0.0)) + tap(vec2(0.0, -2.0));\n"
+		"    vec4 inner = tap(vec2(-1.0, 1.0)) + tap(vec2(1.0, 1.0)) + tap(vec2(-1.0, -1.0)) + tap(vec2(1.0, -1.0));\n"
+		"    color = tap(vec2(0.0)) * 0.125 + corners * 0.03125 + edges * 0.0625 + inner * 0.125;\n"
+		"}\n";
+	static const char* upsample_shader_text =
+		"#version 330\n"
+		"in vec2 in_uv;\n"
+		"uniform sampler2D src;\n"
+		"uniform sampler2D base;\n"
+		"uniform float weight;\n"
+		"uniform float baseWeight;\n"
+		"layout(location = 0) out vec4 color;\n"
+		"vec4 tap(vec2 offset) { return texture(src, in_uv + offset / vec2(textureSize(src, 0))); }\n"
+		"void main()\n"
+		"{\n"
+		"    vec4 tent = tap(vec2(0.0)) * 4.0\n"
+		"        + (tap(vec2(0.0, 1.0)) + tap(vec2(-1.0, 0.0)) + tap(vec2(1.0, 0.0)) + tap(vec2(0.0, -1.0))) * 2.0\n"
+		"        + tap(vec2(-1.0, 1.0)) + tap(vec2(1.0, 1.0)) + tap(vec2(-1.0, -1.0)) + tap(vec2(1.0, -1.0));\n"
+		"    color = tent / 16.0 * weight + texture(base, in_uv) * baseWeight;\n"
+		"}\n";
+
+	levels = std::max(levels, 1);
+	std::vector<int> passes, transients;
+	std::vector<std::pair<int, int>> sizes;		//size of each level, from 1
+	int w = m_width, h = m_height;
+	for (int i = 0; i < levels; i++)
 	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform4i(loc, v0, v1, v2, v3);
-		glUseProgram(currentProg);
+		w = std::max(w / 2, 1);
+		h = std::max(h / 2, 1);
+		sizes.push_back(std::make_pair(w, h));
+		transients.push_back(createTransientTexture(w, h, internalFormat));
 	}
 
-	RETURN_OK()
+	bool built = true;
+	//downsample : level i + 1 from level i (the input for level 0)
+	for (int i = 0; i < levels && built; i++)
+	{
+		int passID = createNewPass();
+		if (passID < 0) { built = false; break; }
+		passes.push_back(passID);
+		built = loadShaderSource(passID, downsample_shader_text);
+		if (i == 0) setUniformTexture(passID, (char*)"src", input);
+		else setTransientInput(passID, (char*)"src", transients[i - 1]);
+		setTransientOutput(passID, 0, transients[i]);
+		setPassSize(passID, sizes[i].first, sizes[i].second);
+	}
+	//upsample : level i from level i + 1 plus the downsampled level i, then the output from level 1
+	int previous = transients[levels - 1];
+	for (int i = levels - 2; i >= -1 && built; i--)
+	{
+		int passID = createNewPass();
+		if (passID < 0) { built = false; break; }
+		passes.push_back(passID);
+		built = loadShaderSource(passID, upsample_shader_text);
+		setTransientInput(passID, (char*)"src", previous);
+		if (i >= 0)
+		{
+			previous = createTransientTexture(sizes[i].first, sizes[i].second, internalFormat);
+			transients.push_back(previous);
+			setTransientInput(passID, (char*)"base", transients[i]);
+			setTransientOutput(passID, 0, previous);
+			setPassSize(passID, sizes[i].first, sizes[i].second);
+			setUniformValue1f(passID, (char*)"weight", 1.0f);
+			setUniformValue1f(passID, (char*)"baseWeight", 1.0f);
+		}
+		else
+		{
+			setOutputTexture(passID, 0, output);
+			setUniformValue1f(passID, (char*)"weight", 1.0f / levels);		//each level was added once
+			setUniformValue1f(passID, (char*)"baseWeight", 0.0f);
+		}
+	}
+
+	if (!built)
+	{
+		error e = m_lastError;
+		for (size_t i = 0; i < passes.size(); i++) deletePass(passes[i]);
+		for (size_t i = 0; i < transients.size(); i++) deleteTransientTexture(transients[i]);
+		m_lastError = e;
+		return -1;
+	}
+
+	int pipelineID = createSequentialPipeline();
+	setPipeline(pipelineID, passes);
+	m_lastError = Compositor::NONE;
+	return pipelineID;
 }
 
 ///
-/// \brief To set 1D uniform value.
-/// To set 1D uniform value
+/// \brief To set passes of a pipeline.
+/// To set passes of a pipeline. For a graph pipeline the order of the passes does not matter.
 ///
-bool Compositor::setUniformValue1ui(int passID, char* uniName, GLuint v0)
+bool Compositor::setPipeline(int id, std::vector<int> inputPasses)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) RETURN_ERR(Compositor::PIPELINE_NOT_FOUND)
 	else
 	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform1ui(loc, v0);
-		glUseProgram(currentProg);
+		if (!verifyPipeline(inputPasses)) RETURN_ERR(Compositor::PIPELINE_NOT_COMPLETE)
+		p->passes = inputPasses;
+		p->version = ++m_passesVersion;
+		if (!resolvePipeline(*p)) return false;
 	}
-
 	RETURN_OK()
 }
 
 ///
-/// \brief To set 2D uniform value.
-/// To set 2D uniform value
+/// \brief To set passes and final outputs of a graph pipeline.
+/// To set passes and final outputs of a graph pipeline. A pass is rendered after the passes which write the textures it reads, 
+/// and passes which do not contribute to any of the final output textures are not rendered. 
+/// If no final output is given, all passes are rendered.
 ///
-bool Compositor::setUniformValue2ui(int passID, char* uniName, GLuint v0, GLuint v1)
+bool Compositor::setGraphPipeline(int id, std::vector<int> inputPasses, std::vector<GLuint> finalOutputs)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
-	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform2ui(loc, v0, v1);
-		glUseProgram(currentProg);
-	}
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) RETURN_ERR(Compositor::PIPELINE_NOT_FOUND)
+	if (p->type != PIPELINE_GRAPH) RETURN_ERR(Compositor::PIPELINE_NOT_GRAPH)
 
-	RETURN_OK()
+	p->finalOutputs = finalOutputs;
+	return setPipeline(id, inputPasses);
 }
 
 ///
-/// \brief To set 3D uniform value.
-/// To set 3D uniform value
+/// \brief To get all the passes index from a pipeline.
+/// To get all the passes index from a pipeline.
 ///
-bool Compositor::setUniformValue3ui(int passID, char* uniName, GLuint v0, GLuint v1, GLuint v2)
+std::vector<int> Compositor::getPipeline(int id)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
+	std::vector<int> passes;
+	passes.clear();
+	pipeline* p = m_pipelines.find(id);
+	if (p != nullptr)
 	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform3ui(loc, v0, v1, v2);
-		glUseProgram(currentProg);
+		passes = p->passes;
+		m_lastError = Compositor::NONE;
 	}
-
-	RETURN_OK()
+	else m_lastError = Compositor::PIPELINE_NOT_FOUND;
+	return passes;
 }
 
 ///
-/// \brief To set 4D uniform value.
-/// To set 4D uniform value
+/// \brief To get the passes of a pipeline in rendering order.
+/// To get the passes of a pipeline in the order they are rendered. For a graph pipeline, culled passes are not included.
 ///
-bool Compositor::setUniformValue4ui(int passID, char* uniName, GLuint v0, GLuint v1, GLuint v2, GLuint v3)
+std::vector<int> Compositor::getPipelineOrder(int id)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
-	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform4ui(loc, v0, v1, v2, v3);
-		glUseProgram(currentProg);
-	}
+	std::vector<int> passes;
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) { m_lastError = Compositor::PIPELINE_NOT_FOUND; return passes; }
+	if (p->resolvedVersion != pipelineVersion(*p) && !resolvePipeline(*p)) return passes;
 
-	RETURN_OK()
+	m_lastError = Compositor::NONE;
+	return p->order;
 }
 
 ///
-/// \brief To set 1D uniform value.
-/// To set 1D uniform value
+/// \brief To enable or disable fusion of per-pixel passes in a pipeline.
+/// To enable or disable fusion of per-pixel passes in a pipeline. When enabled, a pass whose only output is read only by the next pass, 
+/// and only as texture(sampler, in_uv), is merged with the next pass into one generated fragment shader, so the intermediate texture 
+/// is neither written nor read. The fused shaders are generated from the loaded shader sources with the producer symbols renamed, 
+/// and are cached. If a fused shader fails to compile, the passes are rendered unfused. 
+/// Note that the intermediate textures of fused passes are not updated, and values are not quantized to their format.
 ///
-bool Compositor::setUniformValue1fv(int passID, char* uniName, GLfloat *v)
+bool Compositor::setPipelineFusion(int id, bool enable)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
-	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform1fv(loc, 1, v);
-		glUseProgram(currentProg);
-	}
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) RETURN_ERR(Compositor::PIPELINE_NOT_FOUND)
+
+	p->fusion = enable;
+	if (!resolvePipeline(*p)) return false;
 
 	RETURN_OK()
 }
 
 ///
-/// \brief To set 2D uniform value.
-/// To set 2D uniform value
+/// \brief To get the fused passes of a pipeline.
+/// To get the groups of passes which are rendered by one fused shader, in rendering order.
 ///
-bool Compositor::setUniformValue2fv(int passID, char* uniName, GLfloat *v)
+std::vector<std::vector<int>> Compositor::getPipelineFusion(int id)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
-	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform2fv(loc, 2, v);
-		glUseProgram(currentProg);
-	}
+	std::vector<std::vector<int>> groups;
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) { m_lastError = Compositor::PIPELINE_NOT_FOUND; return groups; }
+	if (p->resolvedVersion != pipelineVersion(*p) && !resolvePipeline(*p)) return groups;
 
-	RETURN_OK()
+	for (size_t i = 0; i < p->fused.size(); i++)
+		groups.push_back(p->fused[i].members);
+
+	m_lastError = Compositor::NONE;
+	return groups;
 }
 
 ///
-/// \brief To set 3D uniform value.
-/// To set 3D uniform value
+/// \brief To enable or disable GPU timing of a pipeline.
+/// To enable or disable GPU timing of a pipeline. When enabled, a GL_TIMESTAMP query is issued before the first pass and after each pass, 
+/// in a ring of a few frames, and results are read only when available so the CPU never waits for the GPU. 
+/// A frame is not measured if the ring is full. Disabling deletes the queries; when disabled, rendering issues no query. 
+/// The time of fused passes is reported for the last pass of each fused group.
 ///
-bool Compositor::setUniformValue3fv(int passID, char* uniName, GLfloat *v)
+bool Compositor::setPipelineTiming(int id, bool enable)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) RETURN_ERR(Compositor::PIPELINE_NOT_FOUND)
+
+	if (enable && !p->timing)
 	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform3fv(loc, 3, v);
-		glUseProgram(currentProg);
+		p->timingTotal = timingHistory();
+		p->timingPasses.clear();
 	}
+	if (!enable) deleteTimings(*p);
+	p->timing = enable;
 
 	RETURN_OK()
 }
 
 ///
-/// \brief To set 4D uniform value.
-/// To set 4D uniform value
+/// \brief To get the GPU time of a pipeline.
+/// To get the GPU time of a pipeline over the last measured frames, from the start of its first pass to the end of its last pass.
 ///
-bool Compositor::setUniformValue4fv(int passID, char* uniName, GLfloat *v)
+Compositor::gpuTime Compositor::getPipelineGpuTime(int id)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
-	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform4fv(loc, 4, v);
-		glUseProgram(currentProg);
-	}
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) { m_lastError = Compositor::PIPELINE_NOT_FOUND; return getTiming(timingHistory()); }
 
-	RETURN_OK()
+	collectTimings(*p);
+	m_lastError = Compositor::NONE;
+	return getTiming(p->timingTotal);
 }
 
 ///
-/// \brief To set 1D uniform value.
-/// To set 1D uniform value
+/// \brief To get the GPU time of a pass in a pipeline.
+/// To get the GPU time of a pass in a pipeline over the last measured frames.
 ///
-bool Compositor::setUniformValue1iv(int passID, char* uniName, GLint *v)
+Compositor::gpuTime Compositor::getPassGpuTime(int id, int passID)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
-	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform1iv(loc, 1, v);
-		glUseProgram(currentProg);
-	}
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) { m_lastError = Compositor::PIPELINE_NOT_FOUND; return getTiming(timingHistory()); }
+
+	collectTimings(*p);
+	m_lastError = Compositor::NONE;
+	std::map<int, timingHistory>::iterator t = p->timingPasses.find(passID);
+	return getTiming(t != p->timingPasses.end() ? t->second : timingHistory());
+}
+
+///
+/// \brief To render only the damaged regions of a pipeline.
+/// To enable or disable damage tracking on a pipeline. When enabled, the regions reported with addDamage() are propagated through 
+/// the passes (grown by their kernel radius), and each pass only renders the region of its outputs which depends on them, keeping 
+/// the rest of its previous outputs. Passes whose uniforms changed, and all passes after a change of shader, texture, uniform block 
+/// or resolution, are rendered in full.
+///
+bool Compositor::setPipelineDamageTracking(int id, bool enable)
+{
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) RETURN_ERR(Compositor::PIPELINE_NOT_FOUND)
+
+	p->damageTracking = enable;
+	p->damageValid = false;
+	p->damage.clear();
 
 	RETURN_OK()
 }
 
 ///
-/// \brief To set 2D uniform value.
-/// To set 2D uniform value
+/// \brief To report a changed region of an input texture.
+/// To report that a rectangle (in pixels of the resolution, origin at the bottom left) of a texture used by a pipeline changed 
+/// since the pipeline was last rendered. Only used when damage tracking is enabled on the pipeline.
 ///
-bool Compositor::setUniformValue2iv(int passID, char* uniName, GLint *v)
+bool Compositor::addDamage(int id, GLuint texID, int x, int y, int width, int height)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
-	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform2iv(loc, 2, v);
-		glUseProgram(currentProg);
-	}
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) RETURN_ERR(Compositor::PIPELINE_NOT_FOUND)
+	if (!p->damageTracking || width <= 0 || height <= 0) RETURN_OK()
+
+	damageRect r;
+	r.x0 = std::max(0.0f, (float)x / m_width);
+	r.y0 = std::max(0.0f, (float)y / m_height);
+	r.x1 = std::min(1.0f, (float)(x + width) / m_width);
+	r.y1 = std::min(1.0f, (float)(y + height) / m_height);
+	std::map<GLuint, damageRect>::iterator d = p->damage.find(texID);
+	if (d == p->damage.end()) p->damage[texID] = r;
+	else d->second = unionRect(d->second, r);
 
 	RETURN_OK()
 }
 
 ///
-/// \brief To set 3D uniform value.
-/// To set 3D uniform value
+/// \brief To set how far a pass reads around each pixel.
+/// To set the radius in pixels of the neighbourhood of its inputs which an output pixel of a pass depends on (e.g. the radius of a blur), 
+/// so damaged regions are grown by it. 0 (default) is for passes which only read their inputs at the same pixel.
 ///
-bool Compositor::setUniformValue3iv(int passID, char* uniName, GLint *v)
+bool Compositor::setPassKernelRadius(int passID, int radius)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
-	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform3iv(loc, 3, v);
-		glUseProgram(currentProg);
-	}
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+
+	p->kernelRadius = std::max(radius, 0);
 
 	RETURN_OK()
 }
 
 ///
-/// \brief To set 4D uniform value.
-/// To set 4D uniform value
+/// \brief To render a pass at a scale of the resolution.
+/// To set the size of a pass relative to the resolution set with setResolution() (e.g. 0.5 for half resolution). 
+/// Its output textures must have that size; in_uv still goes from 0 to 1 over the outputs.
 ///
-bool Compositor::setUniformValue4iv(int passID, char* uniName, GLint *v)
+bool Compositor::setPassScale(int passID, float scale)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
-	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform4iv(loc, 4, v);
-		glUseProgram(currentProg);
-	}
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+	if (scale <= 0.0f) return false;
+
+	p->sizeScale = scale;
+	p->fixedWidth = 0;
+	p->fixedHeight = 0;
+	changePass(*p);
 
 	RETURN_OK()
 }
 
 ///
-/// \brief To set 1D uniform value.
-/// To set 1D uniform value
+/// \brief To render a pass at a fixed size.
+/// To set the size in pixels of a pass, whatever the resolution is. Its output textures must have that size.
 ///
-bool Compositor::setUniformValue1uiv(int passID, char* uniName, GLuint *v)
+bool Compositor::setPassSize(int passID, int width, int height)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
-	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform1uiv(loc, 1, v);
-		glUseProgram(currentProg);
-	}
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+	if (width <= 0 || height <= 0) return false;
+
+	p->fixedWidth = width;
+	p->fixedHeight = height;
+	changePass(*p);
 
 	RETURN_OK()
 }
 
 ///
-/// \brief To set 2D uniform value.
-/// To set 2D uniform value
+/// \brief To skip passes whose inputs did not change.
+/// To enable or disable memoization on a pipeline. When enabled, a pass is skipped, keeping its previous outputs, if its shader, 
+/// uniform values, uniform blocks, resolution and the versions of its input textures are the same as when it was last rendered. 
+/// Rendering a pass changes the version of its outputs, so passes reading them are rendered too. Textures changed by the main 
+/// program must be reported with markTextureChanged(). Passes reading or writing transient textures are always rendered.
 ///
-bool Compositor::setUniformValue2uiv(int passID, char* uniName, GLuint* v)
+bool Compositor::setPipelineMemoization(int id, bool enable)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) RETURN_ERR(Compositor::PIPELINE_NOT_FOUND)
+
+	p->memoization = enable;
+	for (size_t i = 0; i < p->passes.size(); i++)
 	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform2uiv(loc, 2, v);
-		glUseProgram(currentProg);
+		pass* p2 = m_passes.find(p->passes[i]);
+		if (p2 != nullptr) p2->memoValid = false;
 	}
 
 	RETURN_OK()
 }
 
 ///
-/// \brief To set 3D uniform value.
-/// To set 3D uniform value
+/// \brief To get how many passes a pipeline skipped.
+/// To get how many passes were rendered and skipped (by memoization or damage tracking) by the last rendering of a pipeline, and in total.
 ///
-bool Compositor::setUniformValue3uiv(int passID, char* uniName, GLuint *v)
+Compositor::memoStats Compositor::getPipelineMemoStats(int id)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
+	memoStats stats;
+	memset(&stats, 0, sizeof(stats));
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) { m_lastError = Compositor::PIPELINE_NOT_FOUND; return stats; }
+
+	m_lastError = Compositor::NONE;
+	return p->memo;
+}
+
+///
+/// \brief To report that the main program changed a texture.
+/// To report that the main program changed the content of a texture used as input, so passes reading it are rendered again 
+/// by pipelines with memoization.
+///
+void Compositor::markTextureChanged(GLuint texID)
+{
+	++m_textureVersions[texID];
+	m_lastError = Compositor::NONE;
+}
+
+///
+/// \brief To render a pipeline with several frames in flight.
+/// To rotate each output texture of a pipeline through the given number of frame slots (default 1, no rotation). The texture of the 
+/// main program is slot 0, and the compositor creates a copy of it with the same size and format for each other slot. Each frame is 
+/// rendered into the next slot and followed by a fence, so the main program can use the output of a finished frame, obtained with 
+/// getCompletedOutput(), while the next frames render. Memoization and damage tracking are not used while frames are in flight.
+///
+bool Compositor::setPipelineFramesInFlight(int id, int frames)
+{
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) RETURN_ERR(Compositor::PIPELINE_NOT_FOUND)
+	if (frames < 1) return false;
+	if (frames == p->framesInFlight) RETURN_OK()
+
+	deleteFrames(*p, true);
+	p->framesInFlight = frames;
+	if (frames > 1)
 	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform3uiv(loc, 3, v);
-		glUseProgram(currentProg);
+		pipelineFrame slot;
+		slot.fence = 0;
+		slot.number = 0;
+		p->frames.assign(frames, slot);
+	}
+	p->frameNext = 0;
+	p->framesVersion = pipelineVersion(*p) - 1;
+	p->damageValid = false;
+	for (size_t i = 0; i < p->passes.size(); i++)
+	{
+		pass* p2 = m_passes.find(p->passes[i]);
+		if (p2 != nullptr) p2->memoValid = false;
 	}
 
 	RETURN_OK()
 }
 
 ///
-/// \brief To set 4D uniform value.
-/// To set 4D uniform value
+/// \brief To get an output of the last finished frame of a pipeline.
+/// To get the texture holding an output of the most recent frame of a pipeline which the GPU finished, without waiting, and the number 
+/// of that frame (counted from 1). The texture is not written again until the slot comes around, framesInFlight frames later. 
+/// Returns 0 with PIPELINE_FRAME_NOT_READY if no frame is finished yet. Without frames in flight, returns the texture itself.
 ///
-bool Compositor::setUniformValue4uiv(int passID, char* uniName, GLuint* v)
+GLuint Compositor::getCompletedOutput(int id, GLuint texID, unsigned long long* frame)
 {
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) { m_lastError = Compositor::PIPELINE_NOT_FOUND; return 0; }
+	if (p->framesInFlight <= 1)
 	{
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		GLint loc = glGetUniformLocation(p->second.shaderProgram, uniName);
-		glUniform4uiv(loc,4, v);
-		glUseProgram(currentProg);
+		if (frame != nullptr) *frame = p->frameCount;
+		m_lastError = Compositor::NONE;
+		return texID;
 	}
+	std::map<GLuint, frameTexture>::iterator t = p->frameTextures.find(texID);
+	if (t == p->frameTextures.end()) { m_lastError = Compositor::TEXTURE_OUTPUT_NOT_FOUND; return 0; }
 
-	RETURN_OK()
+	int latest = -1;
+	for (int i = 0; i < (int)p->frames.size(); i++)
+	{
+		pipelineFrame& f = p->frames[i];
+		if (f.number == 0 || !isFrameDone(f)) continue;
+		if (latest < 0 || f.number > p->frames[latest].number) latest = i;
+	}
+	if (latest < 0) { m_lastError = Compositor::PIPELINE_FRAME_NOT_READY; return 0; }
+
+	if (frame != nullptr) *frame = p->frames[latest].number;
+	m_lastError = Compositor::NONE;
+	return latest == 0 ? texID : t->second.copies[latest - 1];
 }
 
 ///
-/// \brief To set textures as input to the pass.
-/// To set textures as input to the pass. It is pair : texChannel - texID. texChannel is to be used for glActiveTexture(GL_TEXTURE0 - GL_TEXTURE31) before the rendering, 
-///	and textID is to be used glBindTexture(GL_TEXTURE_2D, texID).
-/// We do not check whether the texture is valid. Should it be implemented here, or it is responsibility of main program ?
+/// \brief To render a pipeline by replaying a baked command list.
+/// To compile a pipeline into a flat list of commands (framebuffer, program, textures, draw buffers, viewport, uniforms, draw or 
+/// dispatch), without the state changes which the previous passes already made. Renderings then replay the list, without looking 
+/// up, verifying or allocating anything. The list is baked again at the next rendering when a pass it uses changes (shader, inputs, 
+/// outputs, size) or when the resolution changes. Pipelines with GPU timing, damage tracking, memoization or frames in flight are 
+/// not baked.
 ///
-bool Compositor::setUniformTexture(int passID, char* texUniform, GLuint texID)
+bool Compositor::setPipelineBaking(int id, bool enable)
 {
-	//todo : return false if the program is wrong
-	//todo : return false if the uniform can't be found
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
-	{
-		p->second.texInputs[texUniform] = texID;
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) RETURN_ERR(Compositor::PIPELINE_NOT_FOUND)
 
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
-		std::map<char*, GLuint>::iterator t = p->second.texInputs.begin();
-		for (int i = 0; i < p->second.texInputs.size(); i++)
-		{
-			GLint texLoc = glGetUniformLocation(p->second.shaderProgram, t->first);
-			glUniform1i(texLoc, i);
-			++t;
-		}
-		glUseProgram(currentProg);
+	p->baking = enable;
+	p->baked.version = pipelineVersion(*p) - 1;
+	if (!enable)
+	{
+		p->baked.commands.clear();
+		p->baked.textures.clear();
+		p->baked.drawBuffers.clear();
+		p->baked.passes.clear();
+		p->baked.versions.clear();
 	}
 
 	RETURN_OK()
 }
 
 ///
-/// \brief To remove texture uniform. This function might not be needed.
-/// To remove texture uniform. This function might not be needed.
+/// \brief To create a texture streamed from the CPU.
+/// To create a texture whose content is written by the main program every frame (e.g. decoded video or camera frames) through a ring of 
+/// pixel buffers, so uploading never waits for the GPU. Frames are given in the format and type given here, rows packed without padding. 
+/// The pixel buffers are persistently mapped when buffer storage is available, otherwise one buffer is orphaned at each write. 
+/// Returns the Stream ID; getStreamTexture() returns the texture to use as a pass input.
 ///
-bool Compositor::deleteUniformTexture(int passID, char* texUniform)
+int Compositor::createStreamTexture(int width, int height, GLenum internalFormat, GLenum format, GLenum type)
 {
-	//todo : return false if the program is wrong
-	//todo : return false if the uniform can't be found
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
-	{
-		std::map<char*, GLuint>::iterator p2 = p->second.texInputs.find(texUniform);
-		if (p2 == p->second.texInputs.end()) RETURN_ERR(Compositor::TEXTURE_UNIFORM_NOT_FOUND)
-		p->second.texInputs.erase(p2);
+	stream newStream;
+	memset(newStream.fences, 0, sizeof(newStream.fences));
+	memset(&newStream.stats, 0, sizeof(newStream.stats));
+	newStream.width = width;
+	newStream.height = height;
+	newStream.format = format;
+	newStream.type = type;
+	newStream.frameSize = (GLsizeiptr)width * height * pixelSize(format, type);
+	newStream.mapped = nullptr;
+	newStream.next = 0;
+	newStream.writing = false;
+	newStream.fileData = nullptr;
+	newStream.fileSize = 0;
+	newStream.fileMapping = nullptr;
 
-		int currentProg;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
-		glUseProgram(p->second.shaderProgram);
+	GLint previousTexture, previousBuffer;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+	glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &previousBuffer);
 
-		//reset the texture binding with the uniform
-		std::map<char*, GLuint>::iterator t = p->second.texInputs.begin();
-		for (int i = 0; i < p->second.texInputs.size(); i++)
-		{
-			GLint texLoc = glGetUniformLocation(p->second.shaderProgram, t->first);
-			glUniform1i(texLoc, i);
-			++t;
-		}
-		glUseProgram(currentProg);
+	glGenTextures(1, &newStream.texture);
+	glBindTexture(GL_TEXTURE_2D, newStream.texture);
+	if (m_glVersion >= 42) glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+	else glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
+	glGenBuffers(1, &newStream.pbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, newStream.pbo);
+	if (m_hasBufferStorage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, newStream.frameSize * STREAM_RING_SIZE, NULL, flags);
+		newStream.mapped = (char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, newStream.frameSize * STREAM_RING_SIZE, flags);
 	}
+	else glBufferData(GL_PIXEL_UNPACK_BUFFER, newStream.frameSize, NULL, GL_STREAM_DRAW);
 
-	RETURN_OK()
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, previousBuffer);
+	glBindTexture(GL_TEXTURE_2D, previousTexture);
+
+	int streamID = m_streams.insert(newStream);
+	m_lastError = Compositor::NONE;
+	return streamID;
 }
 
 ///
-/// \brief To set texture as the render target in which channel in MRT.
-/// To set texture as the render target in which channel in MRT.
+/// \brief To get the texture of a stream.
+/// To get the texture of a stream, to be used as input of passes. Returns 0 if the stream does not exist.
 ///
-bool Compositor::setOutputTexture(int passID, int texChannel, GLuint texID)
+GLuint Compositor::getStreamTexture(int streamID)
 {
-	if (texChannel > 15) return false; //openGL limitation
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
-	{
-
-		p->second.texOutputs[texChannel] = texID;
-		GLint drawFboId;
-		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFboId);
+	stream* s = m_streams.find(streamID);
+	if (s == nullptr) { m_lastError = Compositor::STREAM_NOT_FOUND; return 0; }
 
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, p->second.fbo);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + texChannel, GL_TEXTURE_2D, texID, 0);
+	m_lastError = Compositor::NONE;
+	return s->texture;
+}
 
-		if (p->second.texOutputsChannels != nullptr) delete p->second.texOutputsChannels;
+///
+/// \brief To start writing a frame of a stream.
+/// To get memory where the main program writes the next frame of a stream directly (frameSize bytes, see createStreamTexture()), 
+/// until endStreamWrite(). Returns nullptr with STREAM_BUSY, without waiting, if the GPU is still uploading from every pixel buffer; 
+/// the frame should then be dropped or written later. Returns nullptr with STREAM_MAP_FAILED if the pixel buffer cannot be mapped.
+///
+void* Compositor::beginStreamWrite(int streamID)
+{
+	stream* s = m_streams.find(streamID);
+	if (s == nullptr) { m_lastError = Compositor::STREAM_NOT_FOUND; return nullptr; }
 
-		p->second.texOutputsChannels = new GLenum[p->second.texOutputs.size()];
-		std::map<int, GLuint>::iterator t;
-		int idx = 0;
-		for (t = p->second.texOutputs.begin(); t != p->second.texOutputs.end(); ++t)
+	void* data = nullptr;
+	if (s->mapped != nullptr)
+	{
+		GLsync& fence = s->fences[s->next];
+		if (fence != 0)
 		{
-			p->second.texOutputsChannels[idx] = GL_COLOR_ATTACHMENT0 + t->first;
-			idx++;
+			GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			{
+				s->stats.droppedFrames++;
+				m_lastError = Compositor::STREAM_BUSY;
+				return nullptr;
+			}
+			glDeleteSync(fence);
+			fence = 0;
+		}
+		data = s->mapped + s->next * s->frameSize;
+	}
+	else
+	{
+		//orphaning : the driver gives new memory if the GPU still uses the previous one
+		GLint previousBuffer;
+		glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &previousBuffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s->pbo);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, s->frameSize, NULL, GL_STREAM_DRAW);
+		data = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, s->frameSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, previousBuffer);
+		if (data == nullptr)
+		{
+			s->stats.droppedFrames++;
+			m_lastError = Compositor::STREAM_MAP_FAILED;
+			return nullptr;
 		}
-
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFboId);
 	}
+	s->writing = true;
 
-	RETURN_OK()
+	m_lastError = Compositor::NONE;
+	return data;
 }
 
 ///
-/// \brief To delete a specific texture MRT. Might not be needed.
-/// To delete a specific texture MRT. Might not be needed.
+/// \brief To finish writing a frame of a stream.
+/// To upload the frame written since beginStreamWrite() into the texture of the stream. The copy is done by the GPU from the pixel buffer. 
+/// Fails with STREAM_MAP_FAILED, dropping the frame, if the pixel buffer was corrupted while it was mapped (glUnmapBuffer returns false).
 ///
-bool Compositor::deleteOutputTexture(int passID, int texChannel)
+bool Compositor::endStreamWrite(int streamID)
 {
-	if (texChannel > 15) return false; //openGL limitation
-	std::map<int, pass>::iterator p = m_passes.find(passID);
-	if (p == m_passes.end()) RETURN_ERR(Compositor::PASS_NOT_FOUND)
-	else
-	{
-		std::map<int, GLuint>::iterator p2 = p->second.texOutputs.find(texChannel);
-
-		if (p2 == p->second.texOutputs.end()) RETURN_ERR(Compositor::TEXTURE_OUTPUT_NOT_FOUND)
+	stream* s = m_streams.find(streamID);
+	if (s == nullptr) RETURN_ERR(Compositor::STREAM_NOT_FOUND)
+	if (!s->writing) return false;
 
-		p->second.texOutputs.erase(p2);
+	GLint previousTexture, previousBuffer, unpackAlignment;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+	glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &previousBuffer);
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
 
-		GLint drawFboId;
-		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFboId);
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, p->second.fbo);
-		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + texChannel, GL_TEXTURE_2D, 0, 0);
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFboId);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s->pbo);
+	if (s->mapped == nullptr && glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, previousBuffer);
+		s->writing = false;
+		s->stats.droppedFrames++;
+		RETURN_ERR(Compositor::STREAM_MAP_FAILED)
+	}
+	glBindTexture(GL_TEXTURE_2D, s->texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	GLintptr offset = s->mapped != nullptr ? s->next * s->frameSize : 0;
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, s->width, s->height, s->format, s->type, (void*)offset);
+	if (s->mapped != nullptr)
+	{
+		s->fences[s->next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		s->next = (s->next + 1) % STREAM_RING_SIZE;
 	}
 
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+	glBindTexture(GL_TEXTURE_2D, previousTexture);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, previousBuffer);
+	s->writing = false;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (s->stats.frames == 0) s->firstUpload = now;
+	s->lastUpload = now;
+	s->stats.frames++;
+	s->stats.bytes += s->frameSize;
+	markTextureChanged(s->texture);
+
 	RETURN_OK()
 }
 
 ///
-/// \brief Initialize Vertex Shader.
-/// To initialize Vertex Shader for composition operation. As it is just a simple full-screen quad drawing, it can be used for all other passes.
+/// \brief To upload a frame of a stream from memory.
+/// To copy a frame (frameSize bytes, see createStreamTexture()) into the next pixel buffer of a stream and upload it. 
+/// Fails with STREAM_BUSY, without waiting, if the GPU is still uploading from every pixel buffer.
 ///
-void Compositor::initializeVertexShader()
+bool Compositor::uploadStreamFrame(int streamID, const void* data)
 {
-	static const char* vertex_shader_text =
-		"#version 330 compatibility\n"
-		"in vec3 vPos;\n"
-		"out vec2 in_uv;\n"
-		"void main()\n"
-		"{\n"
-		"mat4 MVP = mat4(vec4(2.0, 0.0, 0.0, 0.0),\n"
-		"                vec4(0.0, 2.0, 0.0, 0.0),\n"
-		"                vec4(0.0, 0.0, -1.0, 0.0),\n"
-		"                vec4(-1.0, -1.0, 0.0, 1.0));\n"
-		"    gl_Position = MVP * vec4(vPos, 1.0);\n"
-		"    in_uv.xy = vPos.xy;"
-		"}\n";
+	stream* s = m_streams.find(streamID);
+	if (s == nullptr) RETURN_ERR(Compositor::STREAM_NOT_FOUND)
 
-	m_shaderVertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(m_shaderVertex, 1, &vertex_shader_text, 0);
-	glCompileShader(m_shaderVertex);
+	void* target = beginStreamWrite(streamID);
+	if (target == nullptr) return false;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	memcpy(target, data, s->frameSize);
+	s->stats.copySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	return endStreamWrite(streamID);
 }
 
 ///
-/// \brief To create buffer for storing quad for composition.
-/// To create buffer for storing quad for composition.
+/// \brief To map a file of raw frames to a stream.
+/// To map a file holding raw frames into memory, so uploadStreamFileFrame() copies frames from the page cache straight into the 
+/// pixel buffers without reading them into a buffer first. Mapping another file replaces it.
 ///
-void Compositor::initializeBufferObject()
+bool Compositor::mapStreamFile(int streamID, const char* filename)
 {
-	const GLfloat vertices[] = {
-		0.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f
-	};
+	stream* s = m_streams.find(streamID);
+	if (s == nullptr) RETURN_ERR(Compositor::STREAM_NOT_FOUND)
+	unmapStreamFile(*s);
 
-	GLint bufferVertexArray, bufferArrayBuffer;
-	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &bufferVertexArray);
-	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &bufferArrayBuffer);
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) RETURN_ERR(Compositor::STREAM_FILE_NOT_FOUND)
+	LARGE_INTEGER size;
+	HANDLE mapping = GetFileSizeEx(file, &size) && size.QuadPart > 0 ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	CloseHandle(file);
+	if (mapping == NULL) RETURN_ERR(Compositor::STREAM_FILE_NOT_FOUND)
+	const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == NULL) { CloseHandle(mapping); RETURN_ERR(Compositor::STREAM_FILE_NOT_FOUND) }
+	s->fileMapping = mapping;
+	s->fileSize = (size_t)size.QuadPart;
+#else
+	int file = open(filename, O_RDONLY);
+	if (file < 0) RETURN_ERR(Compositor::STREAM_FILE_NOT_FOUND)
+	struct stat info;
+	void* data = fstat(file, &info) == 0 && info.st_size > 0 ? mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, file, 0) : MAP_FAILED;
+	close(file);
+	if (data == MAP_FAILED) RETURN_ERR(Compositor::STREAM_FILE_NOT_FOUND)
+	madvise(data, info.st_size, MADV_SEQUENTIAL);
+	s->fileSize = (size_t)info.st_size;
+#endif
+	s->fileData = (const char*)data;
 
-	/* Allocate and assign a Vertex Array Object to our handle */
-	glGenVertexArrays(1, &m_vertexArray);
-	/* Bind our Vertex Array Object as the current used object */
-	glBindVertexArray(m_vertexArray);
+	RETURN_OK()
+}
 
-	// Generate 1 buffer, put the resulting identifier in vertexbuffer
-	glGenBuffers(1, &m_vertexBuffer);
-	// The following commands will talk about our 'vertexbuffer' buffer
-	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
-	// Give our vertices to OpenGL.
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+///
+/// \brief To upload a frame of a stream from its mapped file.
+/// To upload the frame starting at the given byte offset of the file mapped with mapStreamFile(). 
+/// Fails with STREAM_OUT_OF_RANGE if the frame goes past the end of the file, or STREAM_BUSY as uploadStreamFrame().
+///
+bool Compositor::uploadStreamFileFrame(int streamID, size_t offset)
+{
+	stream* s = m_streams.find(streamID);
+	if (s == nullptr) RETURN_ERR(Compositor::STREAM_NOT_FOUND)
+	if (s->fileData == nullptr || offset + s->frameSize > s->fileSize) RETURN_ERR(Compositor::STREAM_OUT_OF_RANGE)
 
-	glBindVertexArray(bufferVertexArray);
-	glBindBuffer(GL_ARRAY_BUFFER, bufferArrayBuffer);
+	return uploadStreamFrame(streamID, s->fileData + offset);
 }
 
 ///
-/// \brief Save OpenGL states before rendering.
-/// To save OpenGL states before starting rendering so that states/settings from main program does not pollute in.
+/// \brief To get the upload counters of a stream.
+/// To get how many frames and bytes were uploaded to a stream, how many were dropped, and the bandwidth achieved.
 ///
-void Compositor::pushState()
+Compositor::streamStats Compositor::getStreamStats(int streamID)
 {
-	GLint temp; GLboolean tempB;
+	streamStats stats;
+	memset(&stats, 0, sizeof(stats));
+	stream* s = m_streams.find(streamID);
+	if (s == nullptr) { m_lastError = Compositor::STREAM_NOT_FOUND; return stats; }
 
-	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &temp);	m_state.fbo = temp;
-	glGetIntegerv(GL_VIEWPORT, m_state.viewport);
-	glGetFloatv(GL_COLOR_CLEAR_VALUE, m_state.clearColor);
-	glGetBooleanv(GL_DEPTH_WRITEMASK, &m_state.depthMask);
+	stats = s->stats;
+	if (stats.copySeconds > 0.0) stats.copyBandwidth = stats.bytes / stats.copySeconds;
+	double seconds = std::chrono::duration<double>(s->lastUpload - s->firstUpload).count();
+	if (stats.frames > 1 && seconds > 0.0) stats.uploadBandwidth = (stats.frames - 1) * (double)s->frameSize / seconds;
 
-	glGetIntegerv(GL_CURRENT_PROGRAM, &temp);	m_state.shaderProgram = temp;
-	glGetIntegerv(GL_ACTIVE_TEXTURE, &temp);	m_state.tex_active = temp;
+	m_lastError = Compositor::NONE;
+	return stats;
+}
 
-	for (int i = 0; i < 32; i++)
-	{
-		glActiveTexture(GL_TEXTURE0 + i);
-		glGetIntegerv(GL_TEXTURE_BINDING_2D, &temp);	m_state.tex_binds.push_back(temp);
-	}
+///
+/// \brief To delete a stream texture.
+/// To delete a stream, its texture, pixel buffers and mapped file.
+///
+bool Compositor::deleteStreamTexture(int streamID)
+{
+	stream* s = m_streams.find(streamID);
+	if (s == nullptr) RETURN_ERR(Compositor::STREAM_NOT_FOUND)
 
-	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &m_state.bufferVertexArray);
-	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &m_state.bufferArrayBuffer);
+	unmapStreamFile(*s);
+	for (int i = 0; i < STREAM_RING_SIZE; i++)
+		if (s->fences[i] != 0) glDeleteSync(s->fences[i]);
+	glDeleteBuffers(1, &s->pbo);		//also unmaps it
+	glDeleteTextures(1, &s->texture);
+	m_imageFormats.erase(s->texture);
+	m_streams.erase(streamID);
 
-	glGetBooleanv(GL_BLEND, &m_state.alphaBlend);
+	RETURN_OK()
 }
 
 ///
-/// \brief Restore OpenGL states after rendering.
-/// To restore OpenGL states after rendering so that states/settings from the compositor does not pollute out.
+/// \brief To start the resource thread.
+/// To start a thread which compiles and links shaders and uploads textures submitted with submitShaderSource() and 
+/// submitTextureUpload(), so they do not stall rendering. The main program creates a context sharing objects with the current one; 
+/// the callback is called on the new thread to make it current, and again when the thread stops to release it. The shaders shared by 
+/// batch passes are built first, so batch passes cannot be created while the thread runs if they failed. 
+/// Returns false with RESOURCE_THREAD_FAILED if the callback fails. Does nothing if the thread is already running.
 ///
-void Compositor::popState()
+bool Compositor::startResourceThread(resourceContextCallback callback, void* userData)
 {
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_state.fbo);
-	glViewport(m_state.viewport[0], m_state.viewport[1], m_state.viewport[2], m_state.viewport[3]);
-	glClearColor(m_state.clearColor[0], m_state.clearColor[1], m_state.clearColor[2], m_state.clearColor[3]);
-	glDepthFunc(m_state.depthMask);
+	if (m_resourceThread.joinable()) RETURN_OK()
+	if (callback == nullptr) RETURN_ERR(Compositor::RESOURCE_THREAD_FAILED)
 
-	for (int i = 0; i < m_state.tex_binds.size(); i++)
+	//the resource thread links batch programs with these shaders, they cannot be created while it runs
+	if (m_batchVertexShader == 0) initializeBatchShaders();
+	glFinish();
+
+	std::unique_lock<std::mutex> lock(m_resourceMutex);
+	m_resourceState = 0;
+	m_resourceThread = std::thread(&Compositor::resourceThreadMain, this, callback, userData);
+	m_resourceCondition.wait(lock, [this]() { return m_resourceState != 0; });
+	bool running = m_resourceState == 1;
+	lock.unlock();
+	if (!running)
 	{
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_state.tex_binds[i]);
+		m_resourceThread.join();
+		RETURN_ERR(Compositor::RESOURCE_THREAD_FAILED)
 	}
-	m_state.tex_binds.clear();
-
-	glActiveTexture(m_state.tex_active);							
-	glUseProgram(m_state.shaderProgram);							
 
-	glBindVertexArray(m_state.bufferVertexArray);					
-	glBindBuffer(GL_ARRAY_BUFFER, m_state.bufferArrayBuffer);		
-
-	if (m_state.alphaBlend == GL_TRUE) glEnable(GL_BLEND);
+	RETURN_OK()
 }
 
 ///
-/// \brief Render the specified pass.
-/// Render the specified pass.
+/// \brief To stop the resource thread.
+/// To stop the resource thread once the job it is building is done. Jobs which are not published yet are dropped without calling 
+/// their callback, and the objects already built for them are deleted.
 ///
-void Compositor::renderPassInternal(std::map<int, pass>::iterator p)
+void Compositor::stopResourceThread()
 {
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, p->second.fbo);
+	if (!m_resourceThread.joinable()) return;
 
-	std::map<char*, GLuint>::iterator t = p->second.texInputs.begin();
-	for (int i = 0; i < p->second.texInputs.size(); i++)
 	{
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, t->second);
-		++t;
+		std::lock_guard<std::mutex> lock(m_resourceMutex);
+		m_resourceState = -1;
 	}
+	m_resourceCondition.notify_all();
+	m_resourceThread.join();
+
+	m_resourceQueue.clear();
+	for (size_t i = 0; i < m_resourceBuilt.size(); i++) deleteResource(m_resourceBuilt[i]);
+	for (size_t i = 0; i < m_resourceFenced.size(); i++) deleteResource(m_resourceFenced[i]);
+	m_resourceBuilt.clear();
+	m_resourceFenced.clear();
+	m_resourceHasBuilt = false;
+	m_resourceJobsInFlight = 0;
+	m_lastError = Compositor::NONE;
+}
+
+///
+/// \brief To compile a shader for a pass on the resource thread.
+/// To submit a shader source to be compiled and linked on the resource thread. Once built, updateResourceJobs() installs it into the 
+/// pass (the previous shader is rendered until then) and calls the callback, which may be nullptr. If the shader fails, the pass is 
+/// PASS_FAILED with the log, as with loadShaderSourceAsync(). Can be called from any thread; the pass is only checked when the 
+/// shader is installed, kind must be the kind of shader of the pass, otherwise the pass is PASS_FAILED and updateResourceJobs() 
+/// fails with PASS_WRONG_KIND. Returns the Job ID, or -1 if the resource thread is not running. Does not change getLastError().
+///
+int Compositor::submitShaderSource(int passID, const char* source, shaderKind kind, resourceCallback callback, void* userData)
+{
+	resourceJob job;
+	job.passID = passID;
+	job.source = source;
+	job.compute = kind == SHADER_COMPUTE;
+	job.batch = kind == SHADER_BATCH;
+	job.width = job.height = 0;
+	job.internalFormat = job.format = job.type = GL_NONE;
+	job.callback = callback;
+	job.userData = userData;
+	job.object = job.shader = 0;
+	job.fence = 0;
+
+	std::lock_guard<std::mutex> lock(m_resourceMutex);
+	if (m_resourceState != 1) return -1;
+	int jobID = job.id = ++m_nextResourceJobID;
+	++m_resourceJobsInFlight;
+	m_resourceQueue.push_back(std::move(job));
+	m_resourceCondition.notify_one();
+	return jobID;
+}
+
+///
+/// \brief To create and fill a texture on the resource thread.
+/// To submit a texture to be created with the given size and internal format and filled with data (in the given format and type, 
+/// rows packed without padding, copied before returning) on the resource thread. Once the GPU finished the upload, updateResourceJobs() 
+/// calls the callback with the texture, which then belongs to the main program. Can be called from any thread. 
+/// Returns the Job ID, or -1 if the resource thread is not running. Does not change getLastError().
+///
+int Compositor::submitTextureUpload(int width, int height, GLenum internalFormat, GLenum format, GLenum type, const void* data, resourceCallback callback, void* userData)
+{
+	if (width <= 0 || height <= 0) return -1;
+
+	resourceJob job;
+	job.passID = 0;
+	job.compute = false;
+	job.batch = false;
+	job.width = width;
+	job.height = height;
+	job.internalFormat = internalFormat;
+	job.format = format;
+	job.type = type;
+	if (data != nullptr)
+	{
+		const char* bytes = (const char*)data;
+		job.pixels.assign(bytes, bytes + (size_t)width * height * pixelSize(format, type));
+	}
+	job.callback = callback;
+	job.userData = userData;
+	job.object = job.shader = 0;
+	job.fence = 0;
+
+	std::lock_guard<std::mutex> lock(m_resourceMutex);
+	if (m_resourceState != 1) return -1;
+	int jobID = job.id = ++m_nextResourceJobID;
+	++m_resourceJobsInFlight;
+	m_resourceQueue.push_back(std::move(job));
+	m_resourceCondition.notify_one();
+	return jobID;
+}
+
+///
+/// \brief To publish the objects built by the resource thread.
+/// To install the programs and hand over the textures built by the resource thread whose fence is signaled, calling their callbacks 
+/// in submission order. Never waits : the list of built jobs is only taken if the resource thread does not hold it. 
+/// Also called by renderPass() and renderPipeline(). Returns true if no job is in flight anymore. Sets PASS_WRONG_KIND if a shader 
+/// was submitted with a kind not matching its pass.
+///
+bool Compositor::updateResourceJobs()
+{
+	bool wrongKind = false;
+	if (m_resourceHasBuilt.load())
+	{
+		std::unique_lock<std::mutex> lock(m_resourceMutex, std::try_to_lock);
+		if (lock.owns_lock())
+		{
+			for (size_t i = 0; i < m_resourceBuilt.size(); i++)
+				m_resourceFenced.push_back(std::move(m_resourceBuilt[i]));
+			m_resourceBuilt.clear();
+			m_resourceHasBuilt = false;
+		}
+	}
+
+	//fences of one context are signaled in order
+	size_t published = 0;
+	for (; published < m_resourceFenced.size(); published++)
+	{
+		resourceJob& job = m_resourceFenced[published];
+		GLenum status = glClientWaitSync(job.fence, 0, 0);		//flushing would only flush this context
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+		glDeleteSync(job.fence);
+		job.fence = 0;
+		if (!publishResource(job)) wrongKind = true;
+	}
+	m_resourceFenced.erase(m_resourceFenced.begin(), m_resourceFenced.begin() + published);
+
+	m_lastError = wrongKind ? Compositor::PASS_WRONG_KIND : Compositor::NONE;
+	return m_resourceJobsInFlight.load() == 0;
+}
+
+///
+/// \brief To set how many readbacks can be in flight.
+/// To set the number of pixel buffers used for asynchronous readbacks, which is how many readbacks can be in flight (default 3). 
+/// Fails with READBACK_RING_FULL if a readback is not released yet.
+///
+bool Compositor::setReadbackRingSize(int size)
+{
+	if (size < 1) return false;
+	for (size_t i = 0; i < m_readbacks.size(); i++)
+		if (m_readbacks[i].id != 0) RETURN_ERR(Compositor::READBACK_RING_FULL)
+
+	deleteReadbacks();
+	readbackSlot slot;
+	memset(&slot, 0, sizeof(slot));
+	m_readbacks.assign(size, slot);
+	m_readbackNext = 0;
+
+	RETURN_OK()
+}
+
+///
+/// \brief To read an output of a pass back without waiting.
+/// To queue a copy of an output texture of a pass (as last rendered) into the next pixel buffer of the readback ring, converted to the 
+/// given format and type (as glReadPixels, rows packed without padding, bottom row first). Returns the Readback ID, or -1 with 
+/// READBACK_RING_FULL if the next pixel buffer is still in use. Outputs which are transient textures must be read before another 
+/// pipeline uses the pool. With frames in flight, the output is read from the frame slot the pass was last rendered into. 
+/// Fails with PASS_WRONG_KIND for batch passes, whose outputs are attached with all their layers.
+///
+int Compositor::readbackPassOutput(int passID, int texChannel, GLenum format, GLenum type)
+{
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) { m_lastError = Compositor::PASS_NOT_FOUND; return -1; }
+	if (p->batchSize > 0) { m_lastError = Compositor::PASS_WRONG_KIND; return -1; }
+	if (p->texOutputs.find(texChannel) == p->texOutputs.end()) { m_lastError = Compositor::TEXTURE_OUTPUT_NOT_FOUND; return -1; }
+	readbackSlot& slot = m_readbacks[m_readbackNext];
+	if (slot.id != 0) { m_lastError = Compositor::READBACK_RING_FULL; return -1; }
+
+	GLsizei w, h;
+	getPassSize(*p, w, h);
+	GLint readFbo, packBuffer, packAlignment;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFbo);
+	glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &packBuffer);
+	glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+
+	slot.size = (GLsizeiptr)w * h * pixelSize(format, type);
+	if (slot.pbo == 0) glGenBuffers(1, &slot.pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	if (slot.capacity < slot.size)
+	{
+		glBufferData(GL_PIXEL_PACK_BUFFER, slot.size, NULL, GL_STREAM_READ);
+		slot.capacity = slot.size;
+	}
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, p->renderedFbo != 0 ? p->renderedFbo : p->fbo);
+	glReadBuffer(GL_COLOR_ATTACHMENT0 + texChannel);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, w, h, format, type, (void*)0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffer);
+
+	slot.id = ++m_nextReadbackID;
+	slot.callback = nullptr;
+	slot.userData = nullptr;
+	m_readbackNext = (m_readbackNext + 1) % (int)m_readbacks.size();
+
+	m_lastError = Compositor::NONE;
+	return slot.id;
+}
+
+///
+/// \brief To set the function called when a readback is ready.
+/// To set a function called by updateReadbacks() with the mapped pixels once a readback is ready. The readback is released after the call.
+///
+bool Compositor::setReadbackCallback(int readbackID, readbackCallback callback, void* userData)
+{
+	readbackSlot* slot = findReadback(readbackID);
+	if (slot == nullptr) RETURN_ERR(Compositor::READBACK_NOT_FOUND)
+
+	slot->callback = callback;
+	slot->userData = userData;
+
+	RETURN_OK()
+}
+
+///
+/// \brief To get the state of a readback.
+/// To check, without waiting, whether the GPU finished copying the pixels of a readback.
+///
+Compositor::readbackState Compositor::getReadbackState(int readbackID)
+{
+	readbackSlot* slot = findReadback(readbackID);
+	if (slot == nullptr) { m_lastError = Compositor::READBACK_NOT_FOUND; return READBACK_NONE; }
+
+	m_lastError = Compositor::NONE;
+	return isReadbackReady(*slot) ? READBACK_READY : READBACK_PENDING;
+}
+
+///
+/// \brief To get the pixels of a readback.
+/// To map the pixel buffer of a readback which is ready and return its pixels, without copying them. Returns nullptr with 
+/// READBACK_NOT_READY if the GPU has not copied them yet. The pointer is valid until releaseReadback().
+///
+const void* Compositor::mapReadback(int readbackID, int* size)
+{
+	readbackSlot* slot = findReadback(readbackID);
+	if (slot == nullptr) { m_lastError = Compositor::READBACK_NOT_FOUND; return nullptr; }
+	if (!isReadbackReady(*slot)) { m_lastError = Compositor::READBACK_NOT_READY; return nullptr; }
+
+	if (slot->mapped == nullptr)
+	{
+		GLint packBuffer;
+		glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &packBuffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+		slot->mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot->size, GL_MAP_READ_BIT);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffer);
+	}
+	if (size != nullptr) *size = (int)slot->size;
+
+	m_lastError = Compositor::NONE;
+	return slot->mapped;
+}
+
+///
+/// \brief To release a readback.
+/// To unmap the pixel buffer of a readback and give it back to the ring. A pending readback can be released to drop it.
+///
+bool Compositor::releaseReadback(int readbackID)
+{
+	readbackSlot* slot = findReadback(readbackID);
+	if (slot == nullptr) RETURN_ERR(Compositor::READBACK_NOT_FOUND)
+
+	if (slot->mapped != nullptr)
+	{
+		GLint packBuffer;
+		glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &packBuffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffer);
+		slot->mapped = nullptr;
+	}
+	if (slot->fence != 0) glDeleteSync(slot->fence);
+	slot->fence = 0;
+	slot->id = 0;
+
+	RETURN_OK()
+}
+
+///
+/// \brief To call the callbacks of the readbacks which are ready.
+/// To call the callback of each readback which is ready, oldest first, and release it. Readbacks without callback are left to be polled.
+///
+void Compositor::updateReadbacks()
+{
+	int n = (int)m_readbacks.size();
+	for (int i = 0; i < n; i++)
+	{
+		readbackSlot& slot = m_readbacks[(m_readbackNext + i) % n];
+		if (slot.id == 0 || slot.callback == nullptr || !isReadbackReady(slot)) continue;
+		int id = slot.id, size = 0;
+		const void* data = mapReadback(id, &size);
+		slot.callback(id, data, size, slot.userData);
+		releaseReadback(id);
+	}
+	m_lastError = Compositor::NONE;
+}
+
+///
+/// \brief To delete a pipeline.
+/// To delete a pipeline.
+///
+bool Compositor::deletePipeline(int id)
+{
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) RETURN_ERR(Compositor::PIPELINE_NOT_FOUND)
+	else
+	{
+		deleteTimings(*p);
+		deleteFrames(*p, true);
+		m_pipelines.erase(id);
+	}
+
+	RETURN_OK()
+}
+
+///
+/// \brief To render a pipeline.
+/// To render a pipeline by sequentially render the passes. A graph pipeline is sorted again if any of its passes changed.
+///
+bool Compositor::renderPipeline(int id)
+{
+	if (m_resourceJobsInFlight.load() != 0) updateResourceJobs();
+	pipeline* p = m_pipelines.find(id);
+	if (p == nullptr) RETURN_ERR(Compositor::PIPELINE_NOT_FOUND)
+	else
+	{
+		if (canReplay(*p) && replayPipeline(*p)) RETURN_OK()
+		for (size_t i = 0; i < p->passes.size(); i++)
+		{
+			pass* p2 = m_passes.find(p->passes[i]);
+			if (p2 != nullptr) updatePendingShader(*p2);
+		}
+		if (p->resolvedVersion != pipelineVersion(*p) && !resolvePipeline(*p)) return false;
+		if (!verifyPipeline(p->order)) RETURN_ERR(Compositor::PIPELINE_NOT_COMPLETE)
+		bool buffered = p->framesInFlight > 1;
+		int slot = p->frameNext;
+		if (buffered && !isFrameDone(p->frames[slot])) RETURN_ERR(Compositor::PIPELINE_FRAME_BUSY)
+		for (size_t i = 0; buffered && p->framesVersion != pipelineVersion(*p) && i < p->order.size(); i++)
+			if (m_passes[p->order[i]].batchSize > 0) RETURN_ERR(Compositor::PASS_WRONG_KIND)		//frame copies are not arrays
+		pushState();
+		if (p->transientVersion != pipelineVersion(*p) && !allocateTransients(*p)) { popState(); return false; }
+		if (buffered)
+		{
+			if (p->framesVersion != pipelineVersion(*p)) setupFrames(*p);
+			swapFrame(*p, slot);
+		}
+		updateUniformBlocks();
+		if (!p->transientTextures.empty()) applyTransients(*p);
+		if (canReplay(*p)) bakePipeline(*p);
+		timingFrame* frame = p->timing ? beginTiming(*p) : nullptr;
+		std::vector<damageRect> regions;
+		if (p->damageTracking && !buffered) computeDamage(*p, regions);
+		else setScissor(GL_FALSE, 0, 0, 0, 0);
+		p->memo.lastRendered = 0;
+		p->memo.lastSkipped = 0;
+		for (int i = 0; i < (int)p->order.size(); i++)
+		{
+			if (p->barriers[i] != 0) glMemoryBarrier(p->barriers[i]);
+			pass& p2 = m_passes[p->order[i]];
+			if (p->memoization && !buffered && !isPassChanged(p2)) { ++p->memo.lastSkipped; continue; }
+			if (!regions.empty())
+			{
+				const damageRect& r = regions[i];
+				if (r.x0 >= r.x1 || r.y0 >= r.y1) { ++p->memo.lastSkipped; continue; }		//nothing changed, the previous outputs are kept
+				if (r.x0 <= 0.0f && r.y0 <= 0.0f && r.x1 >= 1.0f && r.y1 >= 1.0f) setScissor(GL_FALSE, 0, 0, 0, 0);
+				else
+				{
+					GLsizei w, h;
+					getPassSize(p2, w, h);
+					GLint x0 = (GLint)floor(r.x0 * w), y0 = (GLint)floor(r.y0 * h);
+					GLint x1 = (GLint)ceil(r.x1 * w), y1 = (GLint)ceil(r.y1 * h);
+					setScissor(GL_TRUE, x0, y0, x1 - x0, y1 - y0);
+				}
+			}
+			markOutputsChanged(p2);
+			p2.renderedFbo = buffered ? p2.fbo : 0;		//swapped with the framebuffer of the slot
+			if (!p->fusedGroup.empty() && p->fusedGroup[i] != NOT_FUSED)
+			{
+				if (p->fusedGroup[i] < 0) continue;
+				++p->memo.lastRendered;
+				renderFusedInternal(p->fused[p->fusedGroup[i]], p->actions[i]);
+			}
+			else
+			{
+				++p->memo.lastRendered;
+				renderPassInternal(p2, p->actions[i]);
+			}
+			if (!p->damageTracking && !p->memoization) invalidateInputs(p->actions[i]);
+			if (frame != nullptr) recordTiming(*frame, p->order[i]);
+		}
+		p->memo.totalRendered += p->memo.lastRendered;
+		p->memo.totalSkipped += p->memo.lastSkipped;
+		if (p->finalBarrier != 0) glMemoryBarrier(p->finalBarrier);
+		if (p->damageTracking)
+		{
+			p->damage.clear();
+			p->damageValid = !buffered;
+		}
+		if (frame != nullptr) frame->pending = true;
+		++p->frameCount;
+		if (buffered)
+		{
+			swapFrame(*p, slot);
+			p->frames[slot].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			p->frames[slot].number = p->frameCount;
+			p->frameNext = (slot + 1) % p->framesInFlight;
+		}
+		popState();
+	}
+
+	RETURN_OK()
+}
+
+///
+/// \brief To create a uniform block shared by all passes.
+/// To create a uniform block shared by all passes, for values used by many passes (e.g. time, resolution, exposure). 
+/// Every shader declaring a uniform block with this name (std140 layout) reads it, so writing a value once with 
+/// Compositor::setUniformBlockData() updates all passes. The size is grown to the largest size declared by the shaders. 
+/// Returns the Uniform block ID, or -1 if the name is already used or no binding point is left.
+///
+int Compositor::createUniformBlock(char* name, int size)
+{
+	if (m_uniformBlockIDs.find(name) != m_uniformBlockIDs.end()) { m_lastError = Compositor::UNIFORM_BLOCK_EXISTS; return -1; }
+
+	//blocks take binding points from the top, the main program usually uses the lowest ones
+	std::vector<bool> used(m_maxUniformBindings, false);
+	for (size_t i = 0; i < m_uniformBlocks.slotCount(); i++)
+		if (m_uniformBlocks.at(i) != nullptr) used[m_uniformBlocks.at(i)->binding] = true;
+	int binding = m_maxUniformBindings - 1;
+	while (binding >= 0 && used[binding]) binding--;
+	if (binding < 0) { m_lastError = Compositor::UNIFORM_BLOCK_NO_BINDING; return -1; }
+
+	uniformBlock newBlock;
+	newBlock.name = name;
+	newBlock.data.assign(std::max(size, 0), 0);
+	newBlock.binding = binding;
+	newBlock.dirty = true;
+	newBlock.offset = 0;
+	int blockID = m_uniformBlocks.insert(newBlock);
+	m_uniformBlockIDs[name] = blockID;
+	++m_uniformBlocksVersion;
+
+	//shaders loaded before the block was created
+	for (size_t i = 0; i < m_passes.slotCount(); i++)
+		if (m_passes.at(i) != nullptr && m_passes.at(i)->shaderProgram != 0) bindUniformBlocks(m_passes.at(i)->shaderProgram);
+	std::map<std::string, fusedProgram>::iterator f;
+	for (f = m_fusedPrograms.begin(); f != m_fusedPrograms.end(); ++f)
+		if (!f->second.failed) bindUniformBlocks(f->second.program);
+
+	m_lastError = Compositor::NONE;
+	return blockID;
+}
+
+///
+/// \brief To write values into a uniform block.
+/// To write bytes into a uniform block at the given offset (std140 layout). The values are copied to the GPU once, 
+/// at the next rendering, and are seen by every pass using the block.
+///
+bool Compositor::setUniformBlockData(int blockID, int offset, const void* data, int size)
+{
+	uniformBlock* b = m_uniformBlocks.find(blockID);
+	if (b == nullptr) RETURN_ERR(Compositor::UNIFORM_BLOCK_NOT_FOUND)
+	if (offset < 0 || size < 0 || (size_t)offset + size > b->data.size()) RETURN_ERR(Compositor::UNIFORM_BLOCK_OUT_OF_RANGE)
+
+	if (size > 0) memcpy(&b->data[offset], data, size);
+	b->dirty = true;
+	++m_uniformBlocksVersion;
+
+	RETURN_OK()
+}
+
+///
+/// \brief To delete a uniform block.
+/// To delete a uniform block. Shaders declaring it read whatever is bound to its binding point afterwards.
+///
+bool Compositor::deleteUniformBlock(int blockID)
+{
+	uniformBlock* b = m_uniformBlocks.find(blockID);
+	if (b == nullptr) RETURN_ERR(Compositor::UNIFORM_BLOCK_NOT_FOUND)
+
+	m_uniformBlockIDs.erase(b->name);
+	m_uniformBlocks.erase(blockID);
+	++m_uniformBlocksVersion;
+
+	RETURN_OK()
+}
+
+///
+/// \brief To get handle of a uniform.
+/// To get handle of an active uniform, so that it can be set later without looking up its name. 
+/// The handle is valid until another shader is loaded into the pass. Returns -1 if the uniform is not active in the pass program.
+///
+int Compositor::getUniformHandle(int passID, char* uniName)
+{
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) { m_lastError = Compositor::PASS_NOT_FOUND; return -1; }
+
+	std::map<std::string, int>::iterator u = p->uniformHandles.find(uniName);
+	if (u == p->uniformHandles.end()) { m_lastError = Compositor::UNIFORM_NOT_FOUND; return -1; }
+
+	m_lastError = Compositor::NONE;
+	return u->second;
+}
+
+///
+/// \brief To enable or disable uniform staging.
+/// To enable or disable uniform staging. When enabled, setUniformValue*(...) only stores the value in the pass and marks it dirty, 
+/// and the dirty values are uploaded in one batch when the pass is rendered. Setting the same value again is ignored in both modes.
+/// When staging is disabled, values which are still pending are uploaded right away.
+///
+void Compositor::setUniformStaging(bool enable)
+{
+	if (m_uniformStaging && !enable)
+	{
+		for (size_t i = 0; i < m_passes.slotCount(); i++)
+			if (m_passes.at(i) != nullptr) flushUniforms(*m_passes.at(i), m_passes.at(i)->shaderProgram);
+	}
+	m_uniformStaging = enable;
+	m_lastError = Compositor::NONE;
+}
+
+///
+/// \brief To set how OpenGL states of the main program are saved and restored.
+/// To set how OpenGL states of the main program are saved and restored around rendering. See Compositor::stateMode.
+///
+void Compositor::setStateMode(stateMode mode)
+{
+	m_stateMode = mode;
+	invalidateStateCache();
+	m_lastError = Compositor::NONE;
+}
+
+///
+/// \brief To forget the OpenGL states cached by the compositor.
+/// To forget the OpenGL states cached by the compositor. With STATE_HOST_COOPERATES, the main program has to call this after it 
+/// changes framebuffer, program, vertex array, texture bindings, viewport, clear color, depth mask or blending, 
+/// or after it deletes a texture used by the compositor.
+///
+void Compositor::invalidateStateCache()
+{
+	m_cache.valid = 0;
+	m_cache.texValid = 0;
+	m_cache.texArrayValid = 0;
+	m_cache.uniformRanges.clear();
+	m_cache.imageUnits.clear();
+	m_state.valid = 0;
+	m_state.texValid = 0;
+	m_state.texArrayValid = 0;
+	m_state.uniformRanges.clear();
+	m_state.imageUnits.clear();
+	m_imageFormats.clear();		//the main program might have created textures again with other formats
+
+	//the main program might have changed the uniform buffer bindings, so copy and bind the uniform blocks again
+	for (size_t i = 0; i < m_uniformBlocks.slotCount(); i++)
+		if (m_uniformBlocks.at(i) != nullptr) m_uniformBlocks.at(i)->dirty = true;
+}
+
+///
+/// \brief To get counters of the state tracker.
+/// To get the number of OpenGL state calls issued and avoided since the last Compositor::resetStateStats(). 
+/// Avoided calls are redundant state changes, and save/restore calls which a full save/restore would have made.
+///
+Compositor::stateStats Compositor::getStateStats()
+{
+	return m_stats;
+}
+
+///
+/// \brief To reset counters of the state tracker.
+/// To reset counters of the state tracker.
+///
+void Compositor::resetStateStats()
+{
+	m_stats.callsIssued = 0;
+	m_stats.callsAvoided = 0;
+}
+
+///
+/// \brief To set 1D uniform value.
+/// To set 1D uniform value
+///
+bool Compositor::setUniformValue1f(int passID, char* uniName, GLfloat v0)
+{
+	GLfloat v[1] = { v0 };
+	return setUniformByName(passID, uniName, UNIFORM_FLOAT, 1, v);
+}
+
+///
+/// \brief To set 1D uniform value by handle.
+/// To set 1D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue1f(int passID, int uniHandle, GLfloat v0)
+{
+	GLfloat v[1] = { v0 };
+	return setUniformByHandle(passID, uniHandle, UNIFORM_FLOAT, 1, v);
+}
+
+///
+/// \brief To set 2D uniform value.
+/// To set 2D uniform value
+///
+bool Compositor::setUniformValue2f(int passID, char* uniName, GLfloat v0, GLfloat v1)
+{
+	GLfloat v[2] = { v0, v1 };
+	return setUniformByName(passID, uniName, UNIFORM_FLOAT, 2, v);
+}
+
+///
+/// \brief To set 2D uniform value by handle.
+/// To set 2D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue2f(int passID, int uniHandle, GLfloat v0, GLfloat v1)
+{
+	GLfloat v[2] = { v0, v1 };
+	return setUniformByHandle(passID, uniHandle, UNIFORM_FLOAT, 2, v);
+}
+
+///
+/// \brief To set 3D uniform value.
+/// To set 3D uniform value
+///
+bool Compositor::setUniformValue3f(int passID, char* uniName, GLfloat v0, GLfloat v1, GLfloat v2)
+{
+	GLfloat v[3] = { v0, v1, v2 };
+	return setUniformByName(passID, uniName, UNIFORM_FLOAT, 3, v);
+}
+
+///
+/// \brief To set 3D uniform value by handle.
+/// To set 3D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue3f(int passID, int uniHandle, GLfloat v0, GLfloat v1, GLfloat v2)
+{
+	GLfloat v[3] = { v0, v1, v2 };
+	return setUniformByHandle(passID, uniHandle, UNIFORM_FLOAT, 3, v);
+}
+
+///
+/// \brief To set 4D uniform value.
+/// To set 4D uniform value
+///
+bool Compositor::setUniformValue4f(int passID, char* uniName, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+{
+	GLfloat v[4] = { v0, v1, v2, v3 };
+	return setUniformByName(passID, uniName, UNIFORM_FLOAT, 4, v);
+}
+
+///
+/// \brief To set 4D uniform value by handle.
+/// To set 4D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue4f(int passID, int uniHandle, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+{
+	GLfloat v[4] = { v0, v1, v2, v3 };
+	return setUniformByHandle(passID, uniHandle, UNIFORM_FLOAT, 4, v);
+}
+
+///
+/// \brief To set 1D uniform value.
+/// To set 1D uniform value
+///
+bool Compositor::setUniformValue1i(int passID, char* uniName, GLint v0)
+{
+	GLint v[1] = { v0 };
+	return setUniformByName(passID, uniName, UNIFORM_INT, 1, v);
+}
+
+///
+/// \brief To set 1D uniform value by handle.
+/// To set 1D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue1i(int passID, int uniHandle, GLint v0)
+{
+	GLint v[1] = { v0 };
+	return setUniformByHandle(passID, uniHandle, UNIFORM_INT, 1, v);
+}
+
+///
+/// \brief To set 2D uniform value.
+/// To set 2D uniform value
+///
+bool Compositor::setUniformValue2i(int passID, char* uniName, GLint v0, GLint v1)
+{
+	GLint v[2] = { v0, v1 };
+	return setUniformByName(passID, uniName, UNIFORM_INT, 2, v);
+}
+
+///
+/// \brief To set 2D uniform value by handle.
+/// To set 2D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue2i(int passID, int uniHandle, GLint v0, GLint v1)
+{
+	GLint v[2] = { v0, v1 };
+	return setUniformByHandle(passID, uniHandle, UNIFORM_INT, 2, v);
+}
+
+///
+/// \brief To set 3D uniform value.
+/// To set 3D uniform value
+///
+bool Compositor::setUniformValue3i(int passID, char* uniName, GLint v0, GLint v1, GLint v2)
+{
+	GLint v[3] = { v0, v1, v2 };
+	return setUniformByName(passID, uniName, UNIFORM_INT, 3, v);
+}
+
+///
+/// \brief To set 3D uniform value by handle.
+/// To set 3D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue3i(int passID, int uniHandle, GLint v0, GLint v1, GLint v2)
+{
+	GLint v[3] = { v0, v1, v2 };
+	return setUniformByHandle(passID, uniHandle, UNIFORM_INT, 3, v);
+}
+
+///
+/// \brief To set 4D uniform value.
+/// To set 4D uniform value
+///
+bool Compositor::setUniformValue4i(int passID, char* uniName, GLint v0, GLint v1, GLint v2, GLint v3)
+{
+	GLint v[4] = { v0, v1, v2, v3 };
+	return setUniformByName(passID, uniName, UNIFORM_INT, 4, v);
+}
+
+///
+/// \brief To set 4D uniform value by handle.
+/// To set 4D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue4i(int passID, int uniHandle, GLint v0, GLint v1, GLint v2, GLint v3)
+{
+	GLint v[4] = { v0, v1, v2, v3 };
+	return setUniformByHandle(passID, uniHandle, UNIFORM_INT, 4, v);
+}
+
+///
+/// \brief To set 1D uniform value.
+/// To set 1D uniform value
+///
+bool Compositor::setUniformValue1ui(int passID, char* uniName, GLuint v0)
+{
+	GLuint v[1] = { v0 };
+	return setUniformByName(passID, uniName, UNIFORM_UINT, 1, v);
+}
+
+///
+/// \brief To set 1D uniform value by handle.
+/// To set 1D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue1ui(int passID, int uniHandle, GLuint v0)
+{
+	GLuint v[1] = { v0 };
+	return setUniformByHandle(passID, uniHandle, UNIFORM_UINT, 1, v);
+}
+
+///
+/// \brief To set 2D uniform value.
+/// To set 2D uniform value
+///
+bool Compositor::setUniformValue2ui(int passID, char* uniName, GLuint v0, GLuint v1)
+{
+	GLuint v[2] = { v0, v1 };
+	return setUniformByName(passID, uniName, UNIFORM_UINT, 2, v);
+}
+
+///
+/// \brief To set 2D uniform value by handle.
+/// To set 2D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue2ui(int passID, int uniHandle, GLuint v0, GLuint v1)
+{
+	GLuint v[2] = { v0, v1 };
+	return setUniformByHandle(passID, uniHandle, UNIFORM_UINT, 2, v);
+}
+
+///
+/// \brief To set 3D uniform value.
+/// To set 3D uniform value
+///
+bool Compositor::setUniformValue3ui(int passID, char* uniName, GLuint v0, GLuint v1, GLuint v2)
+{
+	GLuint v[3] = { v0, v1, v2 };
+	return setUniformByName(passID, uniName, UNIFORM_UINT, 3, v);
+}
+
+///
+/// \brief To set 3D uniform value by handle.
+/// To set 3D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue3ui(int passID, int uniHandle, GLuint v0, GLuint v1, GLuint v2)
+{
+	GLuint v[3] = { v0, v1, v2 };
+	return setUniformByHandle(passID, uniHandle, UNIFORM_UINT, 3, v);
+}
+
+///
+/// \brief To set 4D uniform value.
+/// To set 4D uniform value
+///
+bool Compositor::setUniformValue4ui(int passID, char* uniName, GLuint v0, GLuint v1, GLuint v2, GLuint v3)
+{
+	GLuint v[4] = { v0, v1, v2, v3 };
+	return setUniformByName(passID, uniName, UNIFORM_UINT, 4, v);
+}
+
+///
+/// \brief To set 4D uniform value by handle.
+/// To set 4D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue4ui(int passID, int uniHandle, GLuint v0, GLuint v1, GLuint v2, GLuint v3)
+{
+	GLuint v[4] = { v0, v1, v2, v3 };
+	return setUniformByHandle(passID, uniHandle, UNIFORM_UINT, 4, v);
+}
+
+///
+/// \brief To set 1D uniform value.
+/// To set 1D uniform value
+///
+bool Compositor::setUniformValue1fv(int passID, char* uniName, GLfloat *v)
+{
+	return setUniformByName(passID, uniName, UNIFORM_FLOAT, 1, v);
+}
+
+///
+/// \brief To set 1D uniform value by handle.
+/// To set 1D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue1fv(int passID, int uniHandle, GLfloat *v)
+{
+	return setUniformByHandle(passID, uniHandle, UNIFORM_FLOAT, 1, v);
+}
+
+///
+/// \brief To set 2D uniform value.
+/// To set 2D uniform value
+///
+bool Compositor::setUniformValue2fv(int passID, char* uniName, GLfloat *v)
+{
+	return setUniformByName(passID, uniName, UNIFORM_FLOAT, 2, v);
+}
+
+///
+/// \brief To set 2D uniform value by handle.
+/// To set 2D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue2fv(int passID, int uniHandle, GLfloat *v)
+{
+	return setUniformByHandle(passID, uniHandle, UNIFORM_FLOAT, 2, v);
+}
+
+///
+/// \brief To set 3D uniform value.
+/// To set 3D uniform value
+///
+bool Compositor::setUniformValue3fv(int passID, char* uniName, GLfloat *v)
+{
+	return setUniformByName(passID, uniName, UNIFORM_FLOAT, 3, v);
+}
+
+///
+/// \brief To set 3D uniform value by handle.
+/// To set 3D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue3fv(int passID, int uniHandle, GLfloat *v)
+{
+	return setUniformByHandle(passID, uniHandle, UNIFORM_FLOAT, 3, v);
+}
+
+///
+/// \brief To set 4D uniform value.
+/// To set 4D uniform value
+///
+bool Compositor::setUniformValue4fv(int passID, char* uniName, GLfloat *v)
+{
+	return setUniformByName(passID, uniName, UNIFORM_FLOAT, 4, v);
+}
+
+///
+/// \brief To set 4D uniform value by handle.
+/// To set 4D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue4fv(int passID, int uniHandle, GLfloat *v)
+{
+	return setUniformByHandle(passID, uniHandle, UNIFORM_FLOAT, 4, v);
+}
+
+///
+/// \brief To set 1D uniform value.
+/// To set 1D uniform value
+///
+bool Compositor::setUniformValue1iv(int passID, char* uniName, GLint *v)
+{
+	return setUniformByName(passID, uniName, UNIFORM_INT, 1, v);
+}
+
+///
+/// \brief To set 1D uniform value by handle.
+/// To set 1D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue1iv(int passID, int uniHandle, GLint *v)
+{
+	return setUniformByHandle(passID, uniHandle, UNIFORM_INT, 1, v);
+}
+
+///
+/// \brief To set 2D uniform value.
+/// To set 2D uniform value
+///
+bool Compositor::setUniformValue2iv(int passID, char* uniName, GLint *v)
+{
+	return setUniformByName(passID, uniName, UNIFORM_INT, 2, v);
+}
+
+///
+/// \brief To set 2D uniform value by handle.
+/// To set 2D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue2iv(int passID, int uniHandle, GLint *v)
+{
+	return setUniformByHandle(passID, uniHandle, UNIFORM_INT, 2, v);
+}
+
+///
+/// \brief To set 3D uniform value.
+/// To set 3D uniform value
+///
+bool Compositor::setUniformValue3iv(int passID, char* uniName, GLint *v)
+{
+	return setUniformByName(passID, uniName, UNIFORM_INT, 3, v);
+}
+
+///
+/// \brief To set 3D uniform value by handle.
+/// To set 3D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue3iv(int passID, int uniHandle, GLint *v)
+{
+	return setUniformByHandle(passID, uniHandle, UNIFORM_INT, 3, v);
+}
+
+///
+/// \brief To set 4D uniform value.
+/// To set 4D uniform value
+///
+bool Compositor::setUniformValue4iv(int passID, char* uniName, GLint *v)
+{
+	return setUniformByName(passID, uniName, UNIFORM_INT, 4, v);
+}
+
+///
+/// \brief To set 4D uniform value by handle.
+/// To set 4D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue4iv(int passID, int uniHandle, GLint *v)
+{
+	return setUniformByHandle(passID, uniHandle, UNIFORM_INT, 4, v);
+}
+
+///
+/// \brief To set 1D uniform value.
+/// To set 1D uniform value
+///
+bool Compositor::setUniformValue1uiv(int passID, char* uniName, GLuint *v)
+{
+	return setUniformByName(passID, uniName, UNIFORM_UINT, 1, v);
+}
+
+///
+/// \brief To set 1D uniform value by handle.
+/// To set 1D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue1uiv(int passID, int uniHandle, GLuint *v)
+{
+	return setUniformByHandle(passID, uniHandle, UNIFORM_UINT, 1, v);
+}
+
+///
+/// \brief To set 2D uniform value.
+/// To set 2D uniform value
+///
+bool Compositor::setUniformValue2uiv(int passID, char* uniName, GLuint *v)
+{
+	return setUniformByName(passID, uniName, UNIFORM_UINT, 2, v);
+}
+
+///
+/// \brief To set 2D uniform value by handle.
+/// To set 2D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue2uiv(int passID, int uniHandle, GLuint *v)
+{
+	return setUniformByHandle(passID, uniHandle, UNIFORM_UINT, 2, v);
+}
+
+///
+/// \brief To set 3D uniform value.
+/// To set 3D uniform value
+///
+bool Compositor::setUniformValue3uiv(int passID, char* uniName, GLuint *v)
+{
+	return setUniformByName(passID, uniName, UNIFORM_UINT, 3, v);
+}
+
+///
+/// \brief To set 3D uniform value by handle.
+/// To set 3D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue3uiv(int passID, int uniHandle, GLuint *v)
+{
+	return setUniformByHandle(passID, uniHandle, UNIFORM_UINT, 3, v);
+}
+
+///
+/// \brief To set 4D uniform value.
+/// To set 4D uniform value
+///
+bool Compositor::setUniformValue4uiv(int passID, char* uniName, GLuint *v)
+{
+	return setUniformByName(passID, uniName, UNIFORM_UINT, 4, v);
+}
+
+///
+/// \brief To set 4D uniform value by handle.
+/// To set 4D uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformValue4uiv(int passID, int uniHandle, GLuint *v)
+{
+	return setUniformByHandle(passID, uniHandle, UNIFORM_UINT, 4, v);
+}
+
+///
+/// \brief To set textures as input to the pass.
+/// To set textures as input to the pass. It is pair : texChannel - texID. texChannel is to be used for glActiveTexture(GL_TEXTURE0 - GL_TEXTURE31) before the rendering, 
+///	and textID is to be used glBindTexture(GL_TEXTURE_2D, texID).
+/// We do not check whether the texture is valid. Should it be implemented here, or it is responsibility of main program ?
+///
+bool Compositor::setUniformTexture(int passID, char* texUniform, GLuint texID)
+{
+	//todo : return false if the program is wrong
+	//todo : return false if the uniform can't be found
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+	else
+	{
+		int sampler = internSampler(texUniform);
+		m_imageFormats.erase(texID);		//the texture might have been created again with another format
+		std::map<int, GLuint>::iterator t = p->texInputs.find(sampler);
+		if (t != p->texInputs.end() && t->second == texID && p->transientInputs.find(sampler) == p->transientInputs.end()) RETURN_OK()
+		setInputTexture(*p, sampler, texID);
+		p->transientInputs.erase(sampler);
+		changePass(*p);
+	}
+
+	RETURN_OK()
+}
+
+///
+/// \brief To remove texture uniform. This function might not be needed.
+/// To remove texture uniform. This function might not be needed.
+///
+bool Compositor::deleteUniformTexture(int passID, char* texUniform)
+{
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+	else
+	{
+		std::map<std::string, int>::iterator id = m_samplerIDs.find(texUniform);
+		if (id == m_samplerIDs.end() || p->texInputs.find(id->second) == p->texInputs.end()) RETURN_ERR(Compositor::TEXTURE_UNIFORM_NOT_FOUND)
+		setInputTexture(*p, id->second, 0);
+		p->texInputs.erase(id->second);
+		p->transientInputs.erase(id->second);
+		changePass(*p);
+	}
+
+	RETURN_OK()
+}
+
+///
+/// \brief To set texture as the render target in which channel in MRT.
+/// To set texture as the render target in which channel in MRT.
+///
+bool Compositor::setOutputTexture(int passID, int texChannel, GLuint texID)
+{
+	if (texChannel < 0 || texChannel >= MAX_OUTPUT_CHANNELS) return false; //openGL limitation
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+	else
+	{
+		m_imageFormats.erase(texID);
+		std::map<int, GLuint>::iterator o = p->texOutputs.find(texChannel);
+		if (o != p->texOutputs.end() && o->second == texID && p->transientOutputs.find(texChannel) == p->transientOutputs.end()) RETURN_OK()
+
+		p->texOutputs[texChannel] = texID;
+		p->transientOutputs.erase(texChannel);
+		changePass(*p);
+		GLint drawFboId;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFboId);
+
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, p->fbo);
+		if (p->batchSize > 0) glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + texChannel, texID, 0);		//all layers
+		else glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + texChannel, GL_TEXTURE_2D, texID, 0);
+		updateDrawBuffers(*p);
+
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFboId);
+	}
+
+	RETURN_OK()
+}
+
+///
+/// \brief To delete a specific texture MRT. Might not be needed.
+/// To delete a specific texture MRT. Might not be needed.
+///
+bool Compositor::deleteOutputTexture(int passID, int texChannel)
+{
+	if (texChannel < 0 || texChannel >= MAX_OUTPUT_CHANNELS) return false; //openGL limitation
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+	else
+	{
+		std::map<int, GLuint>::iterator p2 = p->texOutputs.find(texChannel);
+
+		if (p2 == p->texOutputs.end()) RETURN_ERR(Compositor::TEXTURE_OUTPUT_NOT_FOUND)
+
+		p->texOutputs.erase(p2);
+		p->transientOutputs.erase(texChannel);
+		changePass(*p);
+
+		GLint drawFboId;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFboId);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, p->fbo);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + texChannel, GL_TEXTURE_2D, 0, 0);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFboId);
+		updateDrawBuffers(*p);
+	}
+
+	RETURN_OK()
+}
+
+///
+/// \brief To set what is done with the previous content of an output before a pass renders.
+/// To set whether an output is cleared, invalidated (the shader writes every pixel, so its previous content is not needed, which 
+/// saves reading it back on tiled GPUs) or kept before a pass renders. By default, outputs are cleared if the shader contains discard 
+/// and invalidated otherwise. Invalidation is skipped when only part of the output is rendered (damage tracking). Compute passes 
+/// ignore load actions.
+///
+bool Compositor::setOutputLoadAction(int passID, int texChannel, loadAction action)
+{
+	if (texChannel < 0 || texChannel >= MAX_OUTPUT_CHANNELS) return false; //openGL limitation
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+
+	std::map<int, loadAction>::iterator a = p->loadActions.find(texChannel);
+	if ((a == p->loadActions.end() ? LOAD_ACTION_DEFAULT : a->second) == action) RETURN_OK()
+	if (action == LOAD_ACTION_DEFAULT) p->loadActions.erase(texChannel);
+	else p->loadActions[texChannel] = action;
+	changePass(*p);
+
+	RETURN_OK()
+}
+
+///
+/// \brief To set what is done with an output after a pass renders.
+/// To set whether an output is kept or invalidated after a pass renders. By default, an output is invalidated when it is rendered 
+/// by a pipeline and nothing can read it : no pass of the pipeline reads it and it is a transient texture, or a texture not 
+/// requested from a graph pipeline. Compute passes ignore store actions.
+///
+bool Compositor::setOutputStoreAction(int passID, int texChannel, storeAction action)
+{
+	if (texChannel < 0 || texChannel >= MAX_OUTPUT_CHANNELS) return false; //openGL limitation
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+
+	std::map<int, storeAction>::iterator a = p->storeActions.find(texChannel);
+	if ((a == p->storeActions.end() ? STORE_ACTION_DEFAULT : a->second) == action) RETURN_OK()
+	if (action == STORE_ACTION_DEFAULT) p->storeActions.erase(texChannel);
+	else p->storeActions[texChannel] = action;
+	changePass(*p);
+
+	RETURN_OK()
+}
+
+///
+/// \brief To create a transient texture.
+/// To create a transient texture, which is an intermediate render target owned by the compositor. It is only declared by its size 
+/// and format, the actual texture is assigned from a pool when a pipeline using it is rendered. Transient textures whose lifetimes 
+/// in a pipeline do not overlap share the same texture, so their content is only valid while the pipeline renders.
+///
+int Compositor::createTransientTexture(int width, int height, GLenum internalFormat)
+{
+	transient newTransient;
+	newTransient.width = width;
+	newTransient.height = height;
+	newTransient.internalFormat = internalFormat;
+	m_transients[m_nextTransientID] = newTransient;
+
+	m_lastError = Compositor::NONE;
+	return m_nextTransientID++;
+}
+
+///
+/// \brief To delete a transient texture.
+/// To delete a transient texture. Passes still using it cannot be rendered until it is replaced.
+///
+bool Compositor::deleteTransientTexture(int transientID)
+{
+	std::map<int, transient>::iterator t = m_transients.find(transientID);
+	if (t == m_transients.end()) RETURN_ERR(Compositor::TRANSIENT_NOT_FOUND)
+	m_transients.erase(t);
+	m_globalVersion = ++m_passesVersion;
+
+	RETURN_OK()
+}
+
+///
+/// \brief To set a transient texture as input to the pass.
+/// To set a transient texture as input to the pass, same as Compositor::setUniformTexture().
+///
+bool Compositor::setTransientInput(int passID, char* texUniform, int transientID)
+{
+	if (m_transients.find(transientID) == m_transients.end()) RETURN_ERR(Compositor::TRANSIENT_NOT_FOUND)
+	if (!setUniformTexture(passID, texUniform, 0)) return false;
+	m_passes[passID].transientInputs[internSampler(texUniform)] = transientID;
+	changePass(m_passes[passID]);
+
+	RETURN_OK()
+}
+
+///
+/// \brief To set a transient texture as the render target in which channel in MRT.
+/// To set a transient texture as the render target in which channel in MRT, same as Compositor::setOutputTexture().
+///
+bool Compositor::setTransientOutput(int passID, int texChannel, int transientID)
+{
+	if (m_transients.find(transientID) == m_transients.end()) RETURN_ERR(Compositor::TRANSIENT_NOT_FOUND)
+	pass* p = m_passes.find(passID);
+	if (p != nullptr && p->batchSize > 0) RETURN_ERR(Compositor::PASS_WRONG_KIND)		//transient textures are not arrays
+	if (!setOutputTexture(passID, texChannel, 0)) return false;
+	m_passes[passID].transientOutputs[texChannel] = transientID;
+	changePass(m_passes[passID]);
+
+	RETURN_OK()
+}
+
+///
+/// \brief To get the texture assigned to a transient texture.
+/// To get the texture assigned to a transient texture in the last rendering of a pipeline. Returns 0 if it is not assigned.
+///
+GLuint Compositor::getTransientTexture(int pipelineID, int transientID)
+{
+	pipeline* p = m_pipelines.find(pipelineID);
+	if (p == nullptr) { m_lastError = Compositor::PIPELINE_NOT_FOUND; return 0; }
+	std::map<int, GLuint>::iterator t = p->transientTextures.find(transientID);
+	if (t == p->transientTextures.end()) { m_lastError = Compositor::TRANSIENT_NOT_FOUND; return 0; }
+
+	m_lastError = Compositor::NONE;
+	return t->second;
+}
+
+///
+/// \brief To get memory usage of the transient texture pool.
+/// To get memory of the textures in the transient pool, compared to the memory needed if every transient texture had its own texture.
+///
+Compositor::poolStats Compositor::getPoolStats()
+{
+	poolStats stats;
+	stats.transientCount = (unsigned int)m_transients.size();
+	stats.textureCount = (unsigned int)m_pool.size();
+	stats.naiveBytes = 0;
+	stats.peakBytes = 0;
+
+	std::map<int, transient>::iterator t;
+	for (t = m_transients.begin(); t != m_transients.end(); ++t)
+		stats.naiveBytes += (unsigned long long)t->second.width * t->second.height * bytesPerPixel(t->second.internalFormat);
+	for (size_t i = 0; i < m_pool.size(); i++)
+		stats.peakBytes += (unsigned long long)m_pool[i].width * m_pool[i].height * bytesPerPixel(m_pool[i].internalFormat);
+
+	return stats;
+}
+
+///
+/// \brief To delete textures of the transient pool.
+/// To delete all textures of the transient pool. They are created again when a pipeline needs them.
+///
+void Compositor::clearTransientPool()
+{
+	for (size_t i = 0; i < m_pool.size(); i++)
+	{
+		m_imageFormats.erase(m_pool[i].texture);
+		glDeleteTextures(1, &m_pool[i].texture);
+	}
+	m_pool.clear();
+	m_globalVersion = ++m_passesVersion;
+}
+
+///
+/// \brief Query OpenGL version and extensions.
+/// To query OpenGL version and extensions once, so that the faster code paths can be chosen without asking the driver every time.
+///
+void Compositor::initializeCapabilities()
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	m_glVersion = major * 10 + minor;
+
+	m_hasProgramUniform = m_glVersion >= 41 || hasExtension("GL_ARB_separate_shader_objects");
+	m_hasMultiBind = m_glVersion >= 44 || hasExtension("GL_ARB_multi_bind");
+	m_hasCompute = m_glVersion >= 43 || hasExtension("GL_ARB_compute_shader");
+	m_hasBufferStorage = m_glVersion >= 44 || hasExtension("GL_ARB_buffer_storage");
+	m_hasInvalidate = m_glVersion >= 43 || hasExtension("GL_ARB_invalidate_subdata");
+	m_hasBaseInstance = m_glVersion >= 42 || hasExtension("GL_ARB_base_instance");
+	m_hasVertexLayer = hasExtension("GL_ARB_shader_viewport_layer_array") || hasExtension("GL_AMD_vertex_shader_layer");
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &m_uniformBufferAlignment);
+	glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &m_maxUniformBindings);
+
+	m_hasParallelCompile = false;
+	if (hasExtension("GL_KHR_parallel_shader_compile"))
+	{
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);		//let the driver choose the number of compiler threads
+		m_hasParallelCompile = true;
+	}
+	else if (hasExtension("GL_ARB_parallel_shader_compile"))
+	{
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		m_hasParallelCompile = true;
+	}
+
+	m_programBinaryFormats.clear();
+	if (m_glVersion >= 41 || hasExtension("GL_ARB_get_program_binary"))
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+		if (count > 0)
+		{
+			m_programBinaryFormats.resize(count);
+			glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, &m_programBinaryFormats[0]);
+		}
+	}
+
+	const char* strings[3] = { (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION) };
+	m_driverString.clear();
+	for (int i = 0; i < 3; i++)
+	{
+		if (strings[i] != NULL) m_driverString += strings[i];
+		m_driverString += '\n';
+	}
+}
+
+///
+/// \brief To check whether an OpenGL extension is supported.
+/// To check whether an OpenGL extension is supported.
+///
+bool Compositor::hasExtension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+		if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0) return true;
+	return false;
+}
+
+///
+/// \brief Initialize Vertex Shader.
+/// To initialize Vertex Shader for composition operation. As it is just a simple full-screen quad drawing, it can be used for all other passes.
+///
+void Compositor::initializeVertexShader()
+{
+	static const char* vertex_shader_text =
+		"#version 330 compatibility\n"
+		"in vec3 vPos;\n"
+		"out vec2 in_uv;\n"
+		"void main()\n"
+		"{\n"
+		"mat4 MVP = mat4(vec4(2.0, 0.0, 0.0, 0.0),\n"
+		"                vec4(0.0, 2.0, 0.0, 0.0),\n"
+		"                vec4(0.0, 0.0, -1.0, 0.0),\n"
+		"                vec4(-1.0, -1.0, 0.0, 1.0));\n"
+		"    gl_Position = MVP * vec4(vPos, 1.0);\n"
+		"    in_uv.xy = vPos.xy;"
+		"}\n";
+
+	m_vertexSource = vertex_shader_text;
+	m_shaderVertex = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(m_shaderVertex, 1, &vertex_shader_text, 0);
+	glCompileShader(m_shaderVertex);
+}
+
+///
+/// \brief To create buffer for storing quad for composition.
+/// To create buffer for storing quad for composition.
+///
+void Compositor::initializeBufferObject()
+{
+	const GLfloat vertices[] = {
+		0.0f, 0.0f, 0.0f,
+		1.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f,
+		1.0f, 1.0f, 0.0f
+	};
+
+	GLint bufferVertexArray, bufferArrayBuffer;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &bufferVertexArray);
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &bufferArrayBuffer);
+
+	/* Allocate and assign a Vertex Array Object to our handle */
+	glGenVertexArrays(1, &m_vertexArray);
+	/* Bind our Vertex Array Object as the current used object */
+	glBindVertexArray(m_vertexArray);
+
+	// Generate 1 buffer, put the resulting identifier in vertexbuffer
+	glGenBuffers(1, &m_vertexBuffer);
+	// The following commands will talk about our 'vertexbuffer' buffer
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	// Give our vertices to OpenGL.
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+	glBindVertexArray(bufferVertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, bufferArrayBuffer);
+}
+
+///
+/// \brief Save OpenGL states before rendering.
+/// To save OpenGL states before starting rendering so that states/settings from main program does not pollute in.
+/// With STATE_FULL_RESTORE every state is queried here, except image units, which only compute passes use and which are queried 
+/// right before the compositor binds them. With STATE_MINIMAL_RESTORE nothing is queried here, each state is queried by 
+/// Compositor::saveState() right before the compositor changes it. With STATE_HOST_COOPERATES nothing is saved.
+///
+void Compositor::pushState()
+{
+	m_saveRestoreCalls = 0;
+	if (m_stateMode == STATE_HOST_COOPERATES) return;
+
+	//the main program might have changed anything since the last rendering
+	m_cache.valid = 0;
+	m_cache.texValid = 0;
+	m_cache.texArrayValid = 0;
+	m_cache.uniformRanges.clear();
+	m_cache.imageUnits.clear();
+	m_state.valid = 0;
+	m_state.texValid = 0;
+	m_state.texArrayValid = 0;
+	m_state.uniformRanges.clear();
+	m_state.imageUnits.clear();
+
+	if (m_stateMode == STATE_FULL_RESTORE)
+	{
+		saveState(CACHED_ALL);
+		for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+		{
+			saveTexture(i, GL_TEXTURE_2D);
+			saveTexture(i, GL_TEXTURE_2D_ARRAY);
+		}
+		for (size_t i = 0; i < m_uniformBlocks.slotCount(); i++)
+			if (m_uniformBlocks.at(i) != nullptr) saveUniformRange(m_uniformBlocks.at(i)->binding);
+	}
+}
+
+///
+/// \brief Restore OpenGL states after rendering.
+/// To restore OpenGL states after rendering so that states/settings from the compositor does not pollute out.
+/// Only the saved states which the compositor changed to a different value are restored.
+///
+void Compositor::popState()
+{
+	if (m_stateMode == STATE_HOST_COOPERATES)
+	{
+		m_stats.callsAvoided += FULL_STATE_CALLS;
+		return;
+	}
+
+	//binding a range also binds the generic binding point, so it is restored afterwards
+	std::map<GLuint, bufferRange>::iterator r;
+	for (r = m_state.uniformRanges.begin(); r != m_state.uniformRanges.end(); ++r)
+	{
+		std::map<GLuint, bufferRange>::iterator c = m_cache.uniformRanges.find(r->first);
+		if (c != m_cache.uniformRanges.end() && c->second.buffer == r->second.buffer && c->second.offset == r->second.offset && c->second.size == r->second.size) continue;
+		if (r->second.size == 0) glBindBufferBase(GL_UNIFORM_BUFFER, r->first, r->second.buffer);
+		else glBindBufferRange(GL_UNIFORM_BUFFER, r->first, r->second.buffer, r->second.offset, r->second.size);
+		m_cache.uniformBuffer = r->second.buffer;
+		++m_saveRestoreCalls;
+	}
+
+	unsigned int changed = m_state.valid & ~m_cache.valid;
+	if ((m_state.valid & m_cache.valid & CACHED_FBO) && m_cache.fbo != m_state.fbo) changed |= CACHED_FBO;
+	if ((m_state.valid & m_cache.valid & CACHED_PROGRAM) && m_cache.shaderProgram != m_state.shaderProgram) changed |= CACHED_PROGRAM;
+	if ((m_state.valid & m_cache.valid & CACHED_VERTEX_ARRAY) && m_cache.bufferVertexArray != m_state.bufferVertexArray) changed |= CACHED_VERTEX_ARRAY;
+	if ((m_state.valid & m_cache.valid & CACHED_ARRAY_BUFFER) && m_cache.bufferArrayBuffer != m_state.bufferArrayBuffer) changed |= CACHED_ARRAY_BUFFER;
+	if ((m_state.valid & m_cache.valid & CACHED_VIEWPORT) && memcmp(m_cache.viewport, m_state.viewport, sizeof(m_state.viewport)) != 0) changed |= CACHED_VIEWPORT;
+	if ((m_state.valid & m_cache.valid & CACHED_CLEAR_COLOR) && memcmp(m_cache.clearColor, m_state.clearColor, sizeof(m_state.clearColor)) != 0) changed |= CACHED_CLEAR_COLOR;
+	if ((m_state.valid & m_cache.valid & CACHED_DEPTH_MASK) && m_cache.depthMask != m_state.depthMask) changed |= CACHED_DEPTH_MASK;
+	if ((m_state.valid & m_cache.valid & CACHED_BLEND) && m_cache.alphaBlend != m_state.alphaBlend) changed |= CACHED_BLEND;
+	if ((m_state.valid & m_cache.valid & CACHED_BLEND_FUNC) && memcmp(m_cache.blendFunc, m_state.blendFunc, sizeof(m_state.blendFunc)) != 0) changed |= CACHED_BLEND_FUNC;
+	if ((m_state.valid & m_cache.valid & CACHED_SCISSOR_TEST) && m_cache.scissorTest != m_state.scissorTest) changed |= CACHED_SCISSOR_TEST;
+	if ((m_state.valid & m_cache.valid & CACHED_SCISSOR_BOX) && memcmp(m_cache.scissorBox, m_state.scissorBox, sizeof(m_state.scissorBox)) != 0) changed |= CACHED_SCISSOR_BOX;
+	if ((m_state.valid & m_cache.valid & CACHED_UNIFORM_BUFFER) && m_cache.uniformBuffer != m_state.uniformBuffer) changed |= CACHED_UNIFORM_BUFFER;
+
+	if (changed & CACHED_FBO) { glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_state.fbo); ++m_saveRestoreCalls; }
+	if (changed & CACHED_VIEWPORT) { glViewport(m_state.viewport[0], m_state.viewport[1], m_state.viewport[2], m_state.viewport[3]); ++m_saveRestoreCalls; }
+	if (changed & CACHED_CLEAR_COLOR) { glClearColor(m_state.clearColor[0], m_state.clearColor[1], m_state.clearColor[2], m_state.clearColor[3]); ++m_saveRestoreCalls; }
+	if (changed & CACHED_DEPTH_MASK) { glDepthMask(m_state.depthMask); ++m_saveRestoreCalls; }
+
+	for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+	{
+		if ((m_state.texValid & (1u << i)) && !((m_cache.texValid & (1u << i)) && m_cache.tex_binds[i] == m_state.tex_binds[i]))
+		{
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(GL_TEXTURE_2D, m_state.tex_binds[i]);
+			m_cache.tex_active = GL_TEXTURE0 + i;
+			m_saveRestoreCalls += 2;
+		}
+		if ((m_state.texArrayValid & (1u << i)) && !((m_cache.texArrayValid & (1u << i)) && m_cache.tex_array_binds[i] == m_state.tex_array_binds[i]))
+		{
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, m_state.tex_array_binds[i]);
+			m_cache.tex_active = GL_TEXTURE0 + i;
+			m_saveRestoreCalls += 2;
+		}
+	}
+	std::map<GLuint, imageBinding>::iterator im;
+	for (im = m_state.imageUnits.begin(); im != m_state.imageUnits.end(); ++im)
+	{
+		const imageBinding& b = im->second;
+		std::map<GLuint, imageBinding>::iterator c = m_cache.imageUnits.find(im->first);
+		if (c != m_cache.imageUnits.end() && c->second.texture == b.texture && c->second.level == b.level && c->second.layered == b.layered && 
+			c->second.layer == b.layer && c->second.access == b.access && c->second.format == b.format) continue;
+		glBindImageTexture(im->first, b.texture, b.level, b.layered, b.layer, b.access, b.format);
+		++m_saveRestoreCalls;
+	}
+	if ((m_state.valid & CACHED_ACTIVE_TEXTURE) && m_cache.tex_active != m_state.tex_active) { glActiveTexture(m_state.tex_active); ++m_saveRestoreCalls; }
+
+	if (changed & CACHED_PROGRAM) { glUseProgram(m_state.shaderProgram); ++m_saveRestoreCalls; }
+	if (changed & CACHED_VERTEX_ARRAY) { glBindVertexArray(m_state.bufferVertexArray); ++m_saveRestoreCalls; }
+	if (changed & CACHED_ARRAY_BUFFER) { glBindBuffer(GL_ARRAY_BUFFER, m_state.bufferArrayBuffer); ++m_saveRestoreCalls; }
+	if (changed & CACHED_BLEND) { if (m_state.alphaBlend == GL_TRUE) glEnable(GL_BLEND); else glDisable(GL_BLEND); ++m_saveRestoreCalls; }
+	if (changed & CACHED_BLEND_FUNC)
+	{
+		glBlendFuncSeparate(m_state.blendFunc[0], m_state.blendFunc[1], m_state.blendFunc[2], m_state.blendFunc[3]);
+		glBlendEquationSeparate(m_state.blendFunc[4], m_state.blendFunc[5]);
+		++m_saveRestoreCalls;
+	}
+	if (changed & CACHED_SCISSOR_TEST) { if (m_state.scissorTest == GL_TRUE) glEnable(GL_SCISSOR_TEST); else glDisable(GL_SCISSOR_TEST); ++m_saveRestoreCalls; }
+	if (changed & CACHED_SCISSOR_BOX) { glScissor(m_state.scissorBox[0], m_state.scissorBox[1], m_state.scissorBox[2], m_state.scissorBox[3]); ++m_saveRestoreCalls; }
+	if (changed & CACHED_UNIFORM_BUFFER) { glBindBuffer(GL_UNIFORM_BUFFER, m_state.uniformBuffer); ++m_saveRestoreCalls; }
+
+	m_stats.callsIssued += m_saveRestoreCalls;
+	if (m_saveRestoreCalls < FULL_STATE_CALLS) m_stats.callsAvoided += FULL_STATE_CALLS - m_saveRestoreCalls;
+}
+
+///
+/// \brief To save OpenGL states of the main program.
+/// To query the given states of the main program, unless they are already saved. The queried values are also the current 
+/// values, so they are stored in the state cache as well. Does nothing with STATE_HOST_COOPERATES.
+///
+void Compositor::saveState(unsigned int bits)
+{
+	if (m_stateMode == STATE_HOST_COOPERATES) return;
+	bits &= ~m_state.valid;
+	if (bits == 0) return;
+
+	GLint temp;
+	if (bits & CACHED_FBO) { glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &temp); m_state.fbo = temp; m_cache.fbo = temp; ++m_saveRestoreCalls; }
+	if (bits & CACHED_VIEWPORT) { glGetIntegerv(GL_VIEWPORT, m_state.viewport); memcpy(m_cache.viewport, m_state.viewport, sizeof(m_state.viewport)); ++m_saveRestoreCalls; }
+	if (bits & CACHED_CLEAR_COLOR) { glGetFloatv(GL_COLOR_CLEAR_VALUE, m_state.clearColor); memcpy(m_cache.clearColor, m_state.clearColor, sizeof(m_state.clearColor)); ++m_saveRestoreCalls; }
+	if (bits & CACHED_DEPTH_MASK) { glGetBooleanv(GL_DEPTH_WRITEMASK, &m_state.depthMask); m_cache.depthMask = m_state.depthMask; ++m_saveRestoreCalls; }
+	if (bits & CACHED_PROGRAM) { glGetIntegerv(GL_CURRENT_PROGRAM, &temp); m_state.shaderProgram = temp; m_cache.shaderProgram = temp; ++m_saveRestoreCalls; }
+	if (bits & CACHED_ACTIVE_TEXTURE) { glGetIntegerv(GL_ACTIVE_TEXTURE, &temp); m_state.tex_active = temp; m_cache.tex_active = temp; ++m_saveRestoreCalls; }
+	if (bits & CACHED_VERTEX_ARRAY) { glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &m_state.bufferVertexArray); m_cache.bufferVertexArray = m_state.bufferVertexArray; ++m_saveRestoreCalls; }
+	if (bits & CACHED_ARRAY_BUFFER) { glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &m_state.bufferArrayBuffer); m_cache.bufferArrayBuffer = m_state.bufferArrayBuffer; ++m_saveRestoreCalls; }
+	if (bits & CACHED_BLEND) { glGetBooleanv(GL_BLEND, &m_state.alphaBlend); m_cache.alphaBlend = m_state.alphaBlend; ++m_saveRestoreCalls; }
+	if (bits & CACHED_BLEND_FUNC)
+	{
+		static const GLenum names[6] = { GL_BLEND_SRC_RGB, GL_BLEND_DST_RGB, GL_BLEND_SRC_ALPHA, GL_BLEND_DST_ALPHA, GL_BLEND_EQUATION_RGB, GL_BLEND_EQUATION_ALPHA };
+		for (int i = 0; i < 6; i++) glGetIntegerv(names[i], &m_state.blendFunc[i]);
+		memcpy(m_cache.blendFunc, m_state.blendFunc, sizeof(m_state.blendFunc));
+		++m_saveRestoreCalls;
+	}
+	if (bits & CACHED_SCISSOR_TEST) { glGetBooleanv(GL_SCISSOR_TEST, &m_state.scissorTest); m_cache.scissorTest = m_state.scissorTest; ++m_saveRestoreCalls; }
+	if (bits & CACHED_SCISSOR_BOX) { glGetIntegerv(GL_SCISSOR_BOX, m_state.scissorBox); memcpy(m_cache.scissorBox, m_state.scissorBox, sizeof(m_state.scissorBox)); ++m_saveRestoreCalls; }
+	if (bits & CACHED_UNIFORM_BUFFER) { glGetIntegerv(GL_UNIFORM_BUFFER_BINDING, &temp); m_state.uniformBuffer = temp; m_cache.uniformBuffer = temp; ++m_saveRestoreCalls; }
+
+	m_state.valid |= bits;
+	m_cache.valid |= bits;
+}
+
+///
+/// \brief To save the texture binding of a texture unit of the main program.
+/// To save the texture bound to a target (GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY) of a texture unit of the main program, unless it 
+/// is already saved.
+///
+void Compositor::saveTexture(int unit, GLenum target)
+{
+	bool array = target == GL_TEXTURE_2D_ARRAY;
+	if (m_stateMode == STATE_HOST_COOPERATES || ((array ? m_state.texArrayValid : m_state.texValid) & (1u << unit))) return;
+
+	saveState(CACHED_ACTIVE_TEXTURE);
+	if (m_cache.tex_active != (GLenum)(GL_TEXTURE0 + unit))
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		++m_saveRestoreCalls;
+		m_cache.tex_active = GL_TEXTURE0 + unit;
+	}
+
+	GLint temp;
+	glGetIntegerv(array ? GL_TEXTURE_BINDING_2D_ARRAY : GL_TEXTURE_BINDING_2D, &temp);
+	++m_saveRestoreCalls;
+	if (array)
+	{
+		m_state.tex_array_binds[unit] = temp;
+		m_cache.tex_array_binds[unit] = temp;
+		m_state.texArrayValid |= 1u << unit;
+		m_cache.texArrayValid |= 1u << unit;
+	}
+	else
+	{
+		m_state.tex_binds[unit] = temp;
+		m_cache.tex_binds[unit] = temp;
+		m_state.texValid |= 1u << unit;
+		m_cache.texValid |= 1u << unit;
+	}
+}
+
+///
+/// \brief To save the buffer range bound to a uniform buffer binding point of the main program.
+/// To save the buffer range bound to a uniform buffer binding point of the main program, unless it is already saved.
+///
+void Compositor::saveUniformRange(GLuint index)
+{
+	if (m_stateMode == STATE_HOST_COOPERATES || m_state.uniformRanges.find(index) != m_state.uniformRanges.end()) return;
+
+	GLint buffer = 0;
+	GLint64 offset = 0, size = 0;
+	glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, index, &buffer);
+	glGetInteger64i_v(GL_UNIFORM_BUFFER_START, index, &offset);
+	glGetInteger64i_v(GL_UNIFORM_BUFFER_SIZE, index, &size);
+	++m_saveRestoreCalls;
+	bufferRange range = { (GLuint)buffer, (GLintptr)offset, (GLsizeiptr)size };
+	m_state.uniformRanges[index] = range;
+	m_cache.uniformRanges[index] = range;
+}
+
+///
+/// \brief To save the texture bound to an image unit of the main program.
+/// To save the texture bound to an image unit of the main program, unless it is already saved.
+///
+void Compositor::saveImageUnit(GLuint unit)
+{
+	if (m_stateMode == STATE_HOST_COOPERATES || m_state.imageUnits.find(unit) != m_state.imageUnits.end()) return;
+
+	GLint texture = 0, level = 0, layer = 0, access = 0, format = 0;
+	imageBinding b;
+	glGetIntegeri_v(GL_IMAGE_BINDING_NAME, unit, &texture);
+	glGetIntegeri_v(GL_IMAGE_BINDING_LEVEL, unit, &level);
+	glGetBooleani_v(GL_IMAGE_BINDING_LAYERED, unit, &b.layered);
+	glGetIntegeri_v(GL_IMAGE_BINDING_LAYER, unit, &layer);
+	glGetIntegeri_v(GL_IMAGE_BINDING_ACCESS, unit, &access);
+	glGetIntegeri_v(GL_IMAGE_BINDING_FORMAT, unit, &format);
+	++m_saveRestoreCalls;
+	b.texture = texture;
+	b.level = level;
+	b.layer = layer;
+	b.access = access;
+	b.format = format;
+	m_state.imageUnits[unit] = b;
+	m_cache.imageUnits[unit] = b;
+}
+
+///
+/// \brief To bind draw framebuffer through the state cache.
+/// To bind draw framebuffer through the state cache.
+///
+void Compositor::bindFramebuffer(GLuint fbo)
+{
+	saveState(CACHED_FBO);
+	if ((m_cache.valid & CACHED_FBO) && m_cache.fbo == fbo) { ++m_stats.callsAvoided; return; }
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+	++m_stats.callsIssued;
+	m_cache.fbo = fbo;
+	m_cache.valid |= CACHED_FBO;
+}
+
+///
+/// \brief To bind program through the state cache.
+/// To bind program through the state cache.
+///
+void Compositor::useProgram(GLuint program)
+{
+	saveState(CACHED_PROGRAM);
+	if ((m_cache.valid & CACHED_PROGRAM) && m_cache.shaderProgram == program) { ++m_stats.callsAvoided; return; }
+	glUseProgram(program);
+	++m_stats.callsIssued;
+	m_cache.shaderProgram = program;
+	m_cache.valid |= CACHED_PROGRAM;
+}
+
+///
+/// \brief To bind vertex array and array buffer through the state cache.
+/// To bind vertex array and array buffer through the state cache.
+///
+void Compositor::bindVertexArray(GLuint vertexArray, GLuint arrayBuffer)
+{
+	saveState(CACHED_VERTEX_ARRAY | CACHED_ARRAY_BUFFER);
+	if ((m_cache.valid & CACHED_VERTEX_ARRAY) && m_cache.bufferVertexArray == (GLint)vertexArray) ++m_stats.callsAvoided;
+	else
+	{
+		glBindVertexArray(vertexArray);
+		++m_stats.callsIssued;
+		m_cache.bufferVertexArray = vertexArray;
+		m_cache.valid |= CACHED_VERTEX_ARRAY;
+	}
+	if ((m_cache.valid & CACHED_ARRAY_BUFFER) && m_cache.bufferArrayBuffer == (GLint)arrayBuffer) ++m_stats.callsAvoided;
+	else
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, arrayBuffer);
+		++m_stats.callsIssued;
+		m_cache.bufferArrayBuffer = arrayBuffer;
+		m_cache.valid |= CACHED_ARRAY_BUFFER;
+	}
+}
+
+///
+/// \brief To select active texture unit through the state cache.
+/// To select active texture unit through the state cache.
+///
+void Compositor::setActiveTexture(GLenum unit)
+{
+	saveState(CACHED_ACTIVE_TEXTURE);
+	if ((m_cache.valid & CACHED_ACTIVE_TEXTURE) && m_cache.tex_active == unit) { ++m_stats.callsAvoided; return; }
+	glActiveTexture(unit);
+	++m_stats.callsIssued;
+	m_cache.tex_active = unit;
+	m_cache.valid |= CACHED_ACTIVE_TEXTURE;
+}
+
+///
+/// \brief To bind texture to a texture unit through the state cache.
+/// To bind texture to a target (GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY) of a texture unit through the state cache. 
+/// The active texture unit is only changed if the binding changes.
+///
+void Compositor::bindTexture(int unit, GLuint texID, GLenum target)
+{
+	bool array = target == GL_TEXTURE_2D_ARRAY;
+	GLint* binds = array ? m_cache.tex_array_binds : m_cache.tex_binds;
+	unsigned int& valid = array ? m_cache.texArrayValid : m_cache.texValid;
+	saveTexture(unit, target);
+	if ((valid & (1u << unit)) && binds[unit] == (GLint)texID) { m_stats.callsAvoided += 2; return; }
+	setActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(target, texID);
+	++m_stats.callsIssued;
+	binds[unit] = texID;
+	valid |= 1u << unit;
+}
+
+///
+/// \brief To bind textures to the first texture units.
+/// To bind textures to texture units 0 to textures.size() - 1, skipping the units which already hold the right texture. 
+/// The units which changed are bound with a single glBindTextures call when multi-bind is available.
+///
+void Compositor::bindTextures(const std::vector<GLuint>& textures, unsigned int arrayUnits)
+{
+	if (!textures.empty()) bindTextures(0, (int)textures.size(), &textures[0], arrayUnits);
+}
+
+///
+/// \brief To bind textures to a range of texture units.
+/// To bind count textures to texture units unit to unit + count - 1, skipping the units which already hold the right texture. 
+/// Bit i of arrayUnits is set if textures[i] is an array texture; only needed without multi-bind, which binds to the texture target.
+///
+void Compositor::bindTextures(int unit, int count, const GLuint* textures, unsigned int arrayUnits)
+{
+	int first = -1, last = -1;
+	for (int i = 0; i < count; i++)
+	{
+		bool array = (arrayUnits & (1u << i)) != 0;
+		saveTexture(unit + i, array ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D);
+		GLint* binds = array ? m_cache.tex_array_binds : m_cache.tex_binds;
+		unsigned int valid = array ? m_cache.texArrayValid : m_cache.texValid;
+		if ((valid & (1u << (unit + i))) && binds[unit + i] == (GLint)textures[i]) { m_stats.callsAvoided += 2; continue; }
+		if (first < 0) first = i;
+		last = i;
+	}
+	if (first < 0) return;
+
+	if (!m_hasMultiBind)
+	{
+		for (int i = first; i <= last; i++)
+			bindTexture(unit + i, textures[i], (arrayUnits & (1u << i)) ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D);
+		return;
+	}
+	//glBindTextures binds each texture to its own target, and 0 to every target of the unit
+	for (int i = first; i <= last; i++)
+		if (textures[i] == 0) { saveTexture(unit + i, GL_TEXTURE_2D); saveTexture(unit + i, GL_TEXTURE_2D_ARRAY); }
+	glBindTextures(unit + first, last - first + 1, &textures[first]);
+	++m_stats.callsIssued;
+	for (int i = first; i <= last; i++)
+	{
+		if (textures[i] == 0 || (arrayUnits & (1u << i)) == 0)
+		{
+			m_cache.tex_binds[unit + i] = textures[i];
+			m_cache.texValid |= 1u << (unit + i);
+		}
+		if (textures[i] == 0 || (arrayUnits & (1u << i)) != 0)
+		{
+			m_cache.tex_array_binds[unit + i] = textures[i];
+			m_cache.texArrayValid |= 1u << (unit + i);
+		}
+	}
+}
+
+///
+/// \brief To set viewport through the state cache.
+/// To set viewport through the state cache.
+///
+void Compositor::setViewport(GLint x, GLint y, GLsizei w, GLsizei h)
+{
+	saveState(CACHED_VIEWPORT);
+	GLint viewport[4] = { x, y, w, h };
+	if ((m_cache.valid & CACHED_VIEWPORT) && memcmp(m_cache.viewport, viewport, sizeof(viewport)) == 0) { ++m_stats.callsAvoided; return; }
+	glViewport(x, y, w, h);
+	++m_stats.callsIssued;
+	memcpy(m_cache.viewport, viewport, sizeof(viewport));
+	m_cache.valid |= CACHED_VIEWPORT;
+}
+
+///
+/// \brief To set clear color through the state cache.
+/// To set clear color through the state cache.
+///
+void Compositor::setClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+	saveState(CACHED_CLEAR_COLOR);
+	GLfloat color[4] = { r, g, b, a };
+	if ((m_cache.valid & CACHED_CLEAR_COLOR) && memcmp(m_cache.clearColor, color, sizeof(color)) == 0) { ++m_stats.callsAvoided; return; }
+	glClearColor(r, g, b, a);
+	++m_stats.callsIssued;
+	memcpy(m_cache.clearColor, color, sizeof(color));
+	m_cache.valid |= CACHED_CLEAR_COLOR;
+}
+
+///
+/// \brief To set depth write mask through the state cache.
+/// To set depth write mask through the state cache.
+///
+void Compositor::setDepthMask(GLboolean mask)
+{
+	saveState(CACHED_DEPTH_MASK);
+	if ((m_cache.valid & CACHED_DEPTH_MASK) && m_cache.depthMask == mask) { ++m_stats.callsAvoided; return; }
+	glDepthMask(mask);
+	++m_stats.callsIssued;
+	m_cache.depthMask = mask;
+	m_cache.valid |= CACHED_DEPTH_MASK;
+}
+
+///
+/// \brief To enable or disable blending through the state cache.
+/// To enable or disable blending through the state cache.
+///
+void Compositor::setBlend(GLboolean enable)
+{
+	saveState(CACHED_BLEND);
+	if ((m_cache.valid & CACHED_BLEND) && m_cache.alphaBlend == enable) { ++m_stats.callsAvoided; return; }
+	if (enable == GL_TRUE) glEnable(GL_BLEND); else glDisable(GL_BLEND);
+	++m_stats.callsIssued;
+	m_cache.alphaBlend = enable;
+	m_cache.valid |= CACHED_BLEND;
+}
+
+///
+/// \brief To set the blend function through the state cache.
+/// To set the RGB source and destination factors through the state cache. Alpha is always blended as premultiplied "over" 
+/// (GL_ONE, GL_ONE_MINUS_SRC_ALPHA), and both equations are GL_FUNC_ADD.
+///
+void Compositor::setBlendFunc(GLenum source, GLenum destination)
+{
+	saveState(CACHED_BLEND_FUNC);
+	GLint func[6] = { (GLint)source, (GLint)destination, GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_FUNC_ADD, GL_FUNC_ADD };
+	if ((m_cache.valid & CACHED_BLEND_FUNC) && memcmp(m_cache.blendFunc, func, sizeof(func)) == 0) { ++m_stats.callsAvoided; return; }
+	glBlendFuncSeparate(source, destination, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	if (!(m_cache.valid & CACHED_BLEND_FUNC) || m_cache.blendFunc[4] != GL_FUNC_ADD || m_cache.blendFunc[5] != GL_FUNC_ADD) glBlendEquation(GL_FUNC_ADD);
+	++m_stats.callsIssued;
+	memcpy(m_cache.blendFunc, func, sizeof(func));
+	m_cache.valid |= CACHED_BLEND_FUNC;
+}
+
+///
+/// \brief To set the scissor test through the state cache.
+/// To enable the scissor test with the given box, or disable it, through the state cache. The box is ignored when disabling.
+///
+void Compositor::setScissor(GLboolean enable, GLint x, GLint y, GLsizei w, GLsizei h)
+{
+	saveState(CACHED_SCISSOR_TEST);
+	if ((m_cache.valid & CACHED_SCISSOR_TEST) && m_cache.scissorTest == enable) ++m_stats.callsAvoided;
+	else
+	{
+		if (enable == GL_TRUE) glEnable(GL_SCISSOR_TEST); else glDisable(GL_SCISSOR_TEST);
+		++m_stats.callsIssued;
+		m_cache.scissorTest = enable;
+		m_cache.valid |= CACHED_SCISSOR_TEST;
+	}
+	if (enable != GL_TRUE) return;
+
+	saveState(CACHED_SCISSOR_BOX);
+	GLint box[4] = { x, y, w, h };
+	if ((m_cache.valid & CACHED_SCISSOR_BOX) && memcmp(m_cache.scissorBox, box, sizeof(box)) == 0) { ++m_stats.callsAvoided; return; }
+	glScissor(x, y, w, h);
+	++m_stats.callsIssued;
+	memcpy(m_cache.scissorBox, box, sizeof(box));
+	m_cache.valid |= CACHED_SCISSOR_BOX;
+}
+
+///
+/// \brief To bind the generic uniform buffer binding point through the state cache.
+/// To bind the generic uniform buffer binding point through the state cache.
+///
+void Compositor::bindUniformBuffer(GLuint buffer)
+{
+	saveState(CACHED_UNIFORM_BUFFER);
+	if ((m_cache.valid & CACHED_UNIFORM_BUFFER) && m_cache.uniformBuffer == buffer) { ++m_stats.callsAvoided; return; }
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	++m_stats.callsIssued;
+	m_cache.uniformBuffer = buffer;
+	m_cache.valid |= CACHED_UNIFORM_BUFFER;
+}
+
+///
+/// \brief To bind a buffer range to a uniform buffer binding point through the state cache.
+/// To bind a buffer range to a uniform buffer binding point through the state cache. As glBindBufferRange also binds the 
+/// generic binding point, it is saved and cached too.
+///
+void Compositor::bindUniformRange(GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	saveUniformRange(index);
+	saveState(CACHED_UNIFORM_BUFFER);
+	std::map<GLuint, bufferRange>::iterator c = m_cache.uniformRanges.find(index);
+	if (c != m_cache.uniformRanges.end() && c->second.buffer == buffer && c->second.offset == offset && c->second.size == size) { ++m_stats.callsAvoided; return; }
+	glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, offset, size);
+	++m_stats.callsIssued;
+	bufferRange range = { buffer, offset, size };
+	m_cache.uniformRanges[index] = range;
+	m_cache.uniformBuffer = buffer;
+	m_cache.valid |= CACHED_UNIFORM_BUFFER;
+}
+
+///
+/// \brief To bind a texture to an image unit through the state cache.
+/// To bind level 0 of a texture to an image unit through the state cache.
+///
+void Compositor::bindImageTexture(GLuint unit, GLuint texture, GLenum access, GLenum format)
+{
+	saveImageUnit(unit);
+	std::map<GLuint, imageBinding>::iterator c = m_cache.imageUnits.find(unit);
+	if (c != m_cache.imageUnits.end() && c->second.texture == texture && c->second.level == 0 && c->second.layered == GL_FALSE && 
+		c->second.layer == 0 && c->second.access == access && c->second.format == format) { ++m_stats.callsAvoided; return; }
+	glBindImageTexture(unit, texture, 0, GL_FALSE, 0, access, format);
+	++m_stats.callsIssued;
+	imageBinding b = { texture, 0, GL_FALSE, 0, access, format };
+	m_cache.imageUnits[unit] = b;
+}
+
+///
+/// \brief Render the specified pass.
+/// Render the specified pass.
+///
+void Compositor::renderPassInternal(pass& p, passActions& actions)
+{
+	if (!p.initialized)		//pending shader
+	{
+		if (m_pendingPolicy == PENDING_PASSTHROUGH && p.batchSize == 0) renderPassthroughInternal(p, actions);
+		return;
+	}
+	if (p.compute)
+	{
+		renderComputeInternal(p);
+		return;
+	}
+	if (p.layered)
+	{
+		renderLayersInternal(p, actions);
+		return;
+	}
+
+	bindFramebuffer(p.fbo);
+
+	bindTextures(p.unitTextures, p.arrayUnits);
+
+	GLsizei w, h;
+	getPassSize(p, w, h);
+	glDrawBuffers(p.drawBufferCount, p.texOutputsChannels);
+	setViewport(0, 0, w, h);
+	setClearColor(0.0, 0.0, 0.0, 1.0);
+	setBlend(GL_FALSE);
+	useProgram(p.shaderProgram);
+	flushUniforms(p, 0);
+	bindVertexArray(m_vertexArray, m_vertexBuffer);
+	loadOutputs(actions);
+	setDepthMask(GL_FALSE);
+	if (p.batchSize > 0) glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, p.batchSize);
+	else glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	storeOutputs(actions);
+}
+///
+/// \brief Dispatch the specified compute pass.
+/// Dispatch the specified compute pass : outputs are bound to the image units of their channels, image inputs to the units 
+/// declared in the shader, and one invocation runs per pixel of the resolution.
+///
+void Compositor::renderComputeInternal(pass& p)
+{
+	bindTextures(p.unitTextures, p.arrayUnits);
+	useProgram(p.shaderProgram);
+	flushUniforms(p, 0);
+
+	std::map<int, GLuint>::iterator o;
+	for (o = p.texOutputs.begin(); o != p.texOutputs.end(); ++o)
+		bindImageTexture(o->first, o->second, GL_WRITE_ONLY, imageFormat(o->second));
+	for (size_t i = 0; i < p.imageInputs.size(); i++)
+	{
+		std::map<int, GLuint>::iterator t = p.texInputs.find(p.imageInputs[i].first);
+		if (t != p.texInputs.end() && t->second != 0)
+			bindImageTexture(p.imageInputs[i].second, t->second, GL_READ_ONLY, imageFormat(t->second));
+	}
+
+	GLsizei w, h;
+	getPassSize(p, w, h);
+	glDispatchCompute((w + p.workGroupSize[0] - 1) / p.workGroupSize[0], (h + p.workGroupSize[1] - 1) / p.workGroupSize[1], 1);
+}
+
+///
+/// \brief Render the layers of a layer pass.
+/// Render the layers of a layer pass, one instanced draw per batch of layers with the same blend mode.
+///
+void Compositor::renderLayersInternal(pass& p, passActions& actions)
+{
+	bindFramebuffer(p.fbo);
+	bindTextures(p.unitTextures, p.arrayUnits);
+
+	GLsizei w, h;
+	getPassSize(p, w, h);
+	glDrawBuffers(p.drawBufferCount, p.texOutputsChannels);
+	setViewport(0, 0, w, h);
+	setClearColor(0.0, 0.0, 0.0, 1.0);
+	useProgram(p.shaderProgram);
+	drawLayers(p, actions);
+}
+
+///
+/// \brief To draw the layers of a layer pass.
+/// To draw the layers of a layer pass into the bound framebuffer with its program in use, then set blending and the vertex array 
+/// back to what the other passes use. Without base instance, the per-layer attributes are pointed at the first layer of each batch. 
+/// The layer textures which are set are passed as a mask, the layers of the others are dropped by the vertex shader.
+///
+void Compositor::drawLayers(pass& p, passActions& actions)
+{
+	static const GLenum factors[4][2] = {
+		{ GL_ONE, GL_ONE_MINUS_SRC_ALPHA },		//BLEND_NORMAL
+		{ GL_ONE, GL_ONE },						//BLEND_ADD
+		{ GL_DST_COLOR, GL_ONE_MINUS_SRC_ALPHA },	//BLEND_MULTIPLY
+		{ GL_ONE, GL_ONE_MINUS_SRC_COLOR }		//BLEND_SCREEN
+	};
+
+	GLint mask = 0;
+	for (int i = 0; i < MAX_LAYER_TEXTURES; i++)
+	{
+		std::map<int, GLuint>::iterator t = p.texInputs.find(m_layerSamplers[i]);
+		if (t != p.texInputs.end() && t->second != 0) mask |= 1 << i;
+	}
+	glUniform1i(m_layerMaskLocation, mask);
+
+	bindVertexArray(p.layerArray, p.layerBuffer);
+	loadOutputs(actions);
+	setDepthMask(GL_FALSE);
+	setBlend(GL_TRUE);
+	for (size_t i = 0; i < p.layerBatches.size(); i++)
+	{
+		const layerBatch& b = p.layerBatches[i];
+		setBlendFunc(factors[b.blend][0], factors[b.blend][1]);
+		if (m_hasBaseInstance) glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, b.count, b.first);
+		else
+		{
+			for (GLuint a = 1; a <= 3; a++)
+				glVertexAttribPointer(a, a == 3 ? 2 : 4, GL_FLOAT, GL_FALSE, LAYER_FLOATS * sizeof(GLfloat), (void*)((b.first * LAYER_FLOATS + (a - 1) * 4) * sizeof(GLfloat)));
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, b.count);
+		}
+	}
+	storeOutputs(actions);
+	setBlend(GL_FALSE);
+	bindVertexArray(m_vertexArray, m_vertexBuffer);
+}
+
+///
+/// \brief To build the program of the layer passes.
+/// To build the program shared by all layer passes. Its vertex shader places the quad in the rectangle of each layer (instance) 
+/// and transforms the texture coordinates, and its fragment shader samples the layer texture selected by the layer, premultiplied 
+/// by alpha and opacity. Samplers are selected with a switch, as indexing an array of samplers with a varying is not allowed. 
+/// Layers whose bit is not set in layer_mask are moved outside the clip volume, so they are culled before rasterization.
+///
+bool Compositor::initializeLayerProgram()
+{
+	static const char* vertex_shader_text =
+		"#version 330\n"
+		"layout(location = 0) in vec3 vPos;\n"
+		"layout(location = 1) in vec4 layerRect;\n"
+		"layout(location = 2) in vec4 layerUV;\n"
+		"layout(location = 3) in vec2 layerOpacityTexture;\n"
+		"uniform int layer_mask;\n"
+		"out vec2 in_uv;\n"
+		"out vec2 layer_uv;\n"
+		"flat out float layer_opacity;\n"
+		"flat out int layer_texture;\n"
+		"void main()\n"
+		"{\n"
+		"    in_uv = layerRect.xy + vPos.xy * layerRect.zw;\n"
+		"    gl_Position = vec4(in_uv * 2.0 - 1.0, 0.0, 1.0);\n"
+		"    layer_uv = vPos.xy * layerUV.xy + layerUV.zw;\n"
+		"    layer_opacity = layerOpacityTexture.x;\n"
+		"    layer_texture = int(layerOpacityTexture.y + 0.5);\n"
+		"    if ((layer_mask & (1 << layer_texture)) == 0) gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+		"}\n";
+
+	std::string fragment =
+		"#version 330\n"
+		"in vec2 layer_uv;\n"
+		"flat in float layer_opacity;\n"
+		"flat in int layer_texture;\n"
+		"layout(location = 0) out vec4 out_color;\n";
+	for (int i = 0; i < MAX_LAYER_TEXTURES; i++) fragment += "uniform sampler2D layer" + std::to_string(i) + ";\n";
+	fragment +=
+		"void main()\n"
+		"{\n"
+		"    vec4 color = vec4(0.0);\n"
+		"    switch (layer_texture)\n"
+		"    {\n";
+	for (int i = 0; i < MAX_LAYER_TEXTURES; i++)
+		fragment += "    case " + std::to_string(i) + ": color = texture(layer" + std::to_string(i) + ", layer_uv); break;\n";
+	fragment +=
+		"    }\n"
+		"    out_color = vec4(color.rgb * color.a, color.a) * layer_opacity;\n"
+		"}\n";
+	const char* fragment_shader_text = fragment.c_str();
+
+	GLuint shaders[2] = { glCreateShader(GL_VERTEX_SHADER), glCreateShader(GL_FRAGMENT_SHADER) };
+	glShaderSource(shaders[0], 1, &vertex_shader_text, NULL);
+	glShaderSource(shaders[1], 1, &fragment_shader_text, NULL);
+	GLint Result = GL_TRUE;
+	for (int i = 0; i < 2 && Result == GL_TRUE; i++)
+	{
+		glCompileShader(shaders[i]);
+		glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &Result);
+	}
+	GLuint program = glCreateProgram();
+	if (Result == GL_TRUE)
+	{
+		glAttachShader(program, shaders[0]);
+		glAttachShader(program, shaders[1]);
+		glLinkProgram(program);
+		glGetProgramiv(program, GL_LINK_STATUS, &Result);
+	}
+	if (Result == GL_FALSE)
+	{
+		m_shaderErrorString = "layer program failed to build";
+		glDeleteProgram(program);
+		glDeleteShader(shaders[0]);
+		glDeleteShader(shaders[1]);
+		m_lastError = Compositor::SHADER_LINKING_FAIL;
+		return false;
+	}
+
+	m_layerProgram = program;
+	m_layerVertexShader = shaders[0];
+	m_layerFragmentShader = shaders[1];
+	m_layerMaskLocation = glGetUniformLocation(program, "layer_mask");
+	m_layerSamplers.resize(MAX_LAYER_TEXTURES);
+	for (int i = 0; i < MAX_LAYER_TEXTURES; i++) m_layerSamplers[i] = internSampler("layer" + std::to_string(i));
+	return true;
+}
+
+///
+/// \brief To build the shaders of the batch passes.
+/// To compile the vertex shader shared by all batch passes, which draws one instance of the quad per image and sends it to layer 
+/// gl_InstanceID of the outputs. Without ARB_shader_viewport_layer_array or AMD_vertex_shader_layer, the vertex shader cannot write 
+/// gl_Layer, so a geometry shader passing the triangles through writes it instead.
+///
+bool Compositor::initializeBatchShaders()
+{
+	std::string vertex =
+		"#version 330 compatibility\n";
+	if (m_hasVertexLayer) vertex += hasExtension("GL_ARB_shader_viewport_layer_array") ? "#extension GL_ARB_shader_viewport_layer_array : require\n" : "#extension GL_AMD_vertex_shader_layer : require\n";
+	vertex += 
+		"in vec3 vPos;\n";
+	vertex += m_hasVertexLayer ?
+		"out vec2 in_uv;\n"
+		"flat out int in_layer;\n" :
+		"out vec2 batch_uv;\n"
+		"flat out int batch_layer;\n";
+	vertex +=
+		"void main()\n"
+		"{\n"
+		"    gl_Position = vec4(vPos.xy * 2.0 - 1.0, 0.0, 1.0);\n";
+	vertex += m_hasVertexLayer ?
+		"    in_uv = vPos.xy;\n"
+		"    in_layer = gl_InstanceID;\n"
+		"    gl_Layer = gl_InstanceID;\n" :
+		"    batch_uv = vPos.xy;\n"
+		"    batch_layer = gl_InstanceID;\n";
+	vertex += "}\n";
+
+	static const char* geometry_shader_text =
+		"#version 330 compatibility\n"
+		"layout(triangles) in;\n"
+		"layout(triangle_strip, max_vertices = 3) out;\n"
+		"in vec2 batch_uv[];\n"
+		"flat in int batch_layer[];\n"
+		"out vec2 in_uv;\n"
+		"flat out int in_layer;\n"
+		"void main()\n"
+		"{\n"
+		"    for (int i = 0; i < 3; i++)\n"
+		"    {\n"
+		"        gl_Position = gl_in[i].gl_Position;\n"
+		"        in_uv = batch_uv[i];\n"
+		"        in_layer = batch_layer[i];\n"
+		"        gl_Layer = batch_layer[i];\n"
+		"        EmitVertex();\n"
+		"    }\n"
+		"    EndPrimitive();\n"
+		"}\n";
+
+	GLuint shaders[2] = { glCreateShader(GL_VERTEX_SHADER), m_hasVertexLayer ? 0 : glCreateShader(GL_GEOMETRY_SHADER) };
+	const char* sources[2] = { vertex.c_str(), geometry_shader_text };
+	GLint Result = GL_TRUE;
+	for (int i = 0; i < 2 && shaders[i] != 0 && Result == GL_TRUE; i++)
+	{
+		glShaderSource(shaders[i], 1, &sources[i], NULL);
+		glCompileShader(shaders[i]);
+		glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &Result);
+	}
+	if (Result == GL_FALSE)
+	{
+		m_shaderErrorString = "batch shaders failed to build";
+		glDeleteShader(shaders[0]);
+		glDeleteShader(shaders[1]);
+		m_lastError = Compositor::SHADER_COMPILE_FAIL;
+		return false;
+	}
+
+	m_batchVertexShader = shaders[0];
+	m_batchGeometryShader = shaders[1];
+	m_batchSource = vertex + (m_hasVertexLayer ? "" : geometry_shader_text);
+	return true;
+}
+
+///
+/// \brief To get the internal format of a texture bound as an image.
+/// To get the internal format of a texture for glBindImageTexture, querying it only the first time the texture is used.
+///
+GLenum Compositor::imageFormat(GLuint texID)
+{
+	std::map<GLuint, GLenum>::iterator f = m_imageFormats.find(texID);
+	if (f != m_imageFormats.end()) return f->second;
+
+	GLint format = GL_RGBA8;
+	if (m_glVersion >= 45) glGetTextureLevelParameteriv(texID, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+	else
+	{
+		GLint previousTexture = 0;
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+		glBindTexture(GL_TEXTURE_2D, texID);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+		glBindTexture(GL_TEXTURE_2D, previousTexture);
+	}
+	m_imageFormats[texID] = format;
+	return format;
+}
+
+///
+/// \brief To get the size a pass renders at.
+/// To get the size a pass renders at : its fixed size, or the resolution times its scale, at least 1 pixel.
+///
+void Compositor::getPassSize(pass& p, GLsizei& w, GLsizei& h)
+{
+	if (p.fixedWidth > 0)
+	{
+		w = p.fixedWidth;
+		h = p.fixedHeight;
+		return;
+	}
+	w = std::max((GLsizei)1, (GLsizei)(m_width * p.sizeScale + 0.5f));
+	h = std::max((GLsizei)1, (GLsizei)(m_height * p.sizeScale + 0.5f));
+}
+
+///
+/// \brief To unmap the file of a stream.
+/// To unmap the file mapped to a stream with Compositor::mapStreamFile(), if any.
+///
+void Compositor::unmapStreamFile(stream& s)
+{
+	if (s.fileData == nullptr) return;
+#ifdef _WIN32
+	UnmapViewOfFile(s.fileData);
+	CloseHandle((HANDLE)s.fileMapping);
+#else
+	munmap((void*)s.fileData, s.fileSize);
+#endif
+	s.fileData = nullptr;
+	s.fileSize = 0;
+	s.fileMapping = nullptr;
+}
+
+///
+/// \brief Main function of the resource thread.
+/// To make the shared context current, then build the submitted jobs one by one and hand them to the main thread with a fence, 
+/// until the thread is stopped.
+///
+void Compositor::resourceThreadMain(resourceContextCallback callback, void* userData)
+{
+	bool current = callback(true, userData);
+	{
+		std::lock_guard<std::mutex> lock(m_resourceMutex);
+		m_resourceState = current ? 1 : -1;
+	}
+	m_resourceCondition.notify_all();
+	if (!current) return;
+
+	while (true)
+	{
+		resourceJob job;
+		{
+			std::unique_lock<std::mutex> lock(m_resourceMutex);
+			m_resourceCondition.wait(lock, [this]() { return m_resourceState != 1 || !m_resourceQueue.empty(); });
+			if (m_resourceState != 1) break;
+			job = std::move(m_resourceQueue.front());
+			m_resourceQueue.pop_front();
+		}
+
+		buildResource(job);
+		job.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();		//the fence must reach the GPU before another context waits for it
+
+		std::lock_guard<std::mutex> lock(m_resourceMutex);
+		m_resourceBuilt.push_back(std::move(job));
+		m_resourceHasBuilt = true;
+	}
+
+	callback(false, userData);
+}
+
+///
+/// \brief To build the object of a resource job.
+/// To compile and link the program, or create and fill the texture, of a job in the context of the resource thread. 
+/// Only shared objects are created here : vertex input, which lives in a vertex array, is set up when the program is published.
+///
+void Compositor::buildResource(resourceJob& job)
+{
+	if (job.passID == 0)
+	{
+		glGenTextures(1, &job.object);
+		glBindTexture(GL_TEXTURE_2D, job.object);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		const void* data = job.pixels.empty() ? NULL : &job.pixels[0];
+		if (m_glVersion >= 42)
+		{
+			glTexStorage2D(GL_TEXTURE_2D, 1, job.internalFormat, job.width, job.height);
+			if (data != NULL) glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, job.width, job.height, job.format, job.type, data);
+		}
+		else glTexImage2D(GL_TEXTURE_2D, 0, job.internalFormat, job.width, job.height, 0, job.format, job.type, data);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		job.pixels.clear();
+		job.pixels.shrink_to_fit();
+		return;
+	}
+
+	if (job.batch && m_batchVertexShader == 0)
+	{
+		job.log = "batch shaders are not available";
+		return;
+	}
+	const char* source = job.source.c_str();
+	job.shader = glCreateShader(job.compute ? GL_COMPUTE_SHADER : GL_FRAGMENT_SHADER);
+	glShaderSource(job.shader, 1, &source, NULL);
+	glCompileShader(job.shader);
+	GLint Result;
+	glGetShaderiv(job.shader, GL_COMPILE_STATUS, &Result);
+	if (Result == GL_FALSE)
+	{
+		GLchar msg[1024]; GLsizei length;
+		glGetShaderInfoLog(job.shader, 1024, &length, msg);
+		job.log = std::string(msg);
+		glDeleteShader(job.shader);
+		job.shader = 0;
+		return;
+	}
+
+	job.object = glCreateProgram();
+	if (job.batch)
+	{
+		glAttachShader(job.object, m_batchVertexShader);
+		if (m_batchGeometryShader != 0) glAttachShader(job.object, m_batchGeometryShader);
+	}
+	else if (!job.compute) glAttachShader(job.object, m_shaderVertex);
+	glAttachShader(job.object, job.shader);
+	glLinkProgram(job.object);
+	glGetProgramiv(job.object, GL_LINK_STATUS, &Result);
+	if (Result == GL_FALSE)
+	{
+		GLchar msg[1024]; GLsizei length;
+		glGetProgramInfoLog(job.object, 1024, &length, msg);
+		job.log = std::string(msg);
+		glDetachShader(job.object, job.shader);
+		glDeleteShader(job.shader);
+		glDeleteProgram(job.object);
+		job.object = job.shader = 0;
+	}
+}
+
+///
+/// \brief To publish a resource job whose fence is signaled.
+/// To install the program of a shader job into its pass, or hand over the texture of an upload job, and call the callback of the job. 
+/// Returns false if the kind of shader does not match the pass, which is then PASS_FAILED.
+///
+bool Compositor::publishResource(resourceJob& job)
+{
+	bool matches = true;
+	if (job.passID != 0)
+	{
+		pass* p = m_passes.find(job.passID);
+		if (p != nullptr) matches = p->compute == job.compute && !p->layered && (p->batchSize > 0) == job.batch;
+		if (p == nullptr || !matches)
+		{
+			deleteProgram(job.object, job.shader);
+			job.object = 0;
+			if (p != nullptr)
+			{
+				p->failed = true;
+				p->failedLog = "the kind of shader submitted does not match the kind of pass";
+			}
+		}
+		else if (job.object == 0)
+		{
+			p->failed = true;
+			p->failedLog = job.log;
+		}
+		else
+		{
+			if (!job.compute) setupVertexInput(job.object);
+			if (p->pending)
+			{
+				deleteProgram(p->build.program, p->build.fragmentShader);
+				p->pending = false;
+			}
+			installProgram(*p, job.object, job.shader, job.source);
+		}
+	}
+	else m_imageFormats.erase(job.object);		//the name might have been used by a deleted texture
+
+	--m_resourceJobsInFlight;
+	if (job.callback != nullptr) job.callback(job.id, job.object, job.object != 0, job.userData);
+	return matches;
+}
+
+///
+/// \brief To delete the objects of a resource job.
+/// To delete the fence and the program or texture of a resource job which is dropped.
+///
+void Compositor::deleteResource(resourceJob& job)
+{
+	if (job.fence != 0) glDeleteSync(job.fence);
+	job.fence = 0;
+	if (job.passID != 0) deleteProgram(job.object, job.shader);
+	else if (job.object != 0) glDeleteTextures(1, &job.object);
+	job.object = job.shader = 0;
+}
+
+///
+/// \brief To find the slot of a readback.
+/// To find the slot of the readback ring used by a readback, nullptr if the readback is unknown or released.
+///
+Compositor::readbackSlot* Compositor::findReadback(int readbackID)
+{
+	if (readbackID <= 0) return nullptr;
+	for (size_t i = 0; i < m_readbacks.size(); i++)
+		if (m_readbacks[i].id == readbackID) return &m_readbacks[i];
+	return nullptr;
+}
+
+///
+/// \brief To check whether a readback is ready.
+/// To check whether the fence of a readback is signaled, without waiting. The fence is deleted once signaled.
+///
+bool Compositor::isReadbackReady(readbackSlot& slot)
+{
+	if (slot.fence == 0) return true;
+	GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+	glDeleteSync(slot.fence);
+	slot.fence = 0;
+	return true;
+}
+
+///
+/// \brief To delete the readback ring.
+/// To delete the pixel buffers and fences of the readback ring, unmapping them if needed.
+///
+void Compositor::deleteReadbacks()
+{
+	for (size_t i = 0; i < m_readbacks.size(); i++)
+	{
+		if (m_readbacks[i].id != 0) releaseReadback(m_readbacks[i].id);
+		if (m_readbacks[i].pbo != 0) glDeleteBuffers(1, &m_readbacks[i].pbo);
+	}
+	m_readbacks.clear();
+}
+
+///
+/// \brief To get the size of a pixel read back.
+/// To get the size in bytes of a pixel read with glReadPixels with the given format and type.
+///
+int Compositor::pixelSize(GLenum format, GLenum type)
+{
+	int components;
+	switch (format)
+	{
+	case GL_RED: case GL_GREEN: case GL_BLUE: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: components = 1; break;
+	case GL_RG: case GL_RG_INTEGER: components = 2; break;
+	case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: components = 3; break;
+	default: components = 4; break;
+	}
+	switch (type)
+	{
+	case GL_UNSIGNED_BYTE: case GL_BYTE: return components;
+	case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: return components * 2;
+	case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT: return components * 4;
+	case GL_UNSIGNED_SHORT_5_6_5: case GL_UNSIGNED_SHORT_4_4_4_4: case GL_UNSIGNED_SHORT_5_5_5_1: return 2;
+	default: return 4;		//packed 32 bit types
+	}
+}
+
+///
+/// \brief To verify whether a set of passes are usable.
+/// To verify whether a set of passes are usable.
+///
+bool Compositor::verifyPipeline(std::vector<int> pipeline)
+{
+	for (int i = 0; i < pipeline.size(); i++)
+	{
+		pass* p = m_passes.find(pipeline[i]);
+		if (p == nullptr) return false;
+		else if (!isRenderable(*p)) return false;
+		else if (p->texOutputs.size() == 0) return false;
+	}
+
+	return true;
+}
+
+///
+/// \brief To store the active uniforms of a pass program.
+/// To query the active uniforms once after linking, so that setting a uniform does not need glGetUniformLocation.
+/// Arrays are reported as "name[0]", so they are stored under both "name[0]" and "name".
+///
+void Compositor::reflectUniforms(pass& p)
+{
+	p.uniforms.clear();
+	p.uniformHandles.clear();
+	p.unitSamplers.clear();
+	p.imageInputs.clear();
+	p.arrayUnits = 0;
+
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(p.shaderProgram, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(p.shaderProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<GLchar> name(maxLength + 1);
+
+	for (GLint i = 0; i < count; i++)
+	{
+		uniform u; GLsizei length = 0;
+		glGetActiveUniform(p.shaderProgram, i, maxLength + 1, &length, &u.size, &u.type, &name[0]);
+		u.name = std::string(&name[0], length);
+		u.location = glGetUniformLocation(p.shaderProgram, &name[0]);
+		if (u.location < 0) continue; //member of a uniform block
+
+		int handle = (int)p.uniforms.size();
+		p.uniformHandles[u.name] = handle;
+		size_t bracket = u.name.find('[');
+		if (bracket != std::string::npos) p.uniformHandles[u.name.substr(0, bracket)] = handle;
+		u.kind = UNIFORM_FLOAT;
+		u.components = 0;
+		u.valid = false;
+		p.uniforms.push_back(u);
+
+		//each sampler gets a fixed texture unit, in reflection order
+		if (isSamplerType(u.type) && p.unitSamplers.size() < MAX_TEXTURE_UNITS)
+		{
+			GLint unit = (GLint)p.unitSamplers.size();
+			uploadUniformValue(p.shaderProgram, u.location, UNIFORM_INT, 1, &unit);
+			if (u.type == GL_SAMPLER_2D_ARRAY) p.arrayUnits |= 1u << unit;
+			p.unitSamplers.push_back(internSampler(bracket != std::string::npos ? u.name.substr(0, bracket) : u.name));
+		}
+		//images keep the unit declared in the shader, output channel N is bound to unit N
+		else if (isImageType(u.type))
+		{
+			GLint unit = 0;
+			glGetUniformiv(p.shaderProgram, u.location, &unit);
+			p.imageInputs.push_back(std::make_pair(internSampler(bracket != std::string::npos ? u.name.substr(0, bracket) : u.name), unit));
+		}
+	}
+	if (p.compute)
+	{
+		GLint size[3] = { 1, 1, 1 };
+		glGetProgramiv(p.shaderProgram, GL_COMPUTE_WORK_GROUP_SIZE, size);
+		p.workGroupSize[0] = size[0];
+		p.workGroupSize[1] = size[1];
+	}
+
+	bindUniformBlocks(p.shaderProgram);
+
+	p.unitTextures.assign(p.unitSamplers.size(), 0);
+	std::map<int, GLuint>::iterator t;
+	for (t = p.texInputs.begin(); t != p.texInputs.end(); ++t)
+		setInputTexture(p, t->first, t->second);
+
+	p.uniformDirty.assign((p.uniforms.size() + 31) / 32, 0);
+	p.hasDirtyUniforms = false;
+}
+
+///
+/// \brief To set uniform value by name.
+/// To set uniform value by name. Uniforms which are not active in the pass program are ignored, the same way glUniform* ignores location -1.
+///
+bool Compositor::setUniformByName(int passID, char* uniName, uniformKind kind, int components, const void* v)
+{
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+
+	std::map<std::string, int>::iterator u = p->uniformHandles.find(uniName);
+	if (u != p->uniformHandles.end())
+		setUniformInternal(*p, u->second, kind, components, v);
+
+	RETURN_OK()
+}
+
+///
+/// \brief To set uniform value by handle.
+/// To set uniform value by handle returned by Compositor::getUniformHandle().
+///
+bool Compositor::setUniformByHandle(int passID, int uniHandle, uniformKind kind, int components, const void* v)
+{
+	pass* p = m_passes.find(passID);
+	if (p == nullptr) RETURN_ERR(Compositor::PASS_NOT_FOUND)
+	if (uniHandle < 0 || uniHandle >= (int)p->uniforms.size()) RETURN_ERR(Compositor::UNIFORM_NOT_FOUND)
+
+	setUniformInternal(*p, uniHandle, kind, components, v);
+
+	RETURN_OK()
+}
+
+///
+/// \brief To set uniform value of a pass.
+/// To set uniform value of a pass. The value is kept as shadow copy, so setting the same value again does not reach the driver. 
+/// With staging enabled, the uniform is only marked dirty and uploaded by Compositor::flushUniforms() when the pass is rendered.
+///
+void Compositor::setUniformInternal(pass& p, int handle, uniformKind kind, int components, const void* v)
+{
+	uniform& u = p.uniforms[handle];
+	if (u.valid && u.kind == kind && u.components == components && memcmp(u.value, v, components * sizeof(GLuint)) == 0) return;
+	++p.uniformChanges;
+
+	memcpy(u.value, v, components * sizeof(GLuint));
+	u.kind = kind;
+	u.components = components;
+	u.valid = true;
+
+	if (m_uniformStaging)
+	{
+		p.uniformDirty[handle >> 5] |= 1u << (handle & 31);
+		p.hasDirtyUniforms = true;
+	}
+	else uploadUniformValue(p.shaderProgram, u.location, kind, components, u.value);
+}
+
+///
+/// \brief To upload a uniform value to a program.
+/// To upload a uniform value to a program. With glProgramUniform* the currently bound program is left untouched, 
+/// otherwise the program is bound temporarily. If program is 0, the value is uploaded to the currently bound program.
+///
+void Compositor::uploadUniformValue(GLuint program, GLint location, uniformKind kind, int components, const void* v)
+{
+	if (program != 0 && m_hasProgramUniform)
+	{
+		switch (kind)
+		{
+		case UNIFORM_FLOAT:
+			if (components == 1) glProgramUniform1fv(program, location, 1, (const GLfloat*)v);
+			else if (components == 2) glProgramUniform2fv(program, location, 1, (const GLfloat*)v);
+			else if (components == 3) glProgramUniform3fv(program, location, 1, (const GLfloat*)v);
+			else glProgramUniform4fv(program, location, 1, (const GLfloat*)v);
+			break;
+		case UNIFORM_INT:
+			if (components == 1) glProgramUniform1iv(program, location, 1, (const GLint*)v);
+			else if (components == 2) glProgramUniform2iv(program, location, 1, (const GLint*)v);
+			else if (components == 3) glProgramUniform3iv(program, location, 1, (const GLint*)v);
+			else glProgramUniform4iv(program, location, 1, (const GLint*)v);
+			break;
+		case UNIFORM_UINT:
+			if (components == 1) glProgramUniform1uiv(program, location, 1, (const GLuint*)v);
+			else if (components == 2) glProgramUniform2uiv(program, location, 1, (const GLuint*)v);
+			else if (components == 3) glProgramUniform3uiv(program, location, 1, (const GLuint*)v);
+			else glProgramUniform4uiv(program, location, 1, (const GLuint*)v);
+			break;
+		}
+		return;
+	}
+
+	GLint currentProg = 0;
+	if (program != 0)
+	{
+		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProg);
+		glUseProgram(program);
+	}
+
+	switch (kind)
+	{
+	case UNIFORM_FLOAT:
+		if (components == 1) glUniform1fv(location, 1, (const GLfloat*)v);
+		else if (components == 2) glUniform2fv(location, 1, (const GLfloat*)v);
+		else if (components == 3) glUniform3fv(location, 1, (const GLfloat*)v);
+		else glUniform4fv(location, 1, (const GLfloat*)v);
+		break;
+	case UNIFORM_INT:
+		if (components == 1) glUniform1iv(location, 1, (const GLint*)v);
+		else if (components == 2) glUniform2iv(location, 1, (const GLint*)v);
+		else if (components == 3) glUniform3iv(location, 1, (const GLint*)v);
+		else glUniform4iv(location, 1, (const GLint*)v);
+		break;
+	case UNIFORM_UINT:
+		if (components == 1) glUniform1uiv(location, 1, (const GLuint*)v);
+		else if (components == 2) glUniform2uiv(location, 1, (const GLuint*)v);
+		else if (components == 3) glUniform3uiv(location, 1, (const GLuint*)v);
+		else glUniform4uiv(location, 1, (const GLuint*)v);
+		break;
+	}
+
+	if (program != 0) glUseProgram(currentProg);
+}
+
+///
+/// \brief To upload the staged uniform values of a pass.
+/// To upload only the uniform values which changed since the last upload. If program is 0, the pass program must be 
+/// currently bound (as in Compositor::renderPassInternal()), otherwise the values are uploaded to the given program.
+///
+void Compositor::flushUniforms(pass& p, GLuint program)
+{
+	if (!p.hasDirtyUniforms) return;
+
+	for (size_t w = 0; w < p.uniformDirty.size(); w++)
+	{
+		unsigned int bits = p.uniformDirty[w];
+		for (int handle = (int)w * 32; bits != 0; bits >>= 1, handle++)
+		{
+			if ((bits & 1) == 0) continue;
+			uniform& u = p.uniforms[handle];
+			uploadUniformValue(program, u.location, u.kind, u.components, u.value);
+		}
+		p.uniformDirty[w] = 0;
+	}
+	p.hasDirtyUniforms = false;
+}
+
+///
+/// \brief To create a new pipeline.
+/// To create a new empty pipeline of the given type.
+///
+int Compositor::createPipelineInternal(pipelineType type)
+{
+	pipeline newPipeline;
+	newPipeline.type = type;
+	newPipeline.passes.clear();
+	newPipeline.finalOutputs.clear();
+	newPipeline.order.clear();
+	newPipeline.fusion = false;
+	newPipeline.timing = false;
+	newPipeline.timingNext = 0;
+	newPipeline.finalBarrier = 0;
+	newPipeline.damageTracking = false;
+	newPipeline.damageValid = false;
+	newPipeline.memoization = false;
+	memset(&newPipeline.memo, 0, sizeof(newPipeline.memo));
+	newPipeline.framesInFlight = 1;
+	newPipeline.frameNext = 0;
+	newPipeline.frameCount = 0;
+	newPipeline.version = ++m_passesVersion;
+	newPipeline.framesVersion = newPipeline.version;
+	newPipeline.baking = false;
+	newPipeline.baked.rendered = 0;
+	newPipeline.baked.version = newPipeline.version - 1;
+	newPipeline.baked.width = 0;
+	newPipeline.baked.height = 0;
+	newPipeline.resolvedVersion = newPipeline.version;
+	newPipeline.transientVersion = newPipeline.version - 1;
+	int seqID = m_pipelines.insert(newPipeline);
+
+	m_lastError = Compositor::NONE;
+	return seqID;
+}
+
+///
+/// \brief To sort the passes of a graph pipeline.
+/// To infer the dependencies between the passes of a graph pipeline from their output and input textures, sort them topologically 
+/// (passes without dependency between them keep the order they were given) and cull the passes which do not contribute to the final outputs.
+///
+bool Compositor::resolveGraph(pipeline& pl)
+{
+	const std::vector<int>& passes = pl.passes;
+	int n = (int)passes.size();
+
+	//which pass writes each texture
+	std::map<long long, int> producer;
+	for (int i = 0; i < n; i++)
+	{
+		pass* p = m_passes.find(passes[i]);
+		if (p == nullptr) RETURN_ERR(Compositor::PIPELINE_NOT_COMPLETE)
+		std::map<int, GLuint>::iterator o;
+		for (o = p->texOutputs.begin(); o != p->texOutputs.end(); ++o)
+		{
+			long long key = outputKey(*p, o->first);
+			std::map<long long, int>::iterator w = producer.find(key);
+			if (w != producer.end() && w->second != i) RETURN_ERR(Compositor::PIPELINE_OUTPUT_CONFLICT)
+			producer[key] = i;
+		}
+	}
+
+	//edges from the pass writing a texture to the passes reading it
+	std::vector<std::vector<int>> consumers(n), dependencies(n);
+	std::vector<int> inDegree(n, 0);
+	for (int i = 0; i < n; i++)
+	{
+		pass* p = m_passes.find(passes[i]);
+		std::map<int, GLuint>::iterator t;
+		for (t = p->texInputs.begin(); t != p->texInputs.end(); ++t)
+		{
+			std::map<long long, int>::iterator w = producer.find(inputKey(*p, t->first));
+			if (w == producer.end()) continue;				//texture from the main program
+			if (w->second == i) RETURN_ERR(Compositor::PIPELINE_CYCLE)	//pass reads its own output
+			consumers[w->second].push_back(i);
+			dependencies[i].push_back(w->second);
+			inDegree[i]++;
+		}
+	}
+
+	//Kahn's algorithm, always taking the earliest given pass which is ready
+	std::vector<int> sorted;
+	std::vector<bool> done(n, false);
+	while ((int)sorted.size() < n)
+	{
+		int next = -1;
+		for (int i = 0; i < n && next < 0; i++)
+			if (!done[i] && inDegree[i] == 0) next = i;
+		if (next < 0) RETURN_ERR(Compositor::PIPELINE_CYCLE)
+		done[next] = true;
+		sorted.push_back(next);
+		for (size_t c = 0; c < consumers[next].size(); c++)
+			inDegree[consumers[next][c]]--;
+	}
+
+	//passes which the final outputs depend on
+	std::vector<bool> live(n, pl.finalOutputs.empty());
+	std::vector<int> stack;
+	for (size_t i = 0; i < pl.finalOutputs.size(); i++)
+	{
+		std::map<long long, int>::iterator w = producer.find((long long)pl.finalOutputs[i]);
+		if (w == producer.end()) RETURN_ERR(Compositor::PIPELINE_NOT_COMPLETE)
+		stack.push_back(w->second);
+	}
+	while (!stack.empty())
+	{
+		int i = stack.back();
+		stack.pop_back();
+		if (live[i]) continue;
+		live[i] = true;
+		for (size_t d = 0; d < dependencies[i].size(); d++)
+			stack.push_back(dependencies[i][d]);
+	}
+
+	pl.order.clear();
+	for (int i = 0; i < n; i++)
+		if (live[sorted[i]]) pl.order.push_back(passes[sorted[i]]);
+	return true;
+}
+
+///
+/// \brief To assign textures from the pool to the transient textures of a pipeline.
+/// To assign textures from the pool to the transient textures used by a pipeline. The lifetime of a transient texture spans from 
+/// the first to the last pass using it in rendering order, and transient textures with the same size and format whose lifetimes 
+/// do not overlap get the same texture. New textures are only created when the pool has no free texture of the needed size and format.
+///
+bool Compositor::allocateTransients(pipeline& pl)
+{
+	pl.transientTextures.clear();
+
+	std::map<int, std::pair<int, int>> lifetime;	//key is transient ID, value is first and last position in pl.order
+	for (int i = 0; i < (int)pl.order.size(); i++)
+	{
+		pass& p = m_passes[pl.order[i]];
+		std::vector<int> used;
+		std::map<int, int>::iterator o;
+		for (o = p.transientOutputs.begin(); o != p.transientOutputs.end(); ++o) used.push_back(o->second);
+		std::map<int, int>::iterator t;
+		for (t = p.transientInputs.begin(); t != p.transientInputs.end(); ++t) used.push_back(t->second);
+
+		for (size_t u = 0; u < used.size(); u++)
+		{
+			std::map<int, std::pair<int, int>>::iterator l = lifetime.find(used[u]);
+			if (l == lifetime.end()) lifetime[used[u]] = std::make_pair(i, i);
+			else l->second.second = i;
+		}
+	}
+
+	std::vector<std::pair<int, int>> byStart;		//first position and transient ID, sorted by first position
+	std::map<int, std::pair<int, int>>::iterator l;
+	for (l = lifetime.begin(); l != lifetime.end(); ++l)
+		byStart.push_back(std::make_pair(l->second.first, l->first));
+	std::sort(byStart.begin(), byStart.end());
+
+	std::vector<int> busyUntil(m_pool.size(), -1);	//last position in pl.order using each pool texture
+	for (size_t i = 0; i < byStart.size(); i++)
+	{
+		int id = byStart[i].second;
+		std::map<int, transient>::iterator t = m_transients.find(id);
+		if (t == m_transients.end()) RETURN_ERR(Compositor::TRANSIENT_NOT_FOUND)
+
+		int chosen = -1;
+		for (size_t k = 0; k < m_pool.size() && chosen < 0; k++)
+		{
+			if (busyUntil[k] >= byStart[i].first) continue;
+			if (m_pool[k].width == t->second.width && m_pool[k].height == t->second.height && m_pool[k].internalFormat == t->second.internalFormat)
+				chosen = (int)k;
+		}
+		if (chosen < 0)
+		{
+			poolTexture newTexture;
+			newTexture.width = t->second.width;
+			newTexture.height = t->second.height;
+			newTexture.internalFormat = t->second.internalFormat;
+			glGenTextures(1, &newTexture.texture);
+			bindTexture(0, newTexture.texture, GL_TEXTURE_2D);
+			if (m_glVersion >= 42) glTexStorage2D(GL_TEXTURE_2D, 1, newTexture.internalFormat, newTexture.width, newTexture.height);
+			else glTexImage2D(GL_TEXTURE_2D, 0, newTexture.internalFormat, newTexture.width, newTexture.height, 0, GL_RGBA, GL_FLOAT, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			m_pool.push_back(newTexture);
+			m_imageFormats[newTexture.texture] = newTexture.internalFormat;
+			busyUntil.push_back(-1);
+			chosen = (int)m_pool.size() - 1;
+		}
+
+		busyUntil[chosen] = lifetime[id].second;
+		pl.transientTextures[id] = m_pool[chosen].texture;
+	}
+
+	pl.transientVersion = pipelineVersion(pl);
+	return true;
+}
+
+///
+/// \brief To put the textures assigned to transient textures into the passes of a pipeline.
+/// To put the textures assigned to transient textures into the inputs and outputs of the passes of a pipeline, 
+/// attaching them to the framebuffers where they changed since the last rendering.
+///
+void Compositor::applyTransients(pipeline& pl)
+{
+	for (size_t i = 0; i < pl.order.size(); i++)
+	{
+		pass& p = m_passes[pl.order[i]];
+		std::map<int, int>::iterator o;
+		for (o = p.transientOutputs.begin(); o != p.transientOutputs.end(); ++o)
+		{
+			GLuint texID = pl.transientTextures[o->second];
+			if (p.texOutputs[o->first] == texID) continue;
+			p.texOutputs[o->first] = texID;
+			bindFramebuffer(p.fbo);
+			glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + o->first, GL_TEXTURE_2D, texID, 0);
+		}
+		std::map<int, int>::iterator t;
+		for (t = p.transientInputs.begin(); t != p.transientInputs.end(); ++t)
+			setInputTexture(p, t->first, pl.transientTextures[t->second]);
+	}
+}
+
+///
+/// \brief To get the size of a pixel of a texture format.
+/// To get the size of a pixel in bytes of a texture internal format, used for memory statistics. Unknown formats count as 4 bytes.
+///
+int Compositor::bytesPerPixel(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_R8: case GL_R8I: case GL_R8UI:
+		return 1;
+	case GL_RG8: case GL_R16: case GL_R16F: case GL_R16I: case GL_R16UI:
+		return 2;
+	case GL_RGB8:
+		return 3;
+	case GL_RGB16F:
+		return 6;
+	case GL_RG16: case GL_RG16F: case GL_R32F: case GL_R32I: case GL_R32UI:
+	case GL_RGBA8: case GL_SRGB8_ALPHA8: case GL_RGB10_A2: case GL_R11F_G11F_B10F:
+		return 4;
+	case GL_RGBA16: case GL_RGBA16F: case GL_RG32F: case GL_RGBA16I: case GL_RGBA16UI:
+		return 8;
+	case GL_RGB32F:
+		return 12;
+	case GL_RGBA32F: case GL_RGBA32I: case GL_RGBA32UI:
+		return 16;
+	default:
+		return 4;
+	}
+}
+
+///
+/// \brief To compile and link a fragment shader with the vertex shader.
+/// To compile a fragment shader and link it with the vertex shader (of batch passes if batch is true), or link a compute shader alone. 
+/// Returns the program, or 0 with the error set if it fails.
+///
+GLuint Compositor::buildProgram(const char* source, GLuint* fragmentShader, bool compute, bool batch)
+{
+	programBuild build;
+	startProgram(source, build, compute, batch);
+	return finishProgram(build, fragmentShader);
+}
+
+///
+/// \brief To start building a program.
+/// To load a program from the program binary cache, or submit its fragment shader for compiling and the program for linking 
+/// without querying the result.
+///
+void Compositor::startProgram(const char* source, programBuild& build, bool compute, bool batch)
+{
+	build.source = source;
+	build.compute = compute;
+	build.batch = batch;
+	build.fragmentShader = 0;
+	build.cacheKey.clear();
+	build.cachePath.clear();
+	if (!m_programCacheDirectory.empty())
+	{
+		build.cacheKey = m_driverString + '\0' + (compute ? std::string("compute") : batch ? m_batchSource : m_vertexSource) + '\0' + source;
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", hashString(build.cacheKey));
+		build.cachePath = m_programCacheDirectory + "/" + name;
+
+		double buildSeconds = 0.0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		build.program = loadProgramBinary(build.cacheKey, build.cachePath, &buildSeconds);
+		if (build.program != 0)
+		{
+			m_programCacheStats.hits++;
+			m_programCacheStats.secondsSaved += buildSeconds - std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			return;
+		}
+		m_programCacheStats.misses++;
+	}
+	build.start = std::chrono::steady_clock::now();
+
+	build.fragmentShader = glCreateShader(compute ? GL_COMPUTE_SHADER : GL_FRAGMENT_SHADER);
+	glShaderSource(build.fragmentShader, 1, &source, NULL);
+	glCompileShader(build.fragmentShader);
+
+	build.program = glCreateProgram();
+	if (batch)
+	{
+		glAttachShader(build.program, m_batchVertexShader);
+		if (m_batchGeometryShader != 0) glAttachShader(build.program, m_batchGeometryShader);
+	}
+	else if (!compute) glAttachShader(build.program, m_shaderVertex);
+	glAttachShader(build.program, build.fragmentShader);
+	if (!build.cachePath.empty()) glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(build.program);
+}
+
+///
+/// \brief To check whether a program finished building.
+/// To check whether the driver finished compiling and linking a program, so finishProgram() does not block. 
+/// Always true without KHR_parallel_shader_compile, as the driver cannot tell.
+///
+bool Compositor::isProgramComplete(programBuild& build)
+{
+	if (build.fragmentShader == 0 || !m_hasParallelCompile) return true;
+
+	GLint complete = GL_FALSE;
+	glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete != GL_FALSE;
+}
+
+///
+/// \brief To finish building a program.
+/// To check the compile and link status of a program (blocking until the driver is done), save it to the program binary cache 
+/// and set up its vertex input. Returns 0 and deletes the program if it failed, the log is in m_shaderErrorString.
+///
+GLuint Compositor::finishProgram(programBuild& build, GLuint* fragmentShader)
+{
+	if (build.fragmentShader == 0)		//loaded from the program binary cache
+	{
+		if (!build.compute) setupVertexInput(build.program);
+		*fragmentShader = 0;
+		return build.program;
+	}
+
+	GLint Result;
+	glGetShaderiv(build.fragmentShader, GL_COMPILE_STATUS, &Result);
+	if (Result == GL_FALSE)
+	{
+		GLchar msg[1024]; GLsizei length;
+		glGetShaderInfoLog(build.fragmentShader, 1024, &length, msg);
+		m_shaderErrorString = std::string(msg);
+		deleteProgram(build.program, build.fragmentShader);
+		m_lastError = Compositor::SHADER_COMPILE_FAIL;
+		return 0;
+	}
+	glGetProgramiv(build.program, GL_LINK_STATUS, &Result);
+	if (Result == GL_FALSE)
+	{
+		GLchar msg[1024]; GLsizei length;
+		glGetProgramInfoLog(build.program, 1024, &length, msg);
+		m_shaderErrorString = std::string(msg);
+		deleteProgram(build.program, build.fragmentShader);
+		m_lastError = Compositor::SHADER_LINKING_FAIL;
+		return 0;
+	}
+
+	if (!build.cachePath.empty())
+	{
+		double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - build.start).count();
+		m_programCacheStats.secondsCompiling += buildSeconds;
+		saveProgramBinary(build.program, build.cacheKey, build.cachePath, buildSeconds);
+	}
+
+	if (!build.compute) setupVertexInput(build.program);
+
+	*fragmentShader = build.fragmentShader;
+	return build.program;
+}
+
+///
+/// \brief To install a built program into a pass.
+/// To replace the program of a pass with a built program, reflect its uniforms and assign its texture units.
+///
+void Compositor::installProgram(pass& p, GLuint program, GLuint fragmentShader, const std::string& source)
+{
+	deleteProgram(p.shaderProgram, p.shaderFragment);
+	p.shaderFragment = fragmentShader;
+	p.shaderProgram = program;
+	p.fragmentSource = source;
+	p.discards = !p.compute && hasDiscard(source);
+	p.initialized = true;
+	p.failed = false;
+	reflectUniforms(p);
+	changePass(p);
+}
+
+///
+/// \brief To install the pending shader of a pass if it finished compiling.
+/// To install the pending shader of a pass if the driver finished compiling it, or mark the pass as failed.
+///
+void Compositor::updatePendingShader(pass& p)
+{
+	if (!p.pending || !isProgramComplete(p.build)) return;
+
+	p.pending = false;
+	GLuint fragmentShader = 0;
+	GLuint program = finishProgram(p.build, &fragmentShader);
+	if (program == 0)
+	{
+		p.failed = true;
+		p.failedLog = m_shaderErrorString;
+		return;
+	}
+	installProgram(p, program, fragmentShader, p.build.source);
+}
+
+///
+/// \brief To check whether a pass can be rendered.
+/// To check whether a pass has a shader, or is pending and the pending policy allows rendering without it.
+///
+bool Compositor::isRenderable(pass& p)
+{
+	return p.initialized || (p.pending && m_pendingPolicy != PENDING_FAIL);
+}
+
+///
+/// \brief Render the passthrough shader into the outputs of a pass.
+/// Render the passthrough shader into the outputs of a pass, copying its input if it has exactly one.
+///
+void Compositor::renderPassthroughInternal(pass& p, passActions& actions)
+{
+	bindFramebuffer(p.fbo);
+	bindTexture(0, p.texInputs.size() == 1 ? p.texInputs.begin()->second : 0, GL_TEXTURE_2D);
+
+	GLsizei w, h;
+	getPassSize(p, w, h);
+	glDrawBuffers(p.drawBufferCount, p.texOutputsChannels);
+	setViewport(0, 0, w, h);
+	setClearColor(0.0, 0.0, 0.0, 1.0);
+	setBlend(GL_FALSE);
+	useProgram(m_passthroughProgram);
+	bindVertexArray(m_vertexArray, m_vertexBuffer);
+	loadOutputs(actions);
+	setDepthMask(GL_FALSE);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	storeOutputs(actions);
+}
+
+///
+/// \brief To read a shader file.
+/// To read a shader file.
+///
+bool Compositor::readShaderFile(char* filename, std::string& source)
+{
+	//parts of this are taken from http://www.opengl-tutorial.org/beginners-tutorials/tutorial-2-the-first-triangle/
+	std::ifstream FragmentShaderStream(filename, std::ios::in);
+	if (!FragmentShaderStream.is_open()) return false;
+
+	std::string Line = "";
+	while (getline(FragmentShaderStream, Line))
+		source += "\n" + Line;
+	FragmentShaderStream.close();
+	return true;
+}
+
+///
+/// \brief To load a program from the program binary cache.
+/// To load a program from a cache file. Returns 0 if the file does not exist, holds another key, 
+/// or the driver rejects the binary (e.g. after a driver update), in which case the program is compiled from source.
+///
+GLuint Compositor::loadProgramBinary(const std::string& key, const std::string& path, double* buildSeconds)
+{
+	std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+	if (!file.is_open()) return 0;
+	std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+
+	//file layout : "CPB1", key length, key, binary format, compile time in seconds, binary length, binary
+	size_t offset = 4;
+	GLuint keyLength = 0, binaryLength = 0;
+	GLint format = 0;
+	bool valid = data.size() >= offset + sizeof(GLuint) && memcmp(&data[0], "CPB1", 4) == 0;
+	if (valid) { memcpy(&keyLength, &data[offset], sizeof(GLuint)); offset += sizeof(GLuint); }
+	valid = valid && data.size() >= offset + keyLength + sizeof(GLint) + sizeof(double) + sizeof(GLuint);
+	if (valid)
+	{
+		if (key.size() != keyLength || memcmp(&data[offset], key.data(), keyLength) != 0) return 0;		//hash collision, not a broken file
+		offset += keyLength;
+		memcpy(&format, &data[offset], sizeof(GLint)); offset += sizeof(GLint);
+		memcpy(buildSeconds, &data[offset], sizeof(double)); offset += sizeof(double);
+		memcpy(&binaryLength, &data[offset], sizeof(GLuint)); offset += sizeof(GLuint);
+		valid = binaryLength > 0 && data.size() == offset + binaryLength &&
+			std::find(m_programBinaryFormats.begin(), m_programBinaryFormats.end(), format) != m_programBinaryFormats.end();
+	}
+	if (!valid) { m_programCacheStats.rejected++; return 0; }
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, (GLenum)format, &data[offset], (GLsizei)binaryLength);
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE)
+	{
+		glDeleteProgram(program);
+		m_programCacheStats.rejected++;
+		return 0;
+	}
+	return program;
+}
+
+///
+/// \brief To save a program to the program binary cache.
+/// To save a linked program to a cache file. The file is written under a temporary name and renamed, 
+/// so another process never reads a partially written file.
+///
+void Compositor::saveProgramBinary(GLuint program, const std::string& key, const std::string& path, double buildSeconds)
+{
+	GLint binaryLength = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	if (binaryLength <= 0) return;
+
+	std::vector<char> binary(binaryLength);
+	GLenum format = 0;
+	GLsizei length = 0;
+	glGetProgramBinary(program, binaryLength, &length, &format, &binary[0]);
+	if (length <= 0) return;
+
+	char suffix[48];
+	snprintf(suffix, sizeof(suffix), ".%llx.tmp", (unsigned long long)std::chrono::steady_clock::now().time_since_epoch().count() ^ (unsigned long long)(size_t)this);
+	std::string temporaryPath = path + suffix;
+
+	std::ofstream file(temporaryPath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) return;
+	GLuint keyLength = (GLuint)key.size(), binarySize = (GLuint)length;
+	GLint binaryFormat = (GLint)format;
+	file.write("CPB1", 4);
+	file.write((const char*)&keyLength, sizeof(GLuint));
+	file.write(key.data(), key.size());
+	file.write((const char*)&binaryFormat, sizeof(GLint));
+	file.write((const char*)&buildSeconds, sizeof(double));
+	file.write((const char*)&binarySize, sizeof(GLuint));
+	file.write(&binary[0], length);
+	file.close();
+	if (file.fail()) { remove(temporaryPath.c_str()); return; }
+
+	if (rename(temporaryPath.c_str(), path.c_str()) != 0)
+	{
+		remove(path.c_str());		//rename does not replace an existing file on Windows
+		if (rename(temporaryPath.c_str(), path.c_str()) != 0) remove(temporaryPath.c_str());
+	}
+}
+
+///
+/// \brief To hash a string.
+/// To hash a string with 64-bit FNV-1a, used to name program cache files.
+///
+unsigned long long Compositor::hashString(const std::string& str)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	hashBytes(hash, str.data(), str.size());
+	return hash;
+}
+
+///
+/// \brief To add bytes to a hash.
+/// To add bytes to a 64 bit FNV-1a hash.
+///
+void Compositor::hashBytes(unsigned long long& hash, const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+}
+
+///
+/// \brief To bind the quad vertex buffer to the vertex input of a program.
+/// To bind the VAO and array buffer to the vPos in the vertex shader of a program.
+///
+void Compositor::setupVertexInput(GLuint program)
+{
+	GLint bufferVertexArray, bufferArrayBuffer;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &bufferVertexArray);
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &bufferArrayBuffer);
 
-	glDrawBuffers(p->second.texOutputs.size(), p->second.texOutputsChannels);
-	glViewport(0, 0, m_width, m_height);
-	glClearColor(0.0, 0.0, 0.0, 1.0);
-	glDisable(GL_BLEND);
-	glUseProgram(p->second.shaderProgram);
 	glBindVertexArray(m_vertexArray);
 	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
-	glClear(GL_COLOR_BUFFER_BIT);
-	glDepthMask(GL_FALSE);
+
+	GLint uni_vpos = -1;
+	uni_vpos = glGetAttribLocation(program, "vPos");
+	glVertexAttribPointer(uni_vpos, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	glEnableVertexAttribArray(uni_vpos);
+
+	glBindVertexArray(bufferVertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, bufferArrayBuffer);
+}
+
+///
+/// \brief To delete a program and its fragment shader.
+/// To delete a program and its fragment shader. Does nothing if the program is 0.
+///
+void Compositor::deleteProgram(GLuint program, GLuint fragmentShader)
+{
+	if (program == 0) return;
+	if (m_cache.shaderProgram == program) m_cache.valid &= ~CACHED_PROGRAM;
+	if (fragmentShader != 0)	//programs loaded from a binary have no shaders attached
+	{
+		glDetachShader(program, fragmentShader);
+		glDeleteShader(fragmentShader);
+	}
+	glDeleteProgram(program);		//also detaches the vertex shader, compute programs do not have it
+}
+
+///
+/// \brief To compute the rendering order of a pipeline.
+/// To compute the rendering order of a pipeline (sorting and culling a graph pipeline), and plan fusion of its passes if enabled.
+///
+bool Compositor::resolvePipeline(pipeline& pl)
+{
+	if (pl.type == PIPELINE_GRAPH)
+	{
+		if (!resolveGraph(pl)) return false;
+	}
+	else pl.order = pl.passes;
+
+	planFusion(pl);
+	planBarriers(pl);
+	planActions(pl);
+	pl.resolvedVersion = pipelineVersion(pl);
+	return true;
+}
+
+///
+/// \brief To get the key of an output of a pass.
+/// To get the key identifying the texture written to an output channel of a pass : the texture ID, or -1 - transient ID for transient textures.
+///
+long long Compositor::outputKey(pass& p, int texChannel)
+{
+	std::map<int, int>::iterator t = p.transientOutputs.find(texChannel);
+	if (t != p.transientOutputs.end()) return -1 - (long long)t->second;
+	return (long long)p.texOutputs[texChannel];
+}
+
+///
+/// \brief To get the key of an input of a pass.
+/// To get the key identifying the texture read by a sampler of a pass : the texture ID, or -1 - transient ID for transient textures.
+///
+long long Compositor::inputKey(pass& p, int texUniform)
+{
+	std::map<int, int>::iterator t = p.transientInputs.find(texUniform);
+	if (t != p.transientInputs.end()) return -1 - (long long)t->second;
+	return (long long)p.texInputs[texUniform];
+}
+
+///
+/// \brief To find passes of a pipeline which can be fused.
+/// To find chains of consecutive passes in which each pass has a single output, read only by the next pass and only at in_uv, 
+/// and generate one fused program for each chain. Chains whose fused program cannot be built are rendered unfused.
+///
+void Compositor::planFusion(pipeline& pl)
+{
+	pl.fusedGroup.clear();
+	pl.fused.clear();
+	if (!pl.fusion) return;
+	for (size_t i = 0; i < pl.order.size(); i++)
+		if (m_passes.find(pl.order[i]) == nullptr) return;		//deleted pass, the pipeline cannot be rendered
+
+	int n = (int)pl.order.size();
+	pl.fusedGroup.assign(n, (int)NOT_FUSED);
+
+	std::map<long long, int> readers;		//number of samplers reading each texture in the pipeline
+	for (int i = 0; i < n; i++)
+	{
+		pass& p = m_passes[pl.order[i]];
+		std::map<int, GLuint>::iterator t;
+		for (t = p.texInputs.begin(); t != p.texInputs.end(); ++t)
+			readers[inputKey(p, t->first)]++;
+	}
+	std::set<long long> finals(pl.finalOutputs.begin(), pl.finalOutputs.end());
+
+	int i = 0;
+	while (i < n)
+	{
+		std::string source = m_passes[pl.order[i]].fragmentSource;
+		std::vector<int> members(1, pl.order[i]);
+		std::vector<std::string> prefixes(1, "");
+		int j = i;
+		while (j + 1 < n)
+		{
+			pass& producer = m_passes[pl.order[j]];
+			pass& consumer = m_passes[pl.order[j + 1]];
+			if (!producer.initialized || !consumer.initialized || producer.compute || consumer.compute || producer.layered || consumer.layered || producer.batchSize > 0 || consumer.batchSize > 0 || producer.texOutputs.size() != 1) break;
+			GLsizei producerWidth, producerHeight, consumerWidth, consumerHeight;
+			getPassSize(producer, producerWidth, producerHeight);
+			getPassSize(consumer, consumerWidth, consumerHeight);
+			if (producerWidth != consumerWidth || producerHeight != consumerHeight) break;
+
+			long long key = outputKey(producer, producer.texOutputs.begin()->first);
+			if (finals.count(key) != 0 || readers[key] != 1) break;
+
+			int sampler = -1;
+			std::map<int, GLuint>::iterator t;
+			for (t = consumer.texInputs.begin(); t != consumer.texInputs.end(); ++t)
+				if (inputKey(consumer, t->first) == key) sampler = t->first;
+			if (sampler < 0) break;
+
+			std::string prefix = "fuse" + std::to_string(members.size() - 1) + "_";
+			std::string fusedSource;
+			if (!fuseShaderSources(source, consumer.fragmentSource, m_samplerNames[sampler], prefix, fusedSource)) break;
+
+			source = fusedSource;
+			for (size_t m = 0; m < prefixes.size(); m++)
+				prefixes[m] = prefix + prefixes[m];
+			members.push_back(pl.order[j + 1]);
+			prefixes.push_back("");
+			j++;
+		}
+
+		fusedPass f;
+		f.members = members;
+		if (members.size() > 1 && buildFusedPass(f, source, prefixes))
+		{
+			for (int k = i; k < j; k++)
+				pl.fusedGroup[k] = FUSED_AWAY;
+			pl.fusedGroup[j] = (int)pl.fused.size();
+			pl.fused.push_back(f);
+		}
+		i = j + 1;
+	}
+}
+
+///
+/// \brief To find the memory barriers needed by a pipeline.
+/// To find, for each pass of a pipeline, the glMemoryBarrier bits needed before it because it reads or writes textures 
+/// written as images by an earlier compute pass, only for the way it uses them (sampler, image or render target) and only 
+/// once per texture. Outputs written as images which are not transient textures get a barrier for the main program at the end.
+///
+void Compositor::planBarriers(pipeline& pl)
+{
+	pl.barriers.assign(pl.order.size(), 0);
+	pl.finalBarrier = 0;
+	for (size_t i = 0; i < pl.order.size(); i++)
+		if (m_passes.find(pl.order[i]) == nullptr) return;		//deleted pass, the pipeline cannot be rendered
+
+	std::map<long long, GLbitfield> written;		//key is texture written as image, value is barrier bits issued since
+	for (size_t i = 0; i < pl.order.size(); i++)
+	{
+		pass& p = m_passes[pl.order[i]];
+		GLbitfield bits = 0;
+		std::map<long long, GLbitfield>::iterator w;
+		std::map<int, GLuint>::iterator t;
+		for (t = p.texInputs.begin(); t != p.texInputs.end(); ++t)
+		{
+			w = written.find(inputKey(p, t->first));
+			if (w == written.end()) continue;
+			GLbitfield needed = GL_TEXTURE_FETCH_BARRIER_BIT;
+			for (size_t k = 0; k < p.imageInputs.size(); k++)
+				if (p.imageInputs[k].first == t->first) needed = GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+			if ((w->second & needed) == 0) bits |= needed;
+		}
+		std::map<int, GLuint>::iterator o;
+		for (o = p.texOutputs.begin(); o != p.texOutputs.end(); ++o)
+		{
+			w = written.find(outputKey(p, o->first));
+			if (w == written.end()) continue;
+			GLbitfield needed = p.compute ? GL_SHADER_IMAGE_ACCESS_BARRIER_BIT : GL_FRAMEBUFFER_BARRIER_BIT;
+			if ((w->second & needed) == 0) bits |= needed;
+		}
+
+		pl.barriers[i] = bits;
+		for (w = written.begin(); w != written.end(); ++w)
+			w->second |= bits;
+		for (o = p.texOutputs.begin(); o != p.texOutputs.end(); ++o)
+		{
+			if (p.compute) written[outputKey(p, o->first)] = 0;
+			else written.erase(outputKey(p, o->first));		//rendered again, ordered with later commands
+		}
+	}
+
+	std::map<long long, GLbitfield>::iterator w;
+	for (w = written.begin(); w != written.end(); ++w)
+		if (w->first >= 0) pl.finalBarrier |= HOST_BARRIER_BITS & ~w->second;
+}
+
+///
+/// \brief To find the region each pass of a pipeline must render.
+/// To propagate the damage reported on textures through the passes of a pipeline in rendering order : a pass renders the union of 
+/// the damaged regions of its inputs grown by its kernel radius, and that region becomes damaged on its outputs. Passes are rendered 
+/// in full when the previous rendering cannot be reused, when their uniforms changed, or when they write transient textures, 
+/// whose content is not kept between renderings.
+///
+void Compositor::computeDamage(pipeline& pl, std::vector<damageRect>& regions)
+{
+	bool full = !pl.damageValid || pl.damageVersion != pipelineVersion(pl) || pl.damageWidth != m_width || pl.damageHeight != m_height || 
+		pl.damageBlocksVersion != m_uniformBlocksVersion;
+	damageRect all = { 0.0f, 0.0f, 1.0f, 1.0f }, none = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	std::map<long long, damageRect> damaged;		//key is texture key (see Compositor::outputKey())
+	std::map<GLuint, damageRect>::iterator d;
+	for (d = pl.damage.begin(); d != pl.damage.end(); ++d)
+		damaged[(long long)d->first] = d->second;
+
+	regions.assign(pl.order.size(), none);
+	for (size_t i = 0; i < pl.order.size(); i++)
+	{
+		pass& p = m_passes[pl.order[i]];
+		unsigned int& changes = pl.damageUniforms[pl.order[i]];
+		damageRect r = none;
+		if (full || changes != p.uniformChanges || !p.transientOutputs.empty()) r = all;
+		else
+		{
+			std::map<int, GLuint>::iterator t;
+			for (t = p.texInputs.begin(); t != p.texInputs.end(); ++t)
+			{
+				std::map<long long, damageRect>::iterator in = damaged.find(inputKey(p, t->first));
+				if (in != damaged.end()) r = unionRect(r, in->second);
+			}
+			if (p.layered && r.x0 < r.x1 && r.y0 < r.y1) r = all;		//a layer texture can be drawn anywhere
+			if (r.x0 < r.x1 && r.y0 < r.y1 && p.kernelRadius > 0)
+			{
+				GLsizei w, h;
+				getPassSize(p, w, h);
+				r.x0 = std::max(0.0f, r.x0 - (float)p.kernelRadius / w);
+				r.y0 = std::max(0.0f, r.y0 - (float)p.kernelRadius / h);
+				r.x1 = std::min(1.0f, r.x1 + (float)p.kernelRadius / w);
+				r.y1 = std::min(1.0f, r.y1 + (float)p.kernelRadius / h);
+			}
+		}
+		changes = p.uniformChanges;
+		regions[i] = r;
+
+		std::map<int, GLuint>::iterator o;
+		for (o = p.texOutputs.begin(); o != p.texOutputs.end(); ++o)
+		{
+			long long key = outputKey(p, o->first);
+			std::map<long long, damageRect>::iterator out = damaged.find(key);
+			damaged[key] = out == damaged.end() ? r : unionRect(out->second, r);
+		}
+	}
+
+	pl.damageVersion = pipelineVersion(pl);
+	pl.damageWidth = m_width;
+	pl.damageHeight = m_height;
+	pl.damageBlocksVersion = m_uniformBlocksVersion;
+}
+
+///
+/// \brief To check whether a pass must be rendered again.
+/// To hash what the outputs of a pass depend on : its shader and textures (through pass::version), uniform values, uniform blocks, 
+/// resolution and the versions of its input textures. Returns true if the hash differs from the last call, and stores it.
+///
+bool Compositor::isPassChanged(pass& p)
+{
+	if (!p.initialized || !p.transientInputs.empty() || !p.transientOutputs.empty())
+	{
+		p.memoValid = false;
+		return true;
+	}
+
+	unsigned long long hash = 14695981039346656037ULL;
+	hashBytes(hash, &p.version, sizeof(p.version));
+	hashBytes(hash, &m_uniformBlocksVersion, sizeof(m_uniformBlocksVersion));
+	GLsizei w, h;
+	getPassSize(p, w, h);
+	hashBytes(hash, &w, sizeof(w));
+	hashBytes(hash, &h, sizeof(h));
+	if (p.layered) hashBytes(hash, &p.uniformChanges, sizeof(p.uniformChanges));
+	for (size_t i = 0; i < p.uniforms.size(); i++)
+	{
+		const uniform& u = p.uniforms[i];
+		if (!u.valid) continue;
+		hashBytes(hash, &i, sizeof(i));
+		hashBytes(hash, &u.kind, sizeof(u.kind));
+		hashBytes(hash, u.value, u.components * sizeof(GLuint));
+	}
+	std::map<int, GLuint>::iterator t;
+	for (t = p.texInputs.begin(); t != p.texInputs.end(); ++t)
+	{
+		std::map<GLuint, unsigned int>::iterator v = m_textureVersions.find(t->second);
+		unsigned int version = v == m_textureVersions.end() ? 0 : v->second;
+		hashBytes(hash, &t->second, sizeof(t->second));
+		hashBytes(hash, &version, sizeof(version));
+	}
+
+	if (p.memoValid && p.memoSignature == hash) return false;
+	p.memoSignature = hash;
+	p.memoValid = true;
+	return true;
+}
+
+///
+/// \brief To change the version of the outputs of a pass.
+/// To change the version of the output textures of a pass after rendering it, so passes reading them are rendered again.
+///
+void Compositor::markOutputsChanged(pass& p)
+{
+	std::map<int, GLuint>::iterator o;
+	for (o = p.texOutputs.begin(); o != p.texOutputs.end(); ++o)
+		++m_textureVersions[o->second];
+}
+
+///
+/// \brief To change the version of a pass.
+/// To change the version of a pass after its shader, an input, an output or its size changed, so only the pipelines using it are 
+/// resolved, baked or rendered again.
+///
+void Compositor::changePass(pass& p)
+{
+	p.version = ++m_passesVersion;
+}
+
+///
+/// \brief To get the version of a pipeline.
+/// To get the latest of the versions of a pipeline, of its passes and of the last deletion of a pass or a transient texture : the 
+/// order, transient textures, frames and baked list of the pipeline are out of date when it differs from the one they were made with.
+///
+unsigned int Compositor::pipelineVersion(pipeline& pl)
+{
+	unsigned int version = pl.version > m_globalVersion ? pl.version : m_globalVersion;
+	for (size_t i = 0; i < pl.passes.size(); i++)
+	{
+		pass* p = m_passes.find(pl.passes[i]);
+		if (p != nullptr && p->version > version) version = p->version;
+	}
+	return version;
+}
+
+///
+/// \brief To set up the frame slots of a pipeline with frames in flight.
+/// To create the copies of the output textures for each frame slot (again only if the size or format of a texture changed), and for 
+/// each pass and slot, a framebuffer with the copies attached and the inputs remapped to the copies : an output of the pipeline read 
+/// by a later pass is read from the same slot, and one read by the pass writing it or an earlier pass is read from the previous slot, 
+/// as it was the previous frame. Transient textures are not copied, they are assigned when the frame is rendered.
+///
+void Compositor::setupFrames(pipeline& pl)
+{
+	deleteFrames(pl, false);
+	int n = pl.framesInFlight;
+
+	std::map<GLuint, int> producer;		//key is output texture of the main program, value is position in pl.order of the first pass writing it
+	for (int i = 0; i < (int)pl.order.size(); i++)
+	{
+		pass& p = m_passes[pl.order[i]];
+		std::map<int, GLuint>::iterator o;
+		for (o = p.texOutputs.begin(); o != p.texOutputs.end(); ++o)
+			if (o->second != 0 && p.transientOutputs.find(o->first) == p.transientOutputs.end()) producer.insert(std::make_pair(o->second, i));
+	}
+
+	std::map<GLuint, frameTexture>::iterator t = pl.frameTextures.begin();
+	while (t != pl.frameTextures.end())
+	{
+		if (producer.find(t->first) != producer.end()) { ++t; continue; }
+		for (size_t c = 0; c < t->second.copies.size(); c++) m_imageFormats.erase(t->second.copies[c]);
+		glDeleteTextures((GLsizei)t->second.copies.size(), &t->second.copies[0]);
+		pl.frameTextures.erase(t++);
+	}
+	std::map<GLuint, int>::iterator w;
+	for (w = producer.begin(); w != producer.end(); ++w)
+	{
+		GLint width = 0, height = 0, format = GL_RGBA8;
+		bindTexture(0, w->first, GL_TEXTURE_2D);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+
+		t = pl.frameTextures.find(w->first);
+		if (t != pl.frameTextures.end())
+		{
+			frameTexture& f = t->second;
+			if (f.width == width && f.height == height && f.internalFormat == (GLenum)format) continue;
+			for (size_t c = 0; c < f.copies.size(); c++) m_imageFormats.erase(f.copies[c]);
+			glDeleteTextures((GLsizei)f.copies.size(), &f.copies[0]);
+		}
+		frameTexture& f = pl.frameTextures[w->first];
+		f.width = width;
+		f.height = height;
+		f.internalFormat = format;
+		f.copies.assign(n - 1, 0);
+		glGenTextures(n - 1, &f.copies[0]);
+		for (int c = 0; c < n - 1; c++)
+		{
+			bindTexture(0, f.copies[c], GL_TEXTURE_2D);
+			if (m_glVersion >= 42) glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+			else glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			m_imageFormats[f.copies[c]] = format;
+		}
+	}
+
+	for (int s = 0; s < n; s++)
+	{
+		for (int i = 0; i < (int)pl.order.size(); i++)
+		{
+			std::map<int, passFrame>& passes = pl.frames[s].passes;
+			if (passes.find(pl.order[i]) != passes.end()) continue;		//pass listed twice, rendered with the same textures
+			pass& p = m_passes[pl.order[i]];
+			passFrame& f = passes[pl.order[i]];
+
+			//slot 0 renders into the textures of the main program with the framebuffer of the pass, only its inputs change
+			f.fbo = 0;
+			f.texOutputs = p.texOutputs;
+			if (s > 0)
+			{
+				glGenFramebuffers(1, &f.fbo);
+				bindFramebuffer(f.fbo);
+				std::map<int, GLuint>::iterator o;
+				for (o = f.texOutputs.begin(); o != f.texOutputs.end(); ++o)
+				{
+					if (p.transientOutputs.find(o->first) != p.transientOutputs.end()) o->second = 0;		//attached by applyTransients()
+					else if (o->second != 0) o->second = pl.frameTextures[o->second].copies[s - 1];
+					if (o->second != 0) glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + o->first, GL_TEXTURE_2D, o->second, 0);
+				}
+			}
+
+			f.texInputs = p.texInputs;
+			std::map<int, GLuint>::iterator in;
+			for (in = f.texInputs.begin(); in != f.texInputs.end(); ++in)
+			{
+				if (p.transientInputs.find(in->first) != p.transientInputs.end()) continue;
+				w = producer.find(in->second);
+				if (w == producer.end()) continue;
+				int from = w->second < i ? s : (s + n - 1) % n;
+				if (from > 0) in->second = pl.frameTextures[w->first].copies[from - 1];
+			}
+			f.unitTextures.assign(p.unitSamplers.size(), 0);
+			for (size_t unit = 0; unit < p.unitSamplers.size(); unit++)
+			{
+				in = f.texInputs.find(p.unitSamplers[unit]);
+				if (in != f.texInputs.end()) f.unitTextures[unit] = in->second;
+			}
+		}
+	}
+	pl.framesVersion = pipelineVersion(pl);
+}
+
+///
+/// \brief To swap the textures of the passes of a pipeline with those of a frame slot.
+/// To swap the framebuffer, inputs and outputs of the passes of a pipeline with those of a frame slot, before rendering into that slot. 
+/// Swapping again after rendering gives the passes their own textures back.
+///
+void Compositor::swapFrame(pipeline& pl, int slot)
+{
+	std::map<int, passFrame>::iterator f;
+	for (f = pl.frames[slot].passes.begin(); f != pl.frames[slot].passes.end(); ++f)
+	{
+		pass& p = m_passes[f->first];
+		if (f->second.fbo != 0)
+		{
+			std::swap(p.fbo, f->second.fbo);
+			p.texOutputs.swap(f->second.texOutputs);
+		}
+		p.texInputs.swap(f->second.texInputs);
+		p.unitTextures.swap(f->second.unitTextures);
+	}
+}
+
+///
+/// \brief To delete the frame slots of a pipeline.
+/// To delete the framebuffers of the frame slots of a pipeline, and if all is true, also the copies of the output textures and the fences.
+///
+void Compositor::deleteFrames(pipeline& pl, bool all)
+{
+	for (size_t s = 0; s < pl.frames.size(); s++)
+	{
+		std::map<int, passFrame>::iterator f;
+		for (f = pl.frames[s].passes.begin(); f != pl.frames[s].passes.end(); ++f)
+		{
+			if (f->second.fbo == 0) continue;
+			if (m_cache.fbo == f->second.fbo) m_cache.valid &= ~CACHED_FBO;
+			pass* p = m_passes.find(f->first);
+			if (p != nullptr && p->renderedFbo == f->second.fbo) p->renderedFbo = 0;
+			glDeleteFramebuffers(1, &f->second.fbo);
+		}
+		pl.frames[s].passes.clear();
+		if (all && pl.frames[s].fence != 0) glDeleteSync(pl.frames[s].fence);
+	}
+	if (!all) return;
+
+	pl.frames.clear();
+	std::map<GLuint, frameTexture>::iterator t;
+	for (t = pl.frameTextures.begin(); t != pl.frameTextures.end(); ++t)
+	{
+		for (size_t c = 0; c < t->second.copies.size(); c++) m_imageFormats.erase(t->second.copies[c]);
+		glDeleteTextures((GLsizei)t->second.copies.size(), &t->second.copies[0]);
+	}
+	pl.frameTextures.clear();
+}
+
+///
+/// \brief To check whether the GPU finished a frame slot.
+/// To check whether the fence of a frame slot is signaled, without waiting. The fence is deleted once signaled.
+///
+bool Compositor::isFrameDone(pipelineFrame& frame)
+{
+	if (frame.fence == 0) return true;
+	GLenum status = glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+	glDeleteSync(frame.fence);
+	frame.fence = 0;
+	return true;
+}
+
+///
+/// \brief To prepare the outputs of a pass before it renders.
+/// To invalidate the outputs whose previous content is not needed, unless only part of them is rendered, and clear those to be cleared.
+///
+void Compositor::loadOutputs(const passActions& actions)
+{
+	if (!actions.invalidateBefore.empty() && m_hasInvalidate && m_cache.scissorTest != GL_TRUE)
+		glInvalidateFramebuffer(GL_DRAW_FRAMEBUFFER, (GLsizei)actions.invalidateBefore.size(), &actions.invalidateBefore[0]);
+	if (actions.clearAll) glClear(GL_COLOR_BUFFER_BIT);
+	else
+	{
+		static const GLfloat black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		for (size_t i = 0; i < actions.clearBuffers.size(); i++) glClearBufferfv(GL_COLOR, actions.clearBuffers[i], black);
+	}
+}
+
+///
+/// \brief To invalidate the discarded outputs of a pass after it renders.
+/// To invalidate the discarded outputs of a pass after it renders.
+///
+void Compositor::storeOutputs(const passActions& actions)
+{
+	if (!actions.invalidateAfter.empty() && m_hasInvalidate)
+		glInvalidateFramebuffer(GL_DRAW_FRAMEBUFFER, (GLsizei)actions.invalidateAfter.size(), &actions.invalidateAfter[0]);
+}
+
+///
+/// \brief To invalidate the transient textures read for the last time.
+/// To invalidate the transient textures which a pass of a pipeline read for the last time, so the driver can drop their content.
+///
+void Compositor::invalidateInputs(const passActions& actions)
+{
+	if (!m_hasInvalidate) return;
+	for (size_t i = 0; i < actions.invalidateInputs.size(); i++)
+	{
+		pass& p = m_passes[actions.invalidateInputs[i].first];
+		std::map<int, GLuint>::iterator t = p.texInputs.find(actions.invalidateInputs[i].second);
+		if (t != p.texInputs.end() && t->second != 0) glInvalidateTexImage(t->second, 0);
+	}
+}
+
+///
+/// \brief To resolve the load and store actions of the outputs of a pass.
+/// To resolve the load and store actions of the outputs of a pass, rendered alone or by a pipeline. The default store action 
+/// needs the pipeline and the last position in its order at which each input key (see Compositor::inputKey()) is read.
+///
+void Compositor::resolveActions(pass& p, bool discards, pipeline* pl, std::map<long long, int>* lastRead, passActions& actions)
+{
+	actions.clearBuffers.clear();
+	actions.invalidateBefore.clear();
+	actions.invalidateAfter.clear();
+	actions.invalidateInputs.clear();
+	actions.clearAll = false;
+	if (p.compute) return;
+
+	bool allCleared = true;
+	std::map<int, GLuint>::iterator o;
+	for (o = p.texOutputs.begin(); o != p.texOutputs.end(); ++o)
+	{
+		GLenum attachment = GL_COLOR_ATTACHMENT0 + o->first;
+		std::map<int, loadAction>::iterator l = p.loadActions.find(o->first);
+		loadAction load = l != p.loadActions.end() ? l->second : (discards ? LOAD_ACTION_CLEAR : LOAD_ACTION_DONT_CARE);
+		if (load == LOAD_ACTION_CLEAR) actions.clearBuffers.push_back(o->first);		//draw buffer i writes channel i
+		else allCleared = false;
+		if (load == LOAD_ACTION_DONT_CARE) actions.invalidateBefore.push_back(attachment);
+
+		std::map<int, storeAction>::iterator st = p.storeActions.find(o->first);
+		storeAction store = STORE_ACTION_STORE;
+		if (st != p.storeActions.end()) store = st->second;
+		else if (pl != nullptr && lastRead->find(outputKey(p, o->first)) == lastRead->end())
+		{
+			//no pass of the pipeline reads it, discarded unless the main program can read it
+			bool transient = p.transientOutputs.find(o->first) != p.transientOutputs.end();
+			bool requested = pl->type != PIPELINE_GRAPH || pl->finalOutputs.empty() || 
+				std::find(pl->finalOutputs.begin(), pl->finalOutputs.end(), o->second) != pl->finalOutputs.end();
+			if (transient || !requested) store = STORE_ACTION_DISCARD;
+		}
+		if (store == STORE_ACTION_DISCARD) actions.invalidateAfter.push_back(attachment);
+	}
+	actions.clearAll = allCleared && !actions.clearBuffers.empty();
+}
+
+///
+/// \brief To resolve the load and store actions of the passes of a pipeline.
+/// To resolve the load and store actions of each pass of a pipeline from the passes reading its outputs, and find the transient 
+/// inputs read for the last time after their last write, which are invalidated after the pass (or fused pass) reading them.
+///
+void Compositor::planActions(pipeline& pl)
+{
+	std::map<long long, int> lastRead, lastWrite;	//key is input or output key, value is the last position in order reading or writing it
+	for (size_t i = 0; i < pl.order.size(); i++)
+	{
+		pass& p = m_passes[pl.order[i]];
+		std::map<int, GLuint>::iterator t;
+		for (t = p.texInputs.begin(); t != p.texInputs.end(); ++t) lastRead[inputKey(p, t->first)] = (int)i;
+		for (t = p.texOutputs.begin(); t != p.texOutputs.end(); ++t) lastWrite[outputKey(p, t->first)] = (int)i;
+	}
+
+	pl.actions.assign(pl.order.size(), passActions());
+	for (size_t i = 0; i < pl.order.size(); i++)
+	{
+		pass& p = m_passes[pl.order[i]];
+		int group = pl.fusedGroup.empty() ? NOT_FUSED : pl.fusedGroup[i];
+		if (group == FUSED_AWAY) continue;
+		bool discards = p.discards;
+		for (size_t m = 0; group >= 0 && m < pl.fused[group].members.size(); m++) discards = discards || m_passes[pl.fused[group].members[m]].discards;
+		resolveActions(p, discards, &pl, &lastRead, pl.actions[i]);
+	}
+
+	for (size_t i = 0; i < pl.order.size(); i++)
+	{
+		pass& p = m_passes[pl.order[i]];
+		size_t rendered = i;
+		while (!pl.fusedGroup.empty() && pl.fusedGroup[rendered] == FUSED_AWAY) ++rendered;
+		std::map<int, int>::iterator t;
+		for (t = p.transientInputs.begin(); t != p.transientInputs.end(); ++t)
+		{
+			long long key = -1 - (long long)t->second;
+			std::map<long long, int>::iterator w = lastWrite.find(key);
+			if (lastRead[key] == (int)i && (w == lastWrite.end() || w->second < (int)i))
+				pl.actions[rendered].invalidateInputs.push_back(std::make_pair(pl.order[i], t->first));
+		}
+	}
+}
+
+///
+/// \brief To check whether a shader contains discard.
+/// To check whether a shader source contains the discard keyword, in which case its outputs are cleared by default. 
+/// A discard in a comment is also found, which only costs a clear.
+///
+bool Compositor::hasDiscard(const std::string& source)
+{
+	size_t at = 0;
+	while ((at = source.find("discard", at)) != std::string::npos)
+	{
+		bool before = at > 0 && (isalnum((unsigned char)source[at - 1]) || source[at - 1] == '_');
+		bool after = at + 7 < source.size() && (isalnum((unsigned char)source[at + 7]) || source[at + 7] == '_');
+		if (!before && !after) return true;
+		at += 7;
+	}
+	return false;
+}
+
+///
+/// \brief To check whether a pipeline is rendered from a baked command list.
+/// To check whether baking is enabled and none of the features which need the passes looked up at each rendering is.
+///
+bool Compositor::canReplay(pipeline& pl)
+{
+	return pl.baking && !pl.timing && !pl.damageTracking && !pl.memoization && pl.framesInFlight <= 1;
+}
+
+///
+/// \brief To bake a pipeline into a command list.
+/// To bake a verified pipeline, with its transient textures applied, into a command list. A state change is only recorded when 
+/// the previous commands did not already make it, and draw buffers only once per framebuffer. A pipeline with a pass whose first 
+/// shader is still pending is not baked, as the pass is skipped or drawn with the passthrough program : it is rendered without 
+/// the list, and baked once the shader is installed, which changes the version of the pass.
+///
+void Compositor::bakePipeline(pipeline& pl)
+{
+	bakedList& b = pl.baked;
+	for (size_t i = 0; i < pl.order.size(); i++)
+		if (!m_passes[pl.order[i]].initialized) { b.version = pipelineVersion(pl) - 1; return; }
+
+	b.commands.clear();
+	b.textures.clear();
+	b.drawBuffers.clear();
+	b.passes.clear();
+	b.versions.clear();
+	b.rendered = 0;
+
+	bool fboKnown = false, programKnown = false;
+	GLuint fbo = 0, program = 0;
+	GLsizei width = 0, height = 0;
+	std::vector<GLuint> units;								//texture bound to each unit by the commands so far
+	std::map<GLuint, std::pair<GLuint, GLenum>> images;		//key is image unit, value is texture and access bound by the commands so far
+	std::set<GLuint> drawBufferFbos;						//framebuffers whose draw buffers the commands set
+	std::set<int> seen;
+	for (size_t i = 0; i < pl.order.size(); i++)
+	{
+		if (pl.barriers[i] != 0) addBakedCommand(b, BAKED_BARRIER, 0, (GLint)pl.barriers[i], 0, 0);
+		pass& p = m_passes[pl.order[i]];
+		if (seen.insert(pl.order[i]).second) b.passes.push_back(pl.order[i]);
+		std::map<int, GLuint>::iterator o;
+		for (o = p.texOutputs.begin(); o != p.texOutputs.end(); ++o) b.versions.push_back(&m_textureVersions[o->second]);
+
+		int group = pl.fusedGroup.empty() ? NOT_FUSED : pl.fusedGroup[i];
+		if (group == FUSED_AWAY) continue;
+		++b.rendered;
+		pass& target = group >= 0 ? m_passes[pl.fused[group].members.back()] : p;
+		std::vector<GLuint> textures = p.unitTextures;
+		GLuint passProgram = p.shaderProgram;
+		if (group >= 0)
+		{
+			fusedPass& f = pl.fused[group];
+			textures.assign(f.samplerSources.size(), 0);
+			for (size_t s = 0; s < f.samplerSources.size(); s++)
+			{
+				if (f.samplerSources[s].first < 0) continue;
+				pass& member = m_passes[f.members[f.samplerSources[s].first]];
+				std::map<int, GLuint>::iterator t = member.texInputs.find(f.samplerSources[s].second);
+				if (t != member.texInputs.end()) textures[s] = t->second;
+			}
+			passProgram = f.program->program;
+		}
+
+		if (!p.compute && (!fboKnown || fbo != target.fbo))
+		{
+			addBakedCommand(b, BAKED_FRAMEBUFFER, target.fbo, 0, 0, 0);
+			fbo = target.fbo;
+			fboKnown = true;
+		}
+		for (int unit = 0; unit < (int)textures.size(); )
+		{
+			if (unit < (int)units.size() && units[unit] == textures[unit]) { unit++; continue; }
+			int first = unit;
+			while (unit < (int)textures.size() && !(unit < (int)units.size() && units[unit] == textures[unit])) unit++;
+			addBakedCommand(b, BAKED_TEXTURES, group >= 0 ? 0 : p.arrayUnits >> first, first, unit - first, (GLint)b.textures.size());
+			b.textures.insert(b.textures.end(), textures.begin() + first, textures.begin() + unit);
+		}
+		if (units.size() < textures.size()) units.resize(textures.size());
+		std::copy(textures.begin(), textures.end(), units.begin());
+
+		GLsizei w, h;
+		getPassSize(target, w, h);
+		if (!p.compute)
+		{
+			if (drawBufferFbos.insert(target.fbo).second)
+			{
+				addBakedCommand(b, BAKED_DRAW_BUFFERS, 0, target.drawBufferCount, (GLint)b.drawBuffers.size(), 0);
+				b.drawBuffers.insert(b.drawBuffers.end(), target.texOutputsChannels, target.texOutputsChannels + target.drawBufferCount);
+			}
+			if (w != width || h != height)
+			{
+				addBakedCommand(b, BAKED_VIEWPORT, 0, w, h, 0);
+				width = w;
+				height = h;
+			}
+		}
+		if (!programKnown || program != passProgram)
+		{
+			addBakedCommand(b, BAKED_PROGRAM, passProgram, 0, 0, 0);
+			program = passProgram;
+			programKnown = true;
+		}
+		if (group >= 0) addBakedCommand(b, BAKED_FUSED_UNIFORMS, 0, group, 0, 0);
+		else if (!p.uniforms.empty()) addBakedCommand(b, BAKED_UNIFORMS, 0, pl.order[i], 0, 0);
+
+		if (p.compute)
+		{
+			std::vector<std::pair<GLuint, std::pair<GLuint, GLenum>>> bindings;		//image unit, texture and access
+			for (o = p.texOutputs.begin(); o != p.texOutputs.end(); ++o)
+				bindings.push_back(std::make_pair(o->first, std::make_pair(o->second, (GLenum)GL_WRITE_ONLY)));
+			for (size_t s = 0; s < p.imageInputs.size(); s++)
+			{
+				std::map<int, GLuint>::iterator t = p.texInputs.find(p.imageInputs[s].first);
+				if (t != p.texInputs.end() && t->second != 0)
+					bindings.push_back(std::make_pair(p.imageInputs[s].second, std::make_pair(t->second, (GLenum)GL_READ_ONLY)));
+			}
+			for (size_t s = 0; s < bindings.size(); s++)
+			{
+				std::map<GLuint, std::pair<GLuint, GLenum>>::iterator bound = images.find(bindings[s].first);
+				if (bound != images.end() && bound->second == bindings[s].second) continue;
+				GLuint texture = bindings[s].second.first;
+				addBakedCommand(b, BAKED_IMAGE, texture, bindings[s].first, bindings[s].second.second, imageFormat(texture));
+				images[bindings[s].first] = bindings[s].second;
+			}
+			addBakedCommand(b, BAKED_DISPATCH, 0, (w + p.workGroupSize[0] - 1) / p.workGroupSize[0], (h + p.workGroupSize[1] - 1) / p.workGroupSize[1], 0);
+		}
+		else if (p.layered) addBakedCommand(b, BAKED_LAYERS, 0, pl.order[i], (GLint)i, 0);
+		else
+		{
+			passActions& a = pl.actions[i];
+			if (!a.clearBuffers.empty() || (!a.invalidateBefore.empty() && m_hasInvalidate)) addBakedCommand(b, BAKED_LOAD, 0, (GLint)i, 0, 0);
+			addBakedCommand(b, BAKED_DRAW, 0, p.batchSize, 0, 0);
+			if (!a.invalidateAfter.empty() && m_hasInvalidate) addBakedCommand(b, BAKED_STORE, 0, (GLint)i, 0, 0);
+		}
+		for (size_t s = 0; m_hasInvalidate && s < pl.actions[i].invalidateInputs.size(); s++)
+		{
+			pass& reader = m_passes[pl.actions[i].invalidateInputs[s].first];
+			std::map<int, GLuint>::iterator t = reader.texInputs.find(pl.actions[i].invalidateInputs[s].second);
+			if (t != reader.texInputs.end() && t->second != 0) addBakedCommand(b, BAKED_INVALIDATE, t->second, 0, 0, 0);
+		}
+	}
+	if (pl.finalBarrier != 0) addBakedCommand(b, BAKED_BARRIER, 0, (GLint)pl.finalBarrier, 0, 0);
+
+	b.version = pipelineVersion(pl);
+	b.width = m_width;
+	b.height = m_height;
+}
+
+///
+/// \brief To render a pipeline by replaying its baked command list.
+/// To replay the baked command list of a pipeline through the state cache. Returns false, without rendering, if the list is 
+/// out of date, including when a pending shader of one of its passes is installed.
+///
+bool Compositor::replayPipeline(pipeline& pl)
+{
+	bakedList& b = pl.baked;
+	if (b.version != pipelineVersion(pl) || b.width != m_width || b.height != m_height) return false;
+	for (size_t i = 0; i < b.passes.size(); i++) updatePendingShader(m_passes[b.passes[i]]);
+	if (b.version != pipelineVersion(pl)) return false;
+	for (size_t i = 0; i < b.passes.size(); i++) m_passes[b.passes[i]].renderedFbo = 0;
+
+	pushState();
+	updateUniformBlocks();
+	if (!pl.transientTextures.empty()) applyTransients(pl);
+	setScissor(GL_FALSE, 0, 0, 0, 0);
+	setClearColor(0.0, 0.0, 0.0, 1.0);
+	setBlend(GL_FALSE);
+	setDepthMask(GL_FALSE);
+	bindVertexArray(m_vertexArray, m_vertexBuffer);
+	for (size_t i = 0; i < b.commands.size(); i++)
+	{
+		const bakedCommand& c = b.commands[i];
+		switch (c.op)
+		{
+		case BAKED_FRAMEBUFFER: bindFramebuffer(c.object); break;
+		case BAKED_PROGRAM: useProgram(c.object); break;
+		case BAKED_TEXTURES: bindTextures(c.args[0], c.args[1], &b.textures[c.args[2]], c.object); break;
+		case BAKED_DRAW_BUFFERS: glDrawBuffers(c.args[0], &b.drawBuffers[c.args[1]]); break;
+		case BAKED_VIEWPORT: setViewport(0, 0, c.args[0], c.args[1]); break;
+		case BAKED_UNIFORMS: flushUniforms(m_passes[c.args[0]], 0); break;
+		case BAKED_FUSED_UNIFORMS: flushFusedUniforms(pl.fused[c.args[0]]); break;
+		case BAKED_IMAGE: bindImageTexture(c.args[0], c.object, c.args[1], c.args[2]); break;
+		case BAKED_LOAD: loadOutputs(pl.actions[c.args[0]]); break;
+		case BAKED_STORE: storeOutputs(pl.actions[c.args[0]]); break;
+		case BAKED_INVALIDATE: glInvalidateTexImage(c.object, 0); break;
+		case BAKED_DRAW: if (c.args[0] > 0) glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, c.args[0]); else glDrawArrays(GL_TRIANGLE_STRIP, 0, 4); break;
+		case BAKED_LAYERS: drawLayers(m_passes[c.args[0]], pl.actions[c.args[1]]); break;
+		case BAKED_DISPATCH: glDispatchCompute(c.args[0], c.args[1], 1); break;
+		case BAKED_BARRIER: glMemoryBarrier((GLbitfield)c.args[0]); break;
+		}
+	}
+	for (size_t i = 0; i < b.versions.size(); i++) ++*b.versions[i];
+	pl.memo.lastRendered = b.rendered;
+	pl.memo.lastSkipped = 0;
+	pl.memo.totalRendered += b.rendered;
+	++pl.frameCount;
+	popState();
+	return true;
+}
+
+///
+/// \brief To add a command to a baked command list.
+/// To add a command to a baked command list.
+///
+void Compositor::addBakedCommand(bakedList& b, bakedOp op, GLuint object, GLint arg0, GLint arg1, GLint arg2)
+{
+	bakedCommand c;
+	c.op = op;
+	c.object = object;
+	c.args[0] = arg0;
+	c.args[1] = arg1;
+	c.args[2] = arg2;
+	b.commands.push_back(c);
+}
+
+///
+/// \brief To get the union of two rectangles.
+/// To get the bounding rectangle of two rectangles, ignoring empty ones.
+///
+Compositor::damageRect Compositor::unionRect(const damageRect& a, const damageRect& b)
+{
+	if (a.x0 >= a.x1 || a.y0 >= a.y1) return b;
+	if (b.x0 >= b.x1 || b.y0 >= b.y1) return a;
+	damageRect r = { std::min(a.x0, b.x0), std::min(a.y0, b.y0), std::max(a.x1, b.x1), std::max(a.y1, b.y1) };
+	return r;
+}
+
+///
+/// \brief To get the program of a fused pass.
+/// To get the program for a fused source from the cache, building it if needed, and map its uniforms and samplers 
+/// to the uniforms and inputs of the member passes. Returns false if the program does not compile.
+///
+bool Compositor::buildFusedPass(fusedPass& f, const std::string& source, const std::vector<std::string>& prefixes)
+{
+	std::map<std::string, fusedProgram>::iterator c = m_fusedPrograms.find(source);
+	if (c == m_fusedPrograms.end())
+	{
+		fusedProgram newProgram;
+		newProgram.fragmentShader = 0;
+		newProgram.program = buildProgram(source.c_str(), &newProgram.fragmentShader, false, false);
+		newProgram.failed = newProgram.program == 0;
+		m_lastError = Compositor::NONE;		//not an error of the main program, the passes are rendered unfused
+
+		if (!newProgram.failed)
+		{
+			GLint count = 0, maxLength = 0;
+			glGetProgramiv(newProgram.program, GL_ACTIVE_UNIFORMS, &count);
+			glGetProgramiv(newProgram.program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+			std::vector<GLchar> name(maxLength + 1);
+			for (GLint i = 0; i < count; i++)
+			{
+				uniform u; GLsizei length = 0;
+				glGetActiveUniform(newProgram.program, i, maxLength + 1, &length, &u.size, &u.type, &name[0]);
+				u.name = std::string(&name[0], length);
+				u.location = glGetUniformLocation(newProgram.program, &name[0]);
+				u.kind = UNIFORM_FLOAT;
+				u.components = 0;
+				u.valid = false;
+				if (u.location < 0) continue;
+				if (isSamplerType(u.type))
+				{
+					GLint unit = (GLint)newProgram.samplers.size();
+					uploadUniformValue(newProgram.program, u.location, UNIFORM_INT, 1, &unit);
+					newProgram.samplers.push_back(u.name);
+				}
+				else newProgram.uniforms.push_back(u);
+			}
+			bindUniformBlocks(newProgram.program);
+		}
+		c = m_fusedPrograms.insert(std::make_pair(source, newProgram)).first;
+	}
+	if (c->second.failed) return false;
+	f.program = &c->second;
+
+	//names in the fused program are the member names with the member prefix
+	std::map<std::string, std::pair<int, int>> uniformNames;
+	std::map<std::string, std::pair<int, int>> samplerNames;
+	for (size_t m = 0; m < f.members.size(); m++)
+	{
+		pass& p = m_passes[f.members[m]];
+		for (size_t h = 0; h < p.uniforms.size(); h++)
+			uniformNames[prefixes[m] + p.uniforms[h].name] = std::make_pair((int)m, (int)h);
+		std::map<int, GLuint>::iterator t;
+		for (t = p.texInputs.begin(); t != p.texInputs.end(); ++t)
+			samplerNames[prefixes[m] + m_samplerNames[t->first]] = std::make_pair((int)m, t->first);
+	}
+
+	f.uniformSources.clear();
+	for (size_t u = 0; u < c->second.uniforms.size(); u++)
+	{
+		std::map<std::string, std::pair<int, int>>::iterator n = uniformNames.find(c->second.uniforms[u].name);
+		f.uniformSources.push_back(n != uniformNames.end() ? n->second : std::make_pair(-1, -1));
+	}
+	f.samplerSources.clear();
+	for (size_t u = 0; u < c->second.samplers.size(); u++)
+	{
+		std::map<std::string, std::pair<int, int>>::iterator n = samplerNames.find(c->second.samplers[u]);
+		f.samplerSources.push_back(n != samplerNames.end() ? n->second : std::make_pair(-1, -1));
+	}
+
+	return true;
+}
+
+///
+/// \brief Render a fused pass.
+/// Render a chain of fused passes into the outputs of the last pass, taking inputs and uniform values from the member passes.
+///
+void Compositor::renderFusedInternal(fusedPass& f, passActions& actions)
+{
+	pass& target = m_passes[f.members.back()];
+	bindFramebuffer(target.fbo);
+
+	std::vector<GLuint> textures(f.samplerSources.size(), 0);
+	for (size_t i = 0; i < f.samplerSources.size(); i++)
+		if (f.samplerSources[i].first >= 0)
+			textures[i] = m_passes[f.members[f.samplerSources[i].first]].texInputs[f.samplerSources[i].second];
+	bindTextures(textures, 0);
+
+	GLsizei w, h;
+	getPassSize(target, w, h);
+	glDrawBuffers(target.drawBufferCount, target.texOutputsChannels);
+	setViewport(0, 0, w, h);
+	setClearColor(0.0, 0.0, 0.0, 1.0);
+	setBlend(GL_FALSE);
+	useProgram(f.program->program);
+	flushFusedUniforms(f);
+
+	bindVertexArray(m_vertexArray, m_vertexBuffer);
+	loadOutputs(actions);
+	setDepthMask(GL_FALSE);
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	storeOutputs(actions);
 }
+
 ///
-/// \brief To verify whether a set of passes are usable.
-/// To verify whether a set of passes are usable.
+/// \brief To upload the uniforms of the members of a fused pass.
+/// To upload to the fused program, which must be in use, the values of the member uniforms which differ from what it has.
 ///
-bool Compositor::verifyPipeline(std::vector<int> pipeline)
+void Compositor::flushFusedUniforms(fusedPass& f)
 {
-	for (int i = 0; i < pipeline.size(); i++)
+	for (size_t i = 0; i < f.uniformSources.size(); i++)
+	{
+		if (f.uniformSources[i].first < 0) continue;
+		uniform& src = m_passes[f.members[f.uniformSources[i].first]].uniforms[f.uniformSources[i].second];
+		uniform& dst = f.program->uniforms[i];
+		if (!src.valid) continue;
+		if (dst.valid && dst.kind == src.kind && dst.components == src.components && memcmp(dst.value, src.value, src.components * sizeof(GLuint)) == 0) continue;
+		memcpy(dst.value, src.value, sizeof(dst.value));
+		dst.kind = src.kind;
+		dst.components = src.components;
+		dst.valid = true;
+		uploadUniformValue(0, dst.location, dst.kind, dst.components, dst.value);
+	}
+}
+
+///
+/// \brief To check whether a uniform type is a sampler.
+/// To check whether a uniform type reported by glGetActiveUniform is a sampler.
+///
+bool Compositor::isSamplerType(GLenum type)
+{
+	switch (type)
+	{
+	case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+	case GL_SAMPLER_1D_SHADOW: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+	case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_1D_ARRAY_SHADOW: case GL_SAMPLER_2D_ARRAY_SHADOW:
+	case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_2D_MULTISAMPLE_ARRAY: case GL_SAMPLER_BUFFER: case GL_SAMPLER_2D_RECT:
+	case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_3D: case GL_INT_SAMPLER_2D_ARRAY: case GL_INT_SAMPLER_BUFFER:
+	case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_3D: case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+		return true;
+	default:
+		return false;
+	}
+}
+
+///
+/// \brief To check whether a uniform type is an image.
+/// To check whether a uniform type reported by glGetActiveUniform is an image.
+///
+bool Compositor::isImageType(GLenum type)
+{
+	switch (type)
+	{
+	case GL_IMAGE_1D: case GL_IMAGE_2D: case GL_IMAGE_3D: case GL_IMAGE_2D_RECT: case GL_IMAGE_CUBE: case GL_IMAGE_BUFFER:
+	case GL_IMAGE_1D_ARRAY: case GL_IMAGE_2D_ARRAY: case GL_IMAGE_2D_MULTISAMPLE: case GL_IMAGE_2D_MULTISAMPLE_ARRAY:
+	case GL_INT_IMAGE_2D: case GL_INT_IMAGE_3D: case GL_INT_IMAGE_2D_ARRAY: case GL_INT_IMAGE_BUFFER:
+	case GL_UNSIGNED_INT_IMAGE_2D: case GL_UNSIGNED_INT_IMAGE_3D: case GL_UNSIGNED_INT_IMAGE_2D_ARRAY: case GL_UNSIGNED_INT_IMAGE_BUFFER:
+		return true;
+	default:
+		return false;
+	}
+}
+
+///
+/// \brief To split shader source into preprocessor directives and tokens.
+/// To split shader source into preprocessor directives and tokens, dropping comments and whitespace. Used for fusing shaders.
+///
+bool Compositor::tokenizeShader(const std::string& source, std::vector<std::string>& directives, std::vector<std::string>& tokens)
+{
+	static const char* operators[] = { "<<=", ">>=", "++", "--", "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "==", "!=", "<=", ">=", "&&", "||", "^^", "<<", ">>" };
+	size_t i = 0, n = source.size();
+	bool lineStart = true;
+	while (i < n)
+	{
+		char c = source[i];
+		if (c == '\n') { lineStart = true; i++; }
+		else if (isspace((unsigned char)c)) i++;
+		else if (source.compare(i, 2, "//") == 0) { while (i < n && source[i] != '\n') i++; }
+		else if (source.compare(i, 2, "/*") == 0)
+		{
+			size_t e = source.find("*/", i + 2);
+			if (e == std::string::npos) return false;
+			i = e + 2;
+		}
+		else if (c == '#' && lineStart)
+		{
+			size_t e = source.find('\n', i);
+			if (e == std::string::npos) e = n;
+			directives.push_back(source.substr(i, e - i));
+			i = e;
+		}
+		else
+		{
+			lineStart = false;
+			size_t start = i;
+			if (isalpha((unsigned char)c) || c == '_')
+			{
+				while (i < n && (isalnum((unsigned char)source[i]) || source[i] == '_')) i++;
+			}
+			else if (isdigit((unsigned char)c) || (c == '.' && i + 1 < n && isdigit((unsigned char)source[i + 1])))
+			{
+				while (i < n && (isalnum((unsigned char)source[i]) || source[i] == '.' || 
+					((source[i] == '+' || source[i] == '-') && (source[i - 1] == 'e' || source[i - 1] == 'E')))) i++;
+			}
+			else
+			{
+				i++;
+				for (size_t o = 0; o < sizeof(operators) / sizeof(operators[0]); o++)
+				{
+					size_t length = strlen(operators[o]);
+					if (source.compare(start, length, operators[o]) == 0) { i = start + length; break; }
+				}
+			}
+			tokens.push_back(source.substr(start, i - start));
+		}
+	}
+	return true;
+}
+
+///
+/// \brief To split shader tokens into global declarations.
+/// To split shader tokens into global declarations : a function definition ending with '}', or any other declaration ending with ';'.
+///
+void Compositor::splitShaderItems(const std::vector<std::string>& tokens, std::vector<std::pair<size_t, size_t>>& items)
+{
+	int depth = 0;
+	bool functionBody = false;
+	size_t start = 0;
+	for (size_t k = 0; k < tokens.size(); k++)
+	{
+		if (tokens[k] == "{")
+		{
+			if (depth == 0) functionBody = k > start && tokens[k - 1] == ")";
+			depth++;
+		}
+		else if (tokens[k] == "}")
+		{
+			depth--;
+			if (depth == 0 && functionBody) { items.push_back(std::make_pair(start, k + 1)); start = k + 1; }
+		}
+		else if (tokens[k] == ";" && depth == 0) { items.push_back(std::make_pair(start, k + 1)); start = k + 1; }
+	}
+	if (start < tokens.size()) items.push_back(std::make_pair(start, tokens.size()));
+}
+
+///
+/// \brief To get the names declared by a global declaration.
+/// To get the names declared by a global declaration of a shader : the function name, or the variable names.
+///
+void Compositor::shaderItemNames(const std::vector<std::string>& tokens, size_t first, size_t last, std::vector<std::string>& names, bool& isFunction)
+{
+	isFunction = false;
+	int depth = 0;
+	bool inInitializer = false;
+	for (size_t k = first; k < last; k++)
+	{
+		const std::string& t = tokens[k];
+		if (t == "{") break;
+		if (t == "(" || t == "[")
+		{
+			if (depth == 0 && t == "(" && !inInitializer && k > first && tokens[k - 1] != "layout" && 
+				(isalpha((unsigned char)tokens[k - 1][0]) || tokens[k - 1][0] == '_'))
+			{
+				isFunction = true;
+				names.push_back(tokens[k - 1]);
+				return;
+			}
+			depth++;
+		}
+		else if (t == ")" || t == "]") depth--;
+		else if (depth > 0) continue;
+		else if (t == "=") inInitializer = true;
+		else if (t == ",") inInitializer = false;
+		else if (!inInitializer && (isalpha((unsigned char)t[0]) || t[0] == '_') && k + 1 < last)
+		{
+			const std::string& next = tokens[k + 1];
+			if (next == ";" || next == "=" || next == "[" || next == ",") names.push_back(t);
+		}
+	}
+}
+
+///
+/// \brief To join shader tokens back into source.
+/// To join shader tokens back into source.
+///
+std::string Compositor::joinShaderTokens(const std::vector<std::string>& tokens)
+{
+	std::string source;
+	for (size_t k = 0; k < tokens.size(); k++)
+	{
+		source += tokens[k];
+		source += (tokens[k] == ";" || tokens[k] == "{" || tokens[k] == "}") ? "\n" : " ";
+	}
+	return source;
+}
+
+///
+/// \brief To fuse a producer fragment shader into its consumer.
+/// To generate one fragment shader from a producer and a consumer which reads the producer output through a sampler at in_uv. 
+/// Global symbols of the producer are renamed with the prefix, its main() becomes a function, its output becomes a global variable, 
+/// and each texture(sampler, in_uv) in the consumer is replaced by a call evaluating the producer. 
+/// Returns false if the shaders use something which cannot be fused safely (macros, structs, blocks, discard, other fetches of the sampler).
+///
+bool Compositor::fuseShaderSources(const std::string& producer, const std::string& consumer, const std::string& sampler, const std::string& prefix, std::string& fused)
+{
+	std::vector<std::string> pDirectives, pTokens, cDirectives, cTokens;
+	if (!tokenizeShader(producer, pDirectives, pTokens) || !tokenizeShader(consumer, cDirectives, cTokens)) return false;
+
+	//only #version and #extension are allowed, macros could hide symbols from renaming
+	std::string versions[2], extensions;
+	std::vector<std::string>* directives[2] = { &pDirectives, &cDirectives };
+	for (int d = 0; d < 2; d++)
+	{
+		for (size_t k = 0; k < directives[d]->size(); k++)
+		{
+			const std::string& line = (*directives[d])[k];
+			size_t w = line.find_first_not_of(" \t", 1);
+			if (w != std::string::npos && line.compare(w, 7, "version") == 0) versions[d] = line;
+			else if (w != std::string::npos && line.compare(w, 9, "extension") == 0) { if (extensions.find(line) == std::string::npos) extensions += line + "\n"; }
+			else return false;
+		}
+	}
+	if (versions[0] != versions[1]) return false;
+
+	//producer : collect global names, drop the in_uv declaration, turn the output into a global variable
+	std::vector<std::pair<size_t, size_t>> pItems, cItems;
+	splitShaderItems(pTokens, pItems);
+	splitShaderItems(cTokens, cItems);
+
+	std::set<std::string> globals;
+	std::string output;
+	std::vector<int> itemOutput(pItems.size(), 0);		//0 is kept, 1 is dropped, 2 is the output declaration
+	for (size_t i = 0; i < pItems.size(); i++)
+	{
+		size_t a = pItems[i].first, b = pItems[i].second;
+		if (pTokens[a] == "precision") continue;
+
+		std::vector<std::string> names; bool isFunction;
+		shaderItemNames(pTokens, a, b, names, isFunction);
+		bool isIn = false, isOut = false;
+		for (size_t k = a; k < b; k++)
+		{
+			if (pTokens[k] == "struct" || pTokens[k] == "discard") return false;
+			if (isFunction) continue;
+			if (pTokens[k] == "{") return false;		//uniform or buffer block
+			if (pTokens[k] == "in") isIn = true;
+			if (pTokens[k] == "out") isOut = true;
+		}
+		if (isIn)
+		{
+			if (names.size() != 1 || names[0] != "in_uv") return false;
+			itemOutput[i] = 1;
+			continue;
+		}
+		if (isOut)
+		{
+			if (!output.empty() || names.size() != 1 || b < a + 3 || pTokens[b - 3] != "vec4") return false;
+			output = names[0];
+			itemOutput[i] = 2;
+		}
+		for (size_t n = 0; n < names.size(); n++)
+			if (names[n].compare(0, 3, "gl_") != 0) globals.insert(names[n]);
+	}
+	if (output.empty() || globals.count("main") == 0) return false;
+
+	std::string code = "in vec2 in_uv;\n";
+	for (size_t i = 0; i < pItems.size(); i++)
+	{
+		if (itemOutput[i] == 1) continue;
+		if (itemOutput[i] == 2) { code += "vec4 " + prefix + output + ";\n"; continue; }
+		std::vector<std::string> renamed;
+		for (size_t k = pItems[i].first; k < pItems[i].second; k++)
+		{
+			bool member = k > 0 && pTokens[k - 1] == ".";
+			renamed.push_back((!member && globals.count(pTokens[k]) != 0) ? prefix + pTokens[k] : pTokens[k]);
+		}
+		code += joinShaderTokens(renamed);
+	}
+	code += "vec4 " + prefix + "eval()\n{\n" + prefix + "main();\nreturn " + prefix + output + ";\n}\n";
+
+	//consumer : drop the sampler and in_uv declarations, replace the fetches with the producer evaluation
+	bool replaced = false;
+	for (size_t i = 0; i < cItems.size(); i++)
+	{
+		size_t a = cItems[i].first, b = cItems[i].second;
+		std::vector<std::string> names; bool isFunction;
+		shaderItemNames(cTokens, a, b, names, isFunction);
+		if (!isFunction && std::find(names.begin(), names.end(), sampler) != names.end())
+		{
+			if (names.size() != 1) return false;
+			continue;
+		}
+		if (!isFunction && names.size() == 1 && names[0] == "in_uv") continue;
+
+		std::vector<std::string> rewritten;
+		for (size_t k = a; k < b; k++)
+		{
+			if ((cTokens[k] == "texture" || cTokens[k] == "texture2D") && k + 5 < b && cTokens[k + 1] == "(" && cTokens[k + 2] == sampler && 
+				cTokens[k + 3] == "," && cTokens[k + 4] == "in_uv" && cTokens[k + 5] == ")")
+			{
+				rewritten.push_back(prefix + "eval");
+				rewritten.push_back("(");
+				rewritten.push_back(")");
+				k += 5;
+				replaced = true;
+				continue;
+			}
+			if (cTokens[k] == sampler && (k == 0 || cTokens[k - 1] != ".")) return false;
+			rewritten.push_back(cTokens[k]);
+		}
+		code += joinShaderTokens(rewritten);
+	}
+	if (!replaced) return false;
+
+	fused = (versions[0].empty() ? std::string() : versions[0] + "\n") + extensions + code;
+	return true;
+}
+
+///
+/// \brief To start measuring a rendering of a pipeline.
+/// To read the available results of the previous frames and issue the first timestamp of a new frame. 
+/// Returns nullptr if all frames of the ring are still waiting for results.
+///
+Compositor::timingFrame* Compositor::beginTiming(pipeline& pl)
+{
+	collectTimings(pl);
+	if (pl.timingFrames.empty())
+	{
+		pl.timingFrames.resize(TIMING_FRAMES);
+		pl.timingNext = 0;
+		for (int i = 0; i < TIMING_FRAMES; i++)
+			pl.timingFrames[i].pending = false;
+	}
+
+	timingFrame& frame = pl.timingFrames[pl.timingNext];
+	if (frame.pending) return nullptr;
+	pl.timingNext = (pl.timingNext + 1) % TIMING_FRAMES;
+
+	frame.passes.clear();
+	if (frame.queries.empty())
+	{
+		frame.queries.push_back(0);
+		glGenQueries(1, &frame.queries[0]);
+	}
+	glQueryCounter(frame.queries[0], GL_TIMESTAMP);
+	return &frame;
+}
+
+///
+/// \brief To issue the timestamp after a pass.
+/// To issue the timestamp after a pass.
+///
+void Compositor::recordTiming(timingFrame& frame, int passID)
+{
+	size_t index = frame.passes.size() + 1;
+	if (frame.queries.size() <= index)
+	{
+		frame.queries.push_back(0);
+		glGenQueries(1, &frame.queries[index]);
+	}
+	glQueryCounter(frame.queries[index], GL_TIMESTAMP);
+	frame.passes.push_back(passID);
+}
+
+///
+/// \brief To read the timer queries which are available.
+/// To read the timer queries of the frames whose last timestamp is available, oldest first, without waiting for the GPU.
+///
+void Compositor::collectTimings(pipeline& pl)
+{
+	for (int i = 0; i < (int)pl.timingFrames.size(); i++)
+	{
+		timingFrame& frame = pl.timingFrames[(pl.timingNext + i) % pl.timingFrames.size()];
+		if (!frame.pending) continue;
+
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(frame.queries[frame.passes.size()], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE) break;	//later frames are not available either
+
+		std::vector<GLuint64> timestamps(frame.passes.size() + 1);
+		for (size_t q = 0; q < timestamps.size(); q++)
+			glGetQueryObjectui64v(frame.queries[q], GL_QUERY_RESULT, &timestamps[q]);
+		for (size_t q = 0; q < frame.passes.size(); q++)
+			addTiming(pl.timingPasses[frame.passes[q]], (timestamps[q + 1] - timestamps[q]) / 1000000.0);
+		addTiming(pl.timingTotal, (timestamps.back() - timestamps[0]) / 1000000.0);
+		frame.pending = false;
+	}
+}
+
+///
+/// \brief To delete the timer queries of a pipeline.
+/// To delete the timer queries of a pipeline, dropping the results not read yet.
+///
+void Compositor::deleteTimings(pipeline& pl)
+{
+	for (size_t i = 0; i < pl.timingFrames.size(); i++)
+		if (!pl.timingFrames[i].queries.empty())
+			glDeleteQueries((GLsizei)pl.timingFrames[i].queries.size(), &pl.timingFrames[i].queries[0]);
+	pl.timingFrames.clear();
+	pl.timingNext = 0;
+}
+
+///
+/// \brief To add a duration to a timing history.
+/// To add a duration to a timing history, replacing the oldest one when the window is full.
+///
+void Compositor::addTiming(timingHistory& history, double milliseconds)
+{
+	if (history.samples.size() < TIMING_WINDOW) history.samples.push_back(milliseconds);
+	else
+	{
+		history.samples[history.next] = milliseconds;
+		history.next = (history.next + 1) % TIMING_WINDOW;
+	}
+	history.last = milliseconds;
+}
+
+///
+/// \brief To compute min/avg/max of a timing history.
+/// To compute min/avg/max of a timing history.
+///
+Compositor::gpuTime Compositor::getTiming(const timingHistory& history)
+{
+	gpuTime time;
+	time.samples = (unsigned int)history.samples.size();
+	time.last = time.min = time.avg = time.max = 0.0;
+	if (time.samples == 0) return time;
+
+	time.last = history.last;
+	time.min = time.max = history.samples[0];
+	for (size_t i = 0; i < history.samples.size(); i++)
+	{
+		time.min = std::min(time.min, history.samples[i]);
+		time.max = std::max(time.max, history.samples[i]);
+		time.avg += history.samples[i];
+	}
+	time.avg /= time.samples;
+	return time;
+}
+
+///
+/// \brief To update the draw buffers of a pass.
+/// To update the draw buffers of a pass from its outputs, so output location i of the shader writes to color attachment i.
+///
+void Compositor::updateDrawBuffers(pass& p)
+{
+	p.drawBufferCount = 0;
+	for (int i = 0; i < MAX_OUTPUT_CHANNELS; i++)
 	{
-		std::map<int, pass>::iterator p = m_passes.find(pipeline[i]);
-		if (p == m_passes.end()) return false;
-		else if (p->second.initialized == false) return false;
-		else if (p->second.texOutputs.size() == 0) return false;
+		bool used = p.texOutputs.find(i) != p.texOutputs.end();
+		p.texOutputsChannels[i] = used ? GL_COLOR_ATTACHMENT0 + i : GL_NONE;
+		if (used) p.drawBufferCount = i + 1;
 	}
+}
+
+///
+/// \brief To intern a sampler name.
+/// To get the ID of a sampler name, adding it to the table of sampler names if needed. 
+/// Passes refer to samplers by this ID, so the caller strings do not need to stay alive and equal names are the same sampler.
+///
+int Compositor::internSampler(const std::string& name)
+{
+	std::map<std::string, int>::iterator id = m_samplerIDs.find(name);
+	if (id != m_samplerIDs.end()) return id->second;
+
+	m_samplerNames.push_back(name);
+	m_samplerIDs[name] = (int)m_samplerNames.size() - 1;
+	return (int)m_samplerNames.size() - 1;
+}
+
+///
+/// \brief To set the texture of a sampler of a pass.
+/// To set the texture of a sampler of a pass, and of the texture unit of that sampler.
+///
+void Compositor::setInputTexture(pass& p, int sampler, GLuint texID)
+{
+	p.texInputs[sampler] = texID;
+	for (size_t unit = 0; unit < p.unitSamplers.size(); unit++)
+		if (p.unitSamplers[unit] == sampler) p.unitTextures[unit] = texID;
+}
+
+///
+/// \brief To bind the uniform blocks of a program to the shared uniform blocks.
+/// To set the binding point of each uniform block of a program which has the name of a shared uniform block, 
+/// growing the shared block to the size the program declares.
+///
+void Compositor::bindUniformBlocks(GLuint program)
+{
+	if (m_uniformBlocks.size() == 0) return;
+
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+	std::vector<GLchar> name(maxLength + 1);
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		glGetActiveUniformBlockName(program, i, maxLength + 1, &length, &name[0]);
+		std::map<std::string, int>::iterator id = m_uniformBlockIDs.find(std::string(&name[0], length));
+		if (id == m_uniformBlockIDs.end()) continue;
+
+		uniformBlock& b = m_uniformBlocks[id->second];
+		GLint dataSize = 0;
+		glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+		if ((size_t)dataSize > b.data.size())
+		{
+			b.data.resize(dataSize, 0);
+			b.dirty = true;
+		}
+		glUniformBlockBinding(program, i, b.binding);
+	}
+}
+
+///
+/// \brief To copy the changed uniform blocks to the GPU.
+/// To copy the uniform blocks which changed into the ring buffer and bind their range through the state cache. The ring buffer has one segment 
+/// per frame in flight; when a segment is full, a fence is placed for it and the next segment is used once the GPU is done with it, and all 
+/// blocks are copied there, so a block in use is never overwritten.
+///
+void Compositor::updateUniformBlocks()
+{
+	if (m_uniformBlocks.size() == 0) return;
+
+	GLsizeiptr needed = 0, total = 0;
+	for (size_t i = 0; i < m_uniformBlocks.slotCount(); i++)
+	{
+		uniformBlock* b = m_uniformBlocks.at(i);
+		if (b == nullptr) continue;
+		GLsizeiptr aligned = ((GLsizeiptr)b->data.size() + m_uniformBufferAlignment - 1) / m_uniformBufferAlignment * m_uniformBufferAlignment;
+		total += aligned;
+		if (b->dirty) needed += aligned;
+	}
+
+	bool newSegment = false;
+	if (needed > 0 && m_uniformRingSegmentSize < total * 4)
+	{
+		if (!allocateUniformRing(std::max((GLsizeiptr)UNIFORM_RING_MIN_SEGMENT, total * 4))) return;
+		newSegment = true;
+	}
+	else if (needed > 0 && m_uniformRingOffset + needed > m_uniformRingSegmentSize)
+	{
+		m_uniformRingFences[m_uniformRingSegment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_uniformRingSegment = (m_uniformRingSegment + 1) % UNIFORM_RING_SEGMENTS;
+		m_uniformRingOffset = 0;
+		GLsync& fence = m_uniformRingFences[m_uniformRingSegment];
+		if (fence != 0)
+		{
+			//waits only if the GPU is UNIFORM_RING_SEGMENTS segments behind
+			while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+			glDeleteSync(fence);
+			fence = 0;
+		}
+		newSegment = true;
+	}
+
+	if (needed > 0 && m_uniformRingMapped == nullptr) bindUniformBuffer(m_uniformRing);
+	for (size_t i = 0; i < m_uniformBlocks.slotCount(); i++)
+	{
+		uniformBlock* b = m_uniformBlocks.at(i);
+		if (b == nullptr || b->data.empty()) continue;
+
+		if (b->dirty || newSegment)
+		{
+			GLintptr offset = m_uniformRingSegment * m_uniformRingSegmentSize + m_uniformRingOffset;
+			if (m_uniformRingMapped != nullptr) memcpy(m_uniformRingMapped + offset, &b->data[0], b->data.size());
+			else glBufferSubData(GL_UNIFORM_BUFFER, offset, b->data.size(), &b->data[0]);
+			b->offset = offset;
+			b->dirty = false;
+			m_uniformRingOffset += ((GLsizeiptr)b->data.size() + m_uniformBufferAlignment - 1) / m_uniformBufferAlignment * m_uniformBufferAlignment;
+		}
+		//the main program may have bound something else there since the last rendering
+		bindUniformRange(b->binding, m_uniformRing, b->offset, b->data.size());
+	}
+}
+
+///
+/// \brief To create the uniform block ring buffer.
+/// To create the uniform block ring buffer with the given segment size, persistently mapped when buffer storage is available. 
+/// The previous ring buffer is deleted, OpenGL keeps it alive until the GPU is done with it.
+///
+bool Compositor::allocateUniformRing(GLsizeiptr segmentSize)
+{
+	deleteUniformRing();
 
+	GLint previousBuffer = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_BINDING, &previousBuffer);
+	glGenBuffers(1, &m_uniformRing);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_uniformRing);
+	if (m_hasBufferStorage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_UNIFORM_BUFFER, segmentSize * UNIFORM_RING_SEGMENTS, NULL, flags);
+		m_uniformRingMapped = (char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, segmentSize * UNIFORM_RING_SEGMENTS, flags);
+	}
+	else glBufferData(GL_UNIFORM_BUFFER, segmentSize * UNIFORM_RING_SEGMENTS, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, previousBuffer);
+
+	if (m_hasBufferStorage && m_uniformRingMapped == nullptr) { deleteUniformRing(); return false; }
+	m_uniformRingSegmentSize = segmentSize;
+	m_uniformRingSegment = 0;
+	m_uniformRingOffset = 0;
 	return true;
-}
\ No newline at end of file
+}
+
+///
+/// \brief To delete the uniform block ring buffer.
+/// To delete the uniform block ring buffer and its fences.
+///
+void Compositor::deleteUniformRing()
+{
+	for (int i = 0; i < UNIFORM_RING_SEGMENTS; i++)
+	{
+		if (m_uniformRingFences[i] != 0) glDeleteSync(m_uniformRingFences[i]);
+		m_uniformRingFences[i] = 0;
+	}
+	if (m_uniformRing != 0)
+	{
+		if (m_uniformRingMapped != nullptr)
+		{
+			GLint previousBuffer = 0;
+			glGetIntegerv(GL_UNIFORM_BUFFER_BINDING, &previousBuffer);
+			glBindBuffer(GL_UNIFORM_BUFFER, m_uniformRing);
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+			glBindBuffer(GL_UNIFORM_BUFFER, previousBuffer);
+		}
+		glDeleteBuffers(1, &m_uniformRing);
+
+		//deleting a bound buffer binds 0 in its place
+		if ((m_cache.valid & CACHED_UNIFORM_BUFFER) && m_cache.uniformBuffer == m_uniformRing) m_cache.uniformBuffer = 0;
+		std::map<GLuint, bufferRange>::iterator c;
+		for (c = m_cache.uniformRanges.begin(); c != m_cache.uniformRanges.end(); ++c)
+			if (c->second.buffer == m_uniformRing) { c->second.buffer = 0; c->second.offset = 0; c->second.size = 0; }
+	}
+	m_uniformRing = 0;
+	m_uniformRingMapped = nullptr;
+	m_uniformRingSegmentSize = 0;
+}
@@ -2,14 +2,31 @@
 
 #ifdef _WIN32
 #include "GL\glew.h"
+#elif defined(COMPOSITOR_INCLUDE_GL)	//defined by the CMake build, otherwise OpenGL headers must be included before this file
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
 #endif
 
 #include <map>
+#include <set>
 #include <vector>
+#include <algorithm>
 
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <cstring>
+#include <cctype>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <iterator>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 class Compositor{
 public:
@@ -20,34 +37,629 @@ public:
 		PASS_NOT_FOUND					= 0x00000100,
 		PASS_PROGRAM_NOT_INITIALIZED	= 0x00000101,
 		PASS_OUTPUT_NOT_FOUND			= 0x00000102,
+		PASS_COMPUTE_NOT_SUPPORTED		= 0x00000103,
+		PASS_WRONG_KIND					= 0x00000104,
+		PASS_LIMIT_REACHED				= 0x00000105,
 		PIPELINE_NOT_FOUND				= 0x00000200,
 		PIPELINE_NOT_COMPLETE			= 0x00000201,
+		PIPELINE_CYCLE					= 0x00000202,
+		PIPELINE_OUTPUT_CONFLICT		= 0x00000203,
+		PIPELINE_NOT_GRAPH				= 0x00000204,
+		PIPELINE_FRAME_BUSY				= 0x00000205,
+		PIPELINE_FRAME_NOT_READY		= 0x00000206,
 		SHADER_FILE_NOT_FOUND			= 0x00000300,
 		SHADER_COMPILE_FAIL				= 0x00000301,
 		SHADER_LINKING_FAIL				= 0x00000302,
+		PROGRAM_BINARY_NOT_SUPPORTED	= 0x00000303,
 		TEXTURE_UNIFORM_NOT_FOUND		= 0x00000400,
-		TEXTURE_OUTPUT_NOT_FOUND		= 0x00000401
+		TEXTURE_OUTPUT_NOT_FOUND		= 0x00000401,
+		TRANSIENT_NOT_FOUND				= 0x00000402,
+		TRANSIENT_OUTSIDE_PIPELINE		= 0x00000403,
+		UNIFORM_NOT_FOUND				= 0x00000500,
+		UNIFORM_BLOCK_NOT_FOUND			= 0x00000501,
+		UNIFORM_BLOCK_EXISTS			= 0x00000502,
+		UNIFORM_BLOCK_OUT_OF_RANGE		= 0x00000503,
+		UNIFORM_BLOCK_NO_BINDING		= 0x00000504,
+		READBACK_NOT_FOUND				= 0x00000600,
+		READBACK_RING_FULL				= 0x00000601,
+		READBACK_NOT_READY				= 0x00000602,
+		STREAM_NOT_FOUND				= 0x00000700,
+		STREAM_BUSY						= 0x00000701,
+		STREAM_FILE_NOT_FOUND			= 0x00000702,
+		STREAM_OUT_OF_RANGE				= 0x00000703,
+		STREAM_MAP_FAILED				= 0x00000704,
+		RESOURCE_THREAD_FAILED			= 0x00000800
+	};
+
+	//Contains memory usage of the transient texture pool
+	struct poolStats{
+		unsigned int transientCount;		//transient textures declared
+		unsigned int textureCount;			//textures in the pool
+		unsigned long long naiveBytes;		//memory if every transient texture had its own texture
+		unsigned long long peakBytes;		//memory of the textures in the pool
+	};
+
+	//Contains counters of the program binary cache
+	struct programCacheStats{
+		unsigned int hits;				//programs loaded from a cached binary
+		unsigned int misses;			//programs compiled from source
+		unsigned int rejected;			//cached binaries rejected by the driver or unreadable, counted in misses too
+		double secondsCompiling;		//time spent compiling and linking programs from source
+		double secondsSaved;			//compile time recorded with the loaded binaries, minus the time spent loading them
+	};
+
+	//Contains GPU time of a pass or pipeline over the last frames, in milliseconds
+	struct gpuTime{
+		double last;
+		double min;
+		double avg;
+		double max;
+		unsigned int samples;		//frames measured in the window, 0 if no result is available yet
+	};
+
+	//Contains counters of passes skipped by a pipeline because their inputs did not change
+	struct memoStats{
+		unsigned int lastRendered;			//passes rendered by the last rendering, a chain of fused passes counts as one
+		unsigned int lastSkipped;			//passes skipped by the last rendering
+		unsigned long long totalRendered;
+		unsigned long long totalSkipped;
+	};
+
+	//Contains upload counters of a stream texture
+	struct streamStats{
+		unsigned long long frames;			//frames uploaded
+		unsigned long long droppedFrames;	//writes refused because the GPU was still reading all pixel buffers, or lost because mapping failed
+		unsigned long long bytes;			//bytes uploaded
+		double copySeconds;					//time spent copying frames given to uploadStreamFrame() or uploadStreamFileFrame()
+		double copyBandwidth;				//bytes per second while copying
+		double uploadBandwidth;				//bytes per second from the first to the last frame uploaded
+	};
+
+	//State of an asynchronous readback
+	enum readbackState{
+		READBACK_NONE,			//unknown or released Readback ID
+		READBACK_PENDING,		//the GPU has not copied the pixels yet
+		READBACK_READY			//the pixels can be mapped without waiting
+	};
+
+	//Called by Compositor::updateReadbacks() with the mapped pixels of a finished readback, which is released when it returns
+	typedef void (*readbackCallback)(int readbackID, const void* data, int size, void* userData);
+
+	//Called on the resource thread with true when it starts, to make the context sharing objects with the main context current, 
+	//and with false before it exits, to release it. Returns false if the context cannot be made current.
+	typedef bool (*resourceContextCallback)(bool makeCurrent, void* userData);
+
+	//Called by Compositor::updateResourceJobs() once a job of the resource thread is published, object is the program or texture (0 if it failed)
+	typedef void (*resourceCallback)(int jobID, GLuint object, bool succeeded, void* userData);
+
+	//Loading state of the shader of a pass
+	enum passState
+	{
+		PASS_EMPTY		= 0,	//no shader loaded
+		PASS_PENDING	= 1,	//a shader is compiling, the previous shader (if any) is still rendered
+		PASS_READY		= 2,	//the shader is loaded
+		PASS_FAILED		= 3		//the last shader loaded asynchronously did not compile or link, the previous shader (if any) is still rendered
+	};
+
+	//Kind of shader submitted with Compositor::submitShaderSource(), which must match the pass receiving it
+	enum shaderKind
+	{
+		SHADER_FRAGMENT	= 0,	//fragment shader of a pass created with Compositor::createNewPass()
+		SHADER_COMPUTE	= 1,	//compute shader of a pass created with Compositor::createComputePass()
+		SHADER_BATCH	= 2		//fragment shader of a pass created with Compositor::createBatchPass()
+	};
+
+	//What is done with the previous content of an output before a pass renders, see Compositor::setOutputLoadAction()
+	enum loadAction
+	{
+		LOAD_ACTION_DEFAULT		= 0,	//LOAD_ACTION_CLEAR if the shader contains discard, otherwise LOAD_ACTION_DONT_CARE
+		LOAD_ACTION_CLEAR		= 1,	//cleared to (0, 0, 0, 1)
+		LOAD_ACTION_DONT_CARE	= 2,	//invalidated, the shader writes every pixel
+		LOAD_ACTION_LOAD		= 3		//kept where the shader does not write
+	};
+
+	//What is done with an output after a pass renders, see Compositor::setOutputStoreAction()
+	enum storeAction
+	{
+		STORE_ACTION_DEFAULT	= 0,	//STORE_ACTION_DISCARD for outputs nothing reads in a pipeline, otherwise STORE_ACTION_STORE
+		STORE_ACTION_STORE		= 1,	//kept for the passes and main program reading it
+		STORE_ACTION_DISCARD	= 2		//invalidated, nothing reads it
+	};
+
+	static const int MAX_LAYER_TEXTURES = 16;	//textures a layer pass can sample, see Compositor::setLayerTexture()
+
+	//How a layer is blended with the layers below it, see Compositor::setLayers()
+	enum blendMode
+	{
+		BLEND_NORMAL	= 0,	//drawn over the layers below
+		BLEND_ADD		= 1,	//added to the layers below
+		BLEND_MULTIPLY	= 2,	//multiplies the layers below
+		BLEND_SCREEN	= 3		//inverse of multiplying the inverses, brightens the layers below
+	};
+
+	//Contains a layer of a layer pass, see Compositor::setLayers()
+	struct layer{
+		float rect[4];			//x, y, width and height in the outputs, from 0 to 1 with the origin at the bottom left
+		float uvTransform[4];	//scale (u, v) then offset (u, v) of the texture coordinates, which go from 0 to 1 over the rectangle
+		float opacity;
+		int texture;			//index of the layer texture, see Compositor::setLayerTexture()
+		blendMode blend;
+		int depth;				//layers are drawn by increasing depth, layers of the same depth in any order
+	};
+
+	//What renderPass() and renderPipeline() do with a pass whose first shader is still compiling
+	enum pendingPolicy
+	{
+		PENDING_FAIL		= 0,	//fail with PASS_PROGRAM_NOT_INITIALIZED or PIPELINE_NOT_COMPLETE
+		PENDING_SKIP		= 1,	//do not render the pass, its outputs keep their content
+		PENDING_PASSTHROUGH	= 2		//copy the input texture to the outputs if the pass has exactly one input, otherwise clear the outputs
+	};
+
+	//How OpenGL states of the main program are saved and restored around rendering
+	enum stateMode
+	{
+		STATE_FULL_RESTORE		= 0,	//query all states before rendering, restore the changed ones after rendering
+		STATE_MINIMAL_RESTORE	= 1,	//query and restore only the states and texture units which the compositor changes
+		STATE_HOST_COOPERATES	= 2		//do not save or restore, the main program sets its own states and calls invalidateStateCache()
+	};
+
+	//Contains counters of the state tracker
+	struct stateStats{
+		unsigned int callsIssued;		//state calls (including queries) made by the compositor
+		unsigned int callsAvoided;		//redundant state calls skipped, and save/restore calls skipped compared to a full save/restore
 	};
 
 private:
 
+	//Kind of components passed to the uniform setters
+	enum uniformKind
+	{
+		UNIFORM_FLOAT,
+		UNIFORM_INT,
+		UNIFORM_UINT
+	};
+
+	//Contains information of an active uniform, reflected once when the program is linked
+	struct uniform{
+		std::string name;
+		GLint location;
+		GLenum type;
+		GLint size;
+		GLuint value[4];		//shadow copy of the last value set, stored as raw bits of GLfloat/GLint/GLuint
+		uniformKind kind;
+		int components;
+		bool valid;				//false until a value has been set, the program might have initializers we do not know
+	};
+
+	//Contains a program being built
+	struct programBuild{
+		std::string source;
+		GLuint program;
+		GLuint fragmentShader;			//0 if program was loaded from the program binary cache, it is already linked (the compute shader for compute passes)
+		bool compute;					//source is a compute shader, linked alone
+		bool batch;						//linked with the vertex shader of batch passes
+		std::string cacheKey;			//empty if the program binary cache is disabled
+		std::string cachePath;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	static const int MAX_OUTPUT_CHANNELS = 16;	//color attachments which can be set with Compositor::setOutputTexture()
+
+	static const int LAYER_FLOATS = 10;		//per-layer attributes : rectangle, uv transform, opacity and texture index
+
+	//Contains consecutive layers of a layer pass drawn with one instanced draw
+	struct layerBatch{
+		blendMode blend;
+		GLint first;		//index of the first layer in pass::layerBuffer
+		GLsizei count;
+	};
+
+	//Contains what is done with the outputs of a pass when it is rendered, resolved from its load and store actions
+	struct passActions{
+		std::vector<GLint> clearBuffers;		//draw buffers cleared before rendering
+		bool clearAll;							//clearBuffers holds every draw buffer, cleared with a single glClear
+		std::vector<GLenum> invalidateBefore;	//attachments invalidated before rendering
+		std::vector<GLenum> invalidateAfter;	//attachments invalidated after rendering
+		std::vector<std::pair<int, int>> invalidateInputs;	//render pass ID and interned sampler name of transient inputs read for the last time
+	};
+
 	//Contains information per pass
 	struct pass{
 		GLuint fbo;
-		GLuint shaderFragment;
+		bool compute;								//created by Compositor::createComputePass(), outputs are written as images
+		bool layered;								//created by Compositor::createLayerPass(), draws its layers instanced
+		int batchSize;								//images drawn by a batch pass (see Compositor::createBatchPass()), 0 for other passes
+		GLuint layerArray;							//vertex array of the quad and the per-layer attributes
+		GLuint layerBuffer;							//per-layer attributes, in drawing order
+		std::vector<layerBatch> layerBatches;		//consecutive layers drawn with the same blend mode
+		GLuint shaderFragment;						//compute shader for compute passes
 		GLuint shaderProgram;
+		std::string fragmentSource;
 		bool initialized;
-		std::map<char*, GLuint> texInputs;		//key is uniform name in shader, value is TextureID
+		std::map<int, GLuint> texInputs;		//key is interned sampler name (see Compositor::internSampler()), value is TextureID
 		std::map<int, GLuint> texOutputs;		//key is MRT output channel, value is TextureID
-		GLenum *texOutputsChannels;
+		GLenum texOutputsChannels[MAX_OUTPUT_CHANNELS];	//draw buffers, entry i is the attachment written by output location i (GL_NONE if unused)
+		int drawBufferCount;						//highest output channel + 1
+		std::map<int, int> transientInputs;			//key is interned sampler name, value is transient texture ID (texInputs holds the assigned texture)
+		std::vector<int> unitSamplers;				//interned sampler name of each texture unit, assigned when the program is linked
+		std::vector<GLuint> unitTextures;			//texture bound to each texture unit when the pass is rendered
+		unsigned int arrayUnits;					//bitmask of texture units whose sampler is a sampler2DArray
+		std::vector<std::pair<int, GLint>> imageInputs;	//interned name and image unit of each image uniform, bound read-only if it is set as an input
+		GLint workGroupSize[2];						//local size of the compute shader
+		std::map<int, int> transientOutputs;		//key is MRT output channel, value is transient texture ID (texOutputs holds the assigned texture)
+		std::vector<uniform> uniforms;				//active uniforms of shaderProgram, index is the uniform handle
+		std::map<std::string, int> uniformHandles;	//key is uniform name in shader, value is index in uniforms
+		std::vector<unsigned int> uniformDirty;		//bitset of uniforms which are staged but not uploaded yet, bit index is the uniform handle
+		bool hasDirtyUniforms;
+		bool pending;								//build holds a shader loaded asynchronously which is not installed yet
+		programBuild build;
+		bool failed;								//the last shader loaded asynchronously failed
+		std::string failedLog;						//compile or link log of that shader
+		float sizeScale;							//size relative to the resolution, used if fixedWidth is 0
+		GLsizei fixedWidth, fixedHeight;			//absolute size, see Compositor::setPassSize()
+		int kernelRadius;							//pixels around an output pixel which its value depends on, see Compositor::setPassKernelRadius()
+		unsigned int uniformChanges;				//incremented whenever a uniform value or the layers change
+		unsigned long long memoSignature;			//hash of what the outputs were last rendered from, see Compositor::isPassChanged()
+		bool memoValid;								//memoSignature is set
+		bool discards;								//the shader contains discard (or the pass draws layers), so outputs are cleared by default
+		std::map<int, loadAction> loadActions;		//key is MRT output channel, see Compositor::setOutputLoadAction()
+		std::map<int, storeAction> storeActions;	//key is MRT output channel, see Compositor::setOutputStoreAction()
+		passActions actions;						//actions when rendered by Compositor::renderPass()
+		unsigned int version;						//m_passesVersion when the shader, an input, an output or the size of the pass last changed
+		unsigned int actionsVersion;				//version when actions was resolved
+		GLuint renderedFbo;							//framebuffer of the frame slot the outputs were last rendered into, 0 for fbo
+	};
+
+
+	static const int MAX_TEXTURE_UNITS = 32;
+	static const unsigned int FULL_STATE_CALLS = 250;	//calls made by a full save and restore : 13 states twice, and 32 texture units with 2 targets (3 calls each to save, 4 to restore)
+
+	//Bits of the states in Compositor::state
+	enum cachedState
+	{
+		CACHED_FBO				= 0x001,
+		CACHED_VIEWPORT			= 0x002,
+		CACHED_CLEAR_COLOR		= 0x004,
+		CACHED_DEPTH_MASK		= 0x008,
+		CACHED_PROGRAM			= 0x010,
+		CACHED_ACTIVE_TEXTURE	= 0x020,
+		CACHED_VERTEX_ARRAY		= 0x040,
+		CACHED_ARRAY_BUFFER		= 0x080,
+		CACHED_BLEND			= 0x100,
+		CACHED_SCISSOR_TEST		= 0x200,
+		CACHED_SCISSOR_BOX		= 0x400,
+		CACHED_BLEND_FUNC		= 0x800,
+		CACHED_UNIFORM_BUFFER	= 0x1000,	//generic GL_UNIFORM_BUFFER binding, also changed by glBindBufferRange
+		CACHED_ALL				= 0x1FFF
+	};
+
+	//Type of a pipeline
+	enum pipelineType
+	{
+		PIPELINE_SEQUENTIAL,		//passes are rendered in the given order
+		PIPELINE_GRAPH				//passes are sorted by their texture dependencies, unused passes are culled
+	};
+
+	//Contains a program generated by fusing shaders of passes, key in m_fusedPrograms is its source
+	struct fusedProgram{
+		GLuint program;
+		GLuint fragmentShader;
+		bool failed;						//the fused source does not compile, its passes are rendered unfused
+		std::vector<uniform> uniforms;		//active uniforms except samplers, value is the value last uploaded to program
+		std::vector<std::string> samplers;	//active samplers, index is the texture unit
+	};
+
+	//Contains a chain of passes rendered by one fused program
+	struct fusedPass{
+		std::vector<int> members;							//render pass IDs in rendering order, the outputs of the last one are rendered
+		fusedProgram* program;
+		std::vector<std::pair<int, int>> uniformSources;	//for each uniform of program, index in members and uniform handle in that pass (-1 if none)
+		std::vector<std::pair<int, int>> samplerSources;	//for each sampler of program, index in members and key in texInputs of that pass (-1 if none)
+	};
+
+	//Values of pipeline::fusedGroup besides indices in pipeline::fused
+	enum fusedGroupState{
+		NOT_FUSED = -1,		//the pass is rendered by itself
+		FUSED_AWAY = -2		//the pass is rendered as part of a later fused pass
+	};
+
+	//Memory barrier after compute passes whose outputs are used by the main program, which may use them in any of these ways
+	static const GLbitfield HOST_BARRIER_BITS = GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT | 
+		GL_TEXTURE_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT;
+
+	static const int TIMING_FRAMES = 4;		//frames of timer queries in flight per pipeline before a frame is not measured
+	static const int TIMING_WINDOW = 64;	//frames used for min/avg/max
+
+	//Contains the timer queries of one rendering of a pipeline
+	struct timingFrame{
+		std::vector<GLuint> queries;	//GL_TIMESTAMP queries : before the first pass, then after each pass in passes
+		std::vector<int> passes;		//render pass IDs measured, in rendering order
+		bool pending;					//results not read yet
+	};
+
+	//Contains the last durations of a pass or pipeline
+	struct timingHistory{
+		std::vector<double> samples;	//up to TIMING_WINDOW durations in milliseconds
+		size_t next;					//index in samples replaced by the next duration once samples is full
+		double last;
+	};
+
+	//Contains a rectangle in normalized coordinates (0 to 1), empty if x0 >= x1 or y0 >= y1
+	struct damageRect{
+		float x0, y0, x1, y1;
+	};
+
+	//Contains the framebuffer and textures of a pass for one frame slot of a pipeline with frames in flight, swapped with those of the pass
+	struct passFrame{
+		GLuint fbo;
+		std::map<int, GLuint> texInputs;
+		std::map<int, GLuint> texOutputs;
+		std::vector<GLuint> unitTextures;
+	};
+
+	//Contains a frame slot of a pipeline with frames in flight
+	struct pipelineFrame{
+		std::map<int, passFrame> passes;	//key is render pass ID, empty for slot 0 which renders into the textures of the passes
+		GLsync fence;						//signaled when the GPU finished the frame, 0 once checked
+		unsigned long long number;			//frame rendered in this slot, 0 if none
+	};
+
+	//Contains the copies of an output texture of the main program, one per frame slot from 1
+	struct frameTexture{
+		GLsizei width, height;
+		GLenum internalFormat;
+		std::vector<GLuint> copies;
+	};
+
+	//Commands of a baked pipeline
+	enum bakedOp{
+		BAKED_FRAMEBUFFER,		//bind framebuffer object
+		BAKED_PROGRAM,			//use program object
+		BAKED_TEXTURES,			//bind args[1] textures from bakedList::textures[args[2]] to units args[0] and up, object is the array units mask from args[0]
+		BAKED_DRAW_BUFFERS,		//set args[0] draw buffers from bakedList::drawBuffers[args[1]]
+		BAKED_VIEWPORT,			//set viewport to args[0] x args[1]
+		BAKED_UNIFORMS,			//upload the changed uniforms of render pass args[0]
+		BAKED_FUSED_UNIFORMS,	//upload the changed uniforms of the members of pipeline::fused[args[0]]
+		BAKED_IMAGE,			//bind texture object to image unit args[0] with access args[1] and format args[2]
+		BAKED_LOAD,				//clear or invalidate the outputs of pipeline::actions[args[0]]
+		BAKED_STORE,			//invalidate the discarded outputs of pipeline::actions[args[0]]
+		BAKED_INVALIDATE,		//invalidate texture object, read for the last time
+		BAKED_DRAW,				//draw the quad, args[0] instances for batch passes
+		BAKED_LAYERS,			//draw the layers of render pass args[0] with pipeline::actions[args[1]]
+		BAKED_DISPATCH,			//dispatch args[0] x args[1] work groups
+		BAKED_BARRIER			//glMemoryBarrier with bits args[0]
+	};
+
+	//Contains a command of a baked pipeline
+	struct bakedCommand{
+		bakedOp op;
+		GLuint object;			//framebuffer, program, texture or bitmask, depending on op
+		GLint args[3];
+	};
+
+	//Contains the command list a pipeline is baked into, replayed without looking up or verifying passes
+	struct bakedList{
+		std::vector<bakedCommand> commands;
+		std::vector<GLuint> textures;			//texture objects of the BAKED_TEXTURES commands
+		std::vector<GLenum> drawBuffers;		//draw buffers of the BAKED_DRAW_BUFFERS commands
+		std::vector<int> passes;				//render pass IDs, checked for pending shaders before replaying
+		std::vector<unsigned int*> versions;	//entries of m_textureVersions of the outputs, incremented by each replay
+		int rendered;							//passes rendered by each replay, fused chains counted once, for memoStats
+		unsigned int version;					//Compositor::pipelineVersion() when baked
+		GLuint width, height;					//resolution when baked
+	};
+
+	//Contains information per pipeline
+	struct pipeline{
+		pipelineType type;
+		std::vector<int> passes;			//render pass IDs given by Compositor::setPipeline()
+		std::vector<GLuint> finalOutputs;	//textures requested from a graph pipeline, empty means all passes are rendered
+		std::vector<int> order;				//render pass IDs in rendering order
+		unsigned int version;				//m_passesVersion when passes or finalOutputs were set
+		unsigned int resolvedVersion;		//Compositor::pipelineVersion() when order was computed
+		std::map<int, GLuint> transientTextures;	//key is transient texture ID, value is the texture assigned from the pool
+		unsigned int transientVersion;		//Compositor::pipelineVersion() when transientTextures was assigned
+		bool fusion;						//per-pixel passes are fused, see Compositor::setPipelineFusion()
+		std::vector<int> fusedGroup;		//for each pass in order, index in fused, NOT_FUSED or FUSED_AWAY (empty if fusion is disabled)
+		std::vector<fusedPass> fused;
+		bool timing;						//GPU time is measured, see Compositor::setPipelineTiming()
+		std::vector<timingFrame> timingFrames;	//ring of TIMING_FRAMES frames
+		int timingNext;						//next frame in timingFrames to measure
+		timingHistory timingTotal;
+		std::map<int, timingHistory> timingPasses;	//key is render pass ID
+		std::vector<GLbitfield> barriers;	//for each pass in order, glMemoryBarrier bits needed before it because of earlier image writes
+		GLbitfield finalBarrier;			//glMemoryBarrier bits after the last pass, for outputs written as images and used by the main program
+		bool damageTracking;				//only damaged regions are rendered, see Compositor::setPipelineDamageTracking()
+		std::map<GLuint, damageRect> damage;	//key is TextureID, value is the region changed since the last rendering
+		bool damageValid;					//outputs hold a complete rendering, so undamaged regions can be kept
+		unsigned int damageVersion;			//Compositor::pipelineVersion() at the last rendering
+		GLuint damageWidth, damageHeight;	//resolution at the last rendering
+		unsigned int damageBlocksVersion;	//m_uniformBlocksVersion at the last rendering
+		std::map<int, unsigned int> damageUniforms;	//key is render pass ID, value is pass::uniformChanges at the last rendering
+		bool memoization;					//passes whose inputs did not change are skipped, see Compositor::setPipelineMemoization()
+		memoStats memo;
+		int framesInFlight;					//frame slots each output rotates through, see Compositor::setPipelineFramesInFlight()
+		std::vector<pipelineFrame> frames;	//one per frame slot, empty if framesInFlight is 1
+		int frameNext;						//slot of the next frame
+		unsigned long long frameCount;		//frames rendered
+		unsigned int framesVersion;			//Compositor::pipelineVersion() when the frame slots were set up
+		std::map<GLuint, frameTexture> frameTextures;	//key is output texture of the main program
+		std::vector<passActions> actions;	//for each pass in order, what is done with its outputs (empty for passes fused away)
+		bool baking;						//rendered by replaying baked, see Compositor::setPipelineBaking()
+		bakedList baked;
+	};
+
+	//Contains declaration of a transient texture
+	struct transient{
+		int width;
+		int height;
+		GLenum internalFormat;
+	};
+
+	//Contains a texture owned by the transient pool
+	struct poolTexture{
+		GLuint texture;
+		int width;
+		int height;
+		GLenum internalFormat;
 	};
 
+	//Contiguous storage of objects referred to by generational handles. A handle holds the slot index in its low 16 bits and the 
+	//generation of the slot in the bits above, so a handle of a deleted object is detected even after its slot is reused.
+	template <typename T>
+	class slotMap{
+	public:
+		slotMap() : m_count(0) {}
+
+		int insert(const T& value)
+		{
+			int index;
+			if (!m_free.empty()) { index = m_free.back(); m_free.pop_back(); }
+			else
+			{
+				if (m_slots.size() > INDEX_MASK) return -1;
+				index = (int)m_slots.size();
+				m_slots.push_back(slot());
+				m_slots.back().generation = 0;
+			}
+			slot& s = m_slots[index];
+			s.generation = s.generation % MAX_GENERATION + 1;		//never 0, so no valid handle is 0
+			s.used = true;
+			s.value = value;
+			m_count++;
+			return (s.generation << INDEX_BITS) | index;
+		}
+
+		//nullptr if the handle is invalid or its object was erased
+		T* find(int handle)
+		{
+			if (handle <= 0) return nullptr;
+			size_t index = handle & INDEX_MASK;
+			if (index >= m_slots.size() || !m_slots[index].used || m_slots[index].generation != (handle >> INDEX_BITS)) return nullptr;
+			return &m_slots[index].value;
+		}
+
+		//the handle must be valid
+		T& operator[](int handle) { return m_slots[handle & INDEX_MASK].value; }
+
+		bool erase(int handle)
+		{
+			if (find(handle) == nullptr) return false;
+			slot& s = m_slots[handle & INDEX_MASK];
+			s.used = false;
+			s.value = T();		//free what the object holds
+			m_free.push_back(handle & INDEX_MASK);
+			m_count--;
+			return true;
+		}
+
+		size_t size() { return m_count; }
+
+		//to iterate over the objects : slots from 0 to slotCount() - 1, at() is nullptr for free slots
+		size_t slotCount() { return m_slots.size(); }
+		T* at(size_t index) { return m_slots[index].used ? &m_slots[index].value : nullptr; }
+		int handleAt(size_t index) { return (m_slots[index].generation << INDEX_BITS) | (int)index; }
+
+	private:
+		static const int INDEX_BITS = 16;
+		static const int INDEX_MASK = (1 << INDEX_BITS) - 1;
+		static const int MAX_GENERATION = 0x7FFF;		//handles stay positive
+
+		struct slot{
+			T value;
+			int generation;
+			bool used;
+		};
+		std::vector<slot> m_slots;
+		std::vector<int> m_free;		//indices of free slots
+		size_t m_count;
+	};
+
+	static const int UNIFORM_RING_SEGMENTS = 3;			//frames in flight in the uniform block ring buffer
+	static const int UNIFORM_RING_MIN_SEGMENT = 65536;	//minimum bytes per segment of the ring buffer
+
+	//Contains a uniform block shared by all passes, matched by name with the uniform blocks of the shaders
+	struct uniformBlock{
+		std::string name;
+		std::vector<char> data;		//values written by the main program, std140 layout
+		GLuint binding;				//uniform buffer binding point, from the top of the binding points
+		bool dirty;					//data changed since it was copied to the ring buffer
+		GLintptr offset;			//offset of the current copy in the ring buffer
+	};
+
+	static const int STREAM_RING_SIZE = 3;		//frames a stream texture can have in flight
+
+	//Contains a texture streamed from the CPU through pixel buffers
+	struct stream{
+		GLuint texture;
+		GLsizei width, height;
+		GLenum format, type;				//of the frames written by the main program
+		GLsizeiptr frameSize;				//bytes of a frame, rows packed without padding
+		GLuint pbo;							//STREAM_RING_SIZE frames if persistently mapped, one frame orphaned at each write otherwise
+		char* mapped;						//persistent mapping of pbo, nullptr without buffer storage
+		GLsync fences[STREAM_RING_SIZE];	//signaled when the texture upload from each frame of pbo is done, 0 if none
+		int next;							//frame of pbo written next
+		bool writing;						//between beginStreamWrite() and endStreamWrite()
+		const char* fileData;				//file mapped with Compositor::mapStreamFile(), nullptr if none
+		size_t fileSize;
+		void* fileMapping;					//mapping handle on Windows
+		streamStats stats;
+		std::chrono::steady_clock::time_point firstUpload, lastUpload;
+	};
+
+	//Contains a job of the resource thread
+	struct resourceJob{
+		int id;
+		int passID;							//pass receiving the program, 0 for texture uploads
+		std::string source;
+		bool compute;						//source is a compute shader
+		bool batch;							//linked with the vertex shader of batch passes
+		GLsizei width, height;
+		GLenum internalFormat, format, type;
+		std::vector<char> pixels;			//copy of the texture data, rows packed without padding
+		resourceCallback callback;
+		void* userData;
+		GLuint object;						//program or texture built by the resource thread, 0 if it failed
+		GLuint shader;						//fragment or compute shader of the program
+		GLsync fence;						//signaled when the GPU finished building the object
+		std::string log;					//compile or link log if the shader failed
+	};
+
+	//Contains a pixel buffer of the readback ring
+	struct readbackSlot{
+		GLuint pbo;
+		GLsizeiptr capacity;		//allocated bytes of pbo
+		GLsizeiptr size;			//bytes of the pending readback
+		GLsync fence;				//signaled when the pixels are in pbo, 0 once checked
+		int id;						//Readback ID using this slot, 0 if free
+		void* mapped;				//mapping of pbo, nullptr if not mapped
+		readbackCallback callback;
+		void* userData;
+	};
+
+	//Contains the buffer range bound to a uniform buffer binding point
+	struct bufferRange{
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;		//0 if the whole buffer is bound
+	};
+
+	//Contains the texture bound to an image unit
+	struct imageBinding{
+		GLuint texture;
+		GLint level;
+		GLboolean layered;
+		GLint layer;
+		GLenum access;
+		GLenum format;
+	};
 
 	//Contains saved OpenGL states before rendering
 	struct state{
 		GLuint fbo;
 		GLenum tex_active;
-		std::vector<int> tex_binds;
+		GLint tex_binds[MAX_TEXTURE_UNITS];			//GL_TEXTURE_2D binding of each texture unit
+		GLint tex_array_binds[MAX_TEXTURE_UNITS];	//GL_TEXTURE_2D_ARRAY binding of each texture unit
 		GLuint shaderProgram;
 		GLint bufferVertexArray;
 		GLint bufferArrayBuffer;
@@ -55,6 +667,15 @@ private:
 		GLfloat clearColor[4];
 		GLint viewport[4];
 		GLboolean alphaBlend;
+		GLint blendFunc[6];			//source and destination factors for RGB and alpha, then equations for RGB and alpha
+		GLboolean scissorTest;
+		GLint scissorBox[4];
+		GLuint uniformBuffer;
+		std::map<GLuint, bufferRange> uniformRanges;	//key is uniform buffer binding point, holds only the binding points with a value
+		std::map<GLuint, imageBinding> imageUnits;		//key is image unit, holds only the image units with a value
+		unsigned int valid;			//bitmask of cachedState, which states above hold a value
+		unsigned int texValid;		//bitmask of texture units, which tex_binds hold a value
+		unsigned int texArrayValid;	//bitmask of texture units, which tex_array_binds hold a value
 	} m_state;
 
 	//global variables
@@ -64,11 +685,75 @@ private:
 	GLuint m_shaderVertex;
 	GLuint m_vertexBuffer;
 	GLuint m_vertexArray;
-	state m_states;
+	int m_glVersion;								//e.g. 41 for OpenGL 4.1
+	bool m_hasProgramUniform;						//glProgramUniform* is available (OpenGL 4.1 or ARB_separate_shader_objects)
+	bool m_hasMultiBind;							//glBindTextures is available (OpenGL 4.4 or ARB_multi_bind)
+	bool m_hasCompute;								//compute shaders and image load/store are available (OpenGL 4.3 or ARB_compute_shader)
+	bool m_hasBaseInstance;							//glDrawArraysInstancedBaseInstance is available (OpenGL 4.2 or ARB_base_instance)
+	bool m_hasVertexLayer;							//gl_Layer can be written by the vertex shader (ARB_shader_viewport_layer_array or AMD_vertex_shader_layer)
+	bool m_hasInvalidate;							//glInvalidateFramebuffer and glInvalidateTexImage are available (OpenGL 4.3 or ARB_invalidate_subdata)
+	bool m_hasBufferStorage;						//glBufferStorage is available (OpenGL 4.4 or ARB_buffer_storage), the ring buffer is persistently mapped
+	GLint m_uniformBufferAlignment;					//GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	GLint m_maxUniformBindings;						//GL_MAX_UNIFORM_BUFFER_BINDINGS
+	bool m_hasParallelCompile;						//GL_COMPLETION_STATUS_KHR can be queried (KHR/ARB_parallel_shader_compile)
+	std::vector<GLint> m_programBinaryFormats;		//formats accepted by glProgramBinary, empty if not available (OpenGL 4.1 or ARB_get_program_binary)
+	std::string m_vertexSource;						//source of m_shaderVertex
+	GLuint m_batchVertexShader;						//vertex shader of batch passes, 0 until the first one is created
+	GLuint m_batchGeometryShader;					//writes gl_Layer when the vertex shader cannot, 0 otherwise
+	std::string m_batchSource;						//sources of m_batchVertexShader and m_batchGeometryShader
+	std::string m_driverString;						//vendor, renderer and version strings, part of the program cache key
+	std::string m_programCacheDirectory;			//empty if the program binary cache is disabled
+	programCacheStats m_programCacheStats;
+	bool m_uniformStaging;							//uniform values are uploaded when the pass is rendered instead of when they are set
+	state m_cache;									//OpenGL states as last set by the compositor
+	stateMode m_stateMode;
+	stateStats m_stats;
+	unsigned int m_saveRestoreCalls;				//calls made by pushState/popState (and lazy saving) in the current rendering
 	error m_lastError;
 	std::string m_shaderErrorString;
-	std::map<int, pass> m_passes;					//key is Render pass ID generated by Compositor::createNewPass(), pass contains information in this pass
-	std::map<int, std::vector<int>> m_pipelines;	//key is Pipeline ID generated by Compositor::createSequentialPipeline(), int contains render pass IDs in this pipeline
+	slotMap<pass> m_passes;							//handle is Render pass ID generated by Compositor::createNewPass(), pass contains information in this pass
+	slotMap<pipeline> m_pipelines;					//handle is Pipeline ID generated by Compositor::createSequentialPipeline() or Compositor::createGraphPipeline()
+	unsigned int m_passesVersion;					//incremented whenever shader, input or output of any pass changes, the new value is the version of what changed
+	unsigned int m_globalVersion;					//m_passesVersion when a pass or a transient texture was last deleted, which may change any pipeline
+	std::map<int, transient> m_transients;			//key is transient texture ID generated by Compositor::createTransientTexture()
+	int m_nextTransientID;
+	std::vector<poolTexture> m_pool;				//textures assigned to transient textures
+	std::map<std::string, fusedProgram> m_fusedPrograms;
+	std::map<GLuint, GLenum> m_imageFormats;		//internal format of textures bound as images, queried once
+	slotMap<uniformBlock> m_uniformBlocks;			//handle is Uniform block ID generated by Compositor::createUniformBlock()
+	std::map<std::string, int> m_uniformBlockIDs;	//key is uniform block name, value is Uniform block ID
+	GLuint m_uniformRing;							//ring buffer of UNIFORM_RING_SEGMENTS segments holding copies of the uniform blocks
+	char* m_uniformRingMapped;						//persistent mapping of m_uniformRing, nullptr without buffer storage
+	GLsizeiptr m_uniformRingSegmentSize;
+	int m_uniformRingSegment;						//segment being filled
+	GLintptr m_uniformRingOffset;					//next free byte in that segment
+	GLsync m_uniformRingFences[UNIFORM_RING_SEGMENTS];	//signaled when the GPU is done with each segment, 0 if none
+	unsigned int m_uniformBlocksVersion;			//incremented whenever data of a uniform block changes
+	std::map<GLuint, unsigned int> m_textureVersions;	//key is TextureID, incremented whenever the texture is rendered or marked changed
+	std::vector<std::string> m_samplerNames;		//interned sampler names, index is the interned ID
+	std::map<std::string, int> m_samplerIDs;		//key is sampler name, value is index in m_samplerNames
+	slotMap<stream> m_streams;						//handle is Stream ID generated by Compositor::createStreamTexture()
+	std::vector<readbackSlot> m_readbacks;			//ring of pixel buffers for asynchronous readbacks
+	int m_readbackNext;								//next slot of m_readbacks to use
+	int m_nextReadbackID;
+	pendingPolicy m_pendingPolicy;
+	GLuint m_layerProgram;							//shared by all layer passes, 0 until the first one is created
+	GLuint m_layerVertexShader;
+	GLuint m_layerFragmentShader;
+	GLint m_layerMaskLocation;						//location of layer_mask, the layer textures set for the pass being drawn
+	std::vector<int> m_layerSamplers;				//sampler ID of each layer texture
+	GLuint m_passthroughProgram;					//used for PENDING_PASSTHROUGH, 0 until that policy is set
+	GLuint m_passthroughShader;
+	std::thread m_resourceThread;					//builds programs and textures in a context sharing objects with the main one
+	std::mutex m_resourceMutex;						//guards m_resourceQueue, m_resourceBuilt, m_resourceState
+	std::condition_variable m_resourceCondition;
+	std::deque<resourceJob> m_resourceQueue;		//jobs submitted, not built yet
+	std::vector<resourceJob> m_resourceBuilt;		//jobs built, not taken by the main thread yet
+	int m_resourceState;							//0 while starting, 1 while running, -1 when stopped or stopping
+	std::atomic<bool> m_resourceHasBuilt;			//m_resourceBuilt is not empty, checked without locking
+	std::atomic<int> m_resourceJobsInFlight;		//jobs submitted and not published yet
+	std::atomic<int> m_nextResourceJobID;
+	std::vector<resourceJob> m_resourceFenced;		//main thread only : jobs taken from m_resourceBuilt whose fence is not signaled yet
 	
 public:
 	Compositor();
@@ -76,54 +761,273 @@ public:
 	error getLastError();
 	std::string getLastShaderError();
 
+	bool setProgramCache(const char*);
+	programCacheStats getProgramCacheStats();
+	void resetProgramCacheStats();
+
 	void setResolution(int, int);
 	int createNewPass();
+	int createComputePass();
+	int createLayerPass();
+	bool setLayerTexture(int, int, GLuint);
+	bool setLayers(int, const layer*, int);
+	int createBatchPass(int);
+	bool setBatchSize(int, int);
 	bool loadShader(int, char*);
+	bool loadShaderSource(int, const char*);
+	bool loadShaderAsync(int, char*);
+	bool loadShaderSourceAsync(int, const char*);
+	passState getPassState(int);
+	bool updatePendingShaders();
+	bool setPendingPolicy(pendingPolicy);
 	bool deletePass(int);
 	bool renderPass(int);
 
 	int createSequentialPipeline();
+	int createGraphPipeline();
+	int createPyramidPipeline(GLuint, GLuint, int, GLenum);
 	bool setPipeline(int, std::vector<int>);
+	bool setGraphPipeline(int, std::vector<int>, std::vector<GLuint>);
 	std::vector<int> getPipeline(int);
+	std::vector<int> getPipelineOrder(int);
+	bool setPipelineFusion(int, bool);
+	std::vector<std::vector<int>> getPipelineFusion(int);
+	bool setPipelineTiming(int, bool);
+	gpuTime getPipelineGpuTime(int);
+	gpuTime getPassGpuTime(int, int);
+	bool setPipelineDamageTracking(int, bool);
+	bool addDamage(int, GLuint, int, int, int, int);
+	bool setPassKernelRadius(int, int);
+	bool setPassScale(int, float);
+	bool setPassSize(int, int, int);
+	bool setPipelineMemoization(int, bool);
+	memoStats getPipelineMemoStats(int);
+	void markTextureChanged(GLuint);
+	bool setPipelineFramesInFlight(int, int);
+	GLuint getCompletedOutput(int, GLuint, unsigned long long*);
+	bool setPipelineBaking(int, bool);
+
+	int createStreamTexture(int, int, GLenum, GLenum, GLenum);
+	GLuint getStreamTexture(int);
+	void* beginStreamWrite(int);
+	bool endStreamWrite(int);
+	bool uploadStreamFrame(int, const void*);
+	bool mapStreamFile(int, const char*);
+	bool uploadStreamFileFrame(int, size_t);
+	streamStats getStreamStats(int);
+	bool deleteStreamTexture(int);
+
+	bool startResourceThread(resourceContextCallback, void*);
+	void stopResourceThread();
+	int submitShaderSource(int, const char*, shaderKind, resourceCallback, void*);
+	int submitTextureUpload(int, int, GLenum, GLenum, GLenum, const void*, resourceCallback, void*);
+	bool updateResourceJobs();
+
+	bool setReadbackRingSize(int);
+	int readbackPassOutput(int, int, GLenum, GLenum);
+	bool setReadbackCallback(int, readbackCallback, void*);
+	readbackState getReadbackState(int);
+	const void* mapReadback(int, int*);
+	bool releaseReadback(int);
+	void updateReadbacks();
 	bool deletePipeline(int);
 	bool renderPipeline(int);
 
+	int createUniformBlock(char*, int);
+	bool setUniformBlockData(int, int, const void*, int);
+	bool deleteUniformBlock(int);
+
+	int getUniformHandle(int, char*);
+	void setUniformStaging(bool);
+
+	void setStateMode(stateMode);
+	void invalidateStateCache();
+	stateStats getStateStats();
+	void resetStateStats();
+
 	//set uniform values
+	//The overloads taking int instead of char* use the handle returned by getUniformHandle(), which skips the name lookup
 	//Can add more functions in the future handle other types of uniform (e.g. GLint, GLuint, matrix, etc. (refer to https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glUniform.xhtml)
 	bool setUniformValue1f(int, char*, GLfloat);
+	bool setUniformValue1f(int, int, GLfloat);
 	bool setUniformValue2f(int, char*, GLfloat, GLfloat);
+	bool setUniformValue2f(int, int, GLfloat, GLfloat);
 	bool setUniformValue3f(int, char*, GLfloat, GLfloat, GLfloat);
+	bool setUniformValue3f(int, int, GLfloat, GLfloat, GLfloat);
 	bool setUniformValue4f(int, char*, GLfloat, GLfloat, GLfloat, GLfloat);
+	bool setUniformValue4f(int, int, GLfloat, GLfloat, GLfloat, GLfloat);
 	bool setUniformValue1i(int, char*, GLint);
+	bool setUniformValue1i(int, int, GLint);
 	bool setUniformValue2i(int, char*, GLint, GLint);
+	bool setUniformValue2i(int, int, GLint, GLint);
 	bool setUniformValue3i(int, char*, GLint, GLint, GLint);
+	bool setUniformValue3i(int, int, GLint, GLint, GLint);
 	bool setUniformValue4i(int, char*, GLint, GLint, GLint, GLint);
+	bool setUniformValue4i(int, int, GLint, GLint, GLint, GLint);
 	bool setUniformValue1ui(int, char*, GLuint);
+	bool setUniformValue1ui(int, int, GLuint);
 	bool setUniformValue2ui(int, char*, GLuint, GLuint);
+	bool setUniformValue2ui(int, int, GLuint, GLuint);
 	bool setUniformValue3ui(int, char*, GLuint, GLuint, GLuint);
+	bool setUniformValue3ui(int, int, GLuint, GLuint, GLuint);
 	bool setUniformValue4ui(int, char*, GLuint, GLuint, GLuint, GLuint);
+	bool setUniformValue4ui(int, int, GLuint, GLuint, GLuint, GLuint);
 	bool setUniformValue1fv(int, char*, GLfloat*);
+	bool setUniformValue1fv(int, int, GLfloat*);
 	bool setUniformValue2fv(int, char*, GLfloat*);
+	bool setUniformValue2fv(int, int, GLfloat*);
 	bool setUniformValue3fv(int, char*, GLfloat*);
+	bool setUniformValue3fv(int, int, GLfloat*);
 	bool setUniformValue4fv(int, char*, GLfloat*);
+	bool setUniformValue4fv(int, int, GLfloat*);
 	bool setUniformValue1iv(int, char*, GLint*);
+	bool setUniformValue1iv(int, int, GLint*);
 	bool setUniformValue2iv(int, char*, GLint*);
+	bool setUniformValue2iv(int, int, GLint*);
 	bool setUniformValue3iv(int, char*, GLint*);
+	bool setUniformValue3iv(int, int, GLint*);
 	bool setUniformValue4iv(int, char*, GLint*);
+	bool setUniformValue4iv(int, int, GLint*);
 	bool setUniformValue1uiv(int, char*, GLuint*);
+	bool setUniformValue1uiv(int, int, GLuint*);
 	bool setUniformValue2uiv(int, char*, GLuint*);
+	bool setUniformValue2uiv(int, int, GLuint*);
 	bool setUniformValue3uiv(int, char*, GLuint*);
+	bool setUniformValue3uiv(int, int, GLuint*);
 	bool setUniformValue4uiv(int, char*, GLuint*);
+	bool setUniformValue4uiv(int, int, GLuint*);
 	bool setUniformTexture(int, char*, GLuint);
 	bool deleteUniformTexture(int, char*);
 	bool setOutputTexture(int, int, GLuint);
 	bool deleteOutputTexture(int, int);
+	bool setOutputLoadAction(int, int, loadAction);
+	bool setOutputStoreAction(int, int, storeAction);
+
+	int createTransientTexture(int, int, GLenum);
+	bool deleteTransientTexture(int);
+	bool setTransientInput(int, char*, int);
+	bool setTransientOutput(int, int, int);
+	GLuint getTransientTexture(int, int);
+	poolStats getPoolStats();
+	void clearTransientPool();
 
 private:
+	void initializeCapabilities();
+	bool hasExtension(const char*);
 	void initializeVertexShader();
 	void initializeBufferObject();
 	void pushState();
 	void popState();
-	void renderPassInternal(std::map<int, pass>::iterator p);
+	void saveState(unsigned int);
+	void saveTexture(int, GLenum);
+	void saveUniformRange(GLuint);
+	void saveImageUnit(GLuint);
+	void bindFramebuffer(GLuint);
+	void useProgram(GLuint);
+	void bindVertexArray(GLuint, GLuint);
+	void setActiveTexture(GLenum);
+	void bindTexture(int, GLuint, GLenum);
+	void bindTextures(const std::vector<GLuint>&, unsigned int);
+	void bindTextures(int, int, const GLuint*, unsigned int);
+	void setViewport(GLint, GLint, GLsizei, GLsizei);
+	void setClearColor(GLfloat, GLfloat, GLfloat, GLfloat);
+	void setDepthMask(GLboolean);
+	void setBlend(GLboolean);
+	void setBlendFunc(GLenum, GLenum);
+	void setScissor(GLboolean, GLint, GLint, GLsizei, GLsizei);
+	void bindUniformBuffer(GLuint);
+	void bindUniformRange(GLuint, GLuint, GLintptr, GLsizeiptr);
+	void bindImageTexture(GLuint, GLuint, GLenum, GLenum);
+	void renderPassInternal(pass&, passActions&);
+	void loadOutputs(const passActions&);
+	void storeOutputs(const passActions&);
+	void invalidateInputs(const passActions&);
+	void resolveActions(pass&, bool, pipeline*, std::map<long long, int>*, passActions&);
+	void planActions(pipeline&);
+	static bool hasDiscard(const std::string&);
+	void renderComputeInternal(pass&);
+	void renderLayersInternal(pass&, passActions&);
+	void drawLayers(pass&, passActions&);
+	bool initializeLayerProgram();
+	bool initializeBatchShaders();
+	void getPassSize(pass&, GLsizei&, GLsizei&);
+	void unmapStreamFile(stream&);
+	void resourceThreadMain(resourceContextCallback, void*);
+	void buildResource(resourceJob&);
+	bool publishResource(resourceJob&);
+	void deleteResource(resourceJob&);
+	readbackSlot* findReadback(int);
+	bool isReadbackReady(readbackSlot&);
+	void deleteReadbacks();
+	static int pixelSize(GLenum, GLenum);
+	GLenum imageFormat(GLuint);
+	void updateDrawBuffers(pass&);
 	bool verifyPipeline(std::vector<int>);
+	int createPipelineInternal(pipelineType);
+	bool resolvePipeline(pipeline&);
+	bool resolveGraph(pipeline&);
+	long long outputKey(pass&, int);
+	long long inputKey(pass&, int);
+	void planFusion(pipeline&);
+	void planBarriers(pipeline&);
+	void computeDamage(pipeline&, std::vector<damageRect>&);
+	static damageRect unionRect(const damageRect&, const damageRect&);
+	bool isPassChanged(pass&);
+	void changePass(pass&);
+	unsigned int pipelineVersion(pipeline&);
+	void markOutputsChanged(pass&);
+	void setupFrames(pipeline&);
+	void swapFrame(pipeline&, int);
+	void deleteFrames(pipeline&, bool);
+	bool isFrameDone(pipelineFrame&);
+	bool canReplay(pipeline&);
+	void bakePipeline(pipeline&);
+	bool replayPipeline(pipeline&);
+	static void addBakedCommand(bakedList&, bakedOp, GLuint, GLint, GLint, GLint);
+	bool buildFusedPass(fusedPass&, const std::string&, const std::vector<std::string>&);
+	void renderFusedInternal(fusedPass&, passActions&);
+	void flushFusedUniforms(fusedPass&);
+	timingFrame* beginTiming(pipeline&);
+	void recordTiming(timingFrame&, int);
+	void collectTimings(pipeline&);
+	void deleteTimings(pipeline&);
+	static void addTiming(timingHistory&, double);
+	static gpuTime getTiming(const timingHistory&);
+	static bool isSamplerType(GLenum);
+	static bool isImageType(GLenum);
+	static bool tokenizeShader(const std::string&, std::vector<std::string>&, std::vector<std::string>&);
+	static void splitShaderItems(const std::vector<std::string>&, std::vector<std::pair<size_t, size_t>>&);
+	static void shaderItemNames(const std::vector<std::string>&, size_t, size_t, std::vector<std::string>&, bool&);
+	static std::string joinShaderTokens(const std::vector<std::string>&);
+	static bool fuseShaderSources(const std::string&, const std::string&, const std::string&, const std::string&, std::string&);
+	bool allocateTransients(pipeline&);
+	void applyTransients(pipeline&);
+	static int bytesPerPixel(GLenum);
+	bool readShaderFile(char*, std::string&);
+	GLuint buildProgram(const char*, GLuint*, bool, bool);
+	void startProgram(const char*, programBuild&, bool, bool);
+	bool isProgramComplete(programBuild&);
+	GLuint finishProgram(programBuild&, GLuint*);
+	void installProgram(pass&, GLuint, GLuint, const std::string&);
+	int internSampler(const std::string&);
+	void setInputTexture(pass&, int, GLuint);
+	void updatePendingShader(pass&);
+	bool isRenderable(pass&);
+	void renderPassthroughInternal(pass&, passActions&);
+	void setupVertexInput(GLuint);
+	GLuint loadProgramBinary(const std::string&, const std::string&, double*);
+	void saveProgramBinary(GLuint, const std::string&, const std::string&, double);
+	static unsigned long long hashString(const std::string&);
+	static void hashBytes(unsigned long long&, const void*, size_t);
+	void deleteProgram(GLuint, GLuint);
+	void reflectUniforms(pass&);
+	void bindUniformBlocks(GLuint);
+	void updateUniformBlocks();
+	bool allocateUniformRing(GLsizeiptr);
+	void deleteUniformRing();
+	bool setUniformByName(int, char*, uniformKind, int, const void*);
+	bool setUniformByHandle(int, int, uniformKind, int, const void*);
+	void setUniformInternal(pass&, int, uniformKind, int, const void*);
+	void uploadUniformValue(GLuint, GLint, uniformKind, int, const void*);
+	void flushUniforms(pass&, GLuint);
 };
\ No newline at end of file
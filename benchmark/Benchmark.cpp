@@ -0,0 +1,468 @@
+#include "Compositor.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+//Headless benchmark of the compositor hot paths.
+//Each sweep varies one parameter of the base configuration, and every configuration reports CPU submission time per frame and per call,
+//state calls made by the compositor, and end-to-end throughput (including GPU time, the frame is finished with glFinish).
+//Usage : CompositorBenchmark [--quick] [--frames N] [--output file.json]
+
+//Contains one benchmark configuration
+struct benchConfig{
+	int passCount;			//passes created in the compositor
+	int pipelineLength;		//passes rendered by the pipeline, the first passCount passes
+	int outputCount;		//MRT outputs per pass
+	int inputCount;			//sampled textures per pass, the first one is the output of the previous pass
+	int resolution;			//width and height of all textures
+	int uniformUpdates;		//setUniformValue4f calls per pass per frame
+};
+
+//Contains the measurements of one configuration, times in microseconds
+struct benchResult{
+	double submitPerFrame;			//CPU time of the uniform updates and renderPipeline, without waiting for the GPU
+	double setUniformPerCall;
+	double renderPipelinePerCall;
+	double stateSaveRestorePerCall;	//renderPipeline of an empty pipeline, which only saves and restores OpenGL states
+	double framePerFrame;			//submission and glFinish
+	double framesPerSecond;
+	double megapixelsPerSecond;		//pixels written by all passes and outputs
+	double stateCallsPerFrame;		//state calls (including queries) made by the compositor
+	double stateCallsAvoidedPerFrame;
+};
+
+typedef std::chrono::steady_clock benchClock;
+
+static double microseconds(benchClock::time_point from, benchClock::time_point to)
+{
+	return std::chrono::duration<double, std::micro>(to - from).count();
+}
+
+///
+/// \brief To create a headless OpenGL context.
+/// To create an OpenGL context without window with EGL, on the surfaceless platform when available (Mesa), otherwise on the default display.
+///
+static bool createContext()
+{
+	EGLDisplay display = EGL_NO_DISPLAY;
+	const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (clientExtensions != NULL && strstr(clientExtensions, "EGL_MESA_platform_surfaceless") != NULL && getPlatformDisplay != NULL)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) return false;
+	if (!eglBindAPI(EGL_OPENGL_API)) return false;
+
+	EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config = NULL;
+	EGLint configCount = 0;
+	eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+
+	EGLint contextAttributes[] = { EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT, EGL_NONE };
+	EGLContext context = eglCreateContext(display, configCount > 0 ? config : NULL, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT) return false;
+
+	return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) == EGL_TRUE;
+}
+
+///
+/// \brief To generate the fragment shader of a configuration.
+/// To generate a fragment shader summing its inputs and uniforms into each of its outputs.
+///
+static std::string generateShader(const benchConfig& config)
+{
+	std::ostringstream source;
+	source << "#version 330\nin vec2 in_uv;\n";
+	for (int i = 0; i < config.inputCount; i++)
+		source << "uniform sampler2D tex" << i << ";\n";
+	source << "uniform vec4 scale;\n";
+	for (int i = 0; i < config.outputCount; i++)
+		source << "layout(location = " << i << ") out vec4 out" << i << ";\n";
+	source << "void main()\n{\n\tvec4 color = vec4(0.0);\n";
+	for (int i = 0; i < config.inputCount; i++)
+		source << "\tcolor += texture(tex" << i << ", in_uv);\n";
+	for (int i = 0; i < config.outputCount; i++)
+		source << "\tout" << i << " = color * scale * " << (i + 1) << ".0;\n";
+	source << "}\n";
+	return source.str();
+}
+
+static GLuint createTexture(int resolution)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, resolution, resolution, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return texture;
+}
+
+///
+/// \brief To run one configuration.
+/// To build the passes of a configuration in a new compositor, render warm-up frames, then measure the given number of frames.
+///
+static bool runConfig(const benchConfig& config, int frames, benchResult& result)
+{
+	Compositor* compositor = new Compositor();
+	compositor->setResolution(config.resolution, config.resolution);
+	std::string source = generateShader(config);
+
+	std::vector<GLuint> textures;
+	std::vector<int> passes;
+	std::vector<std::string> samplerNames(config.inputCount);
+	for (int i = 0; i < config.inputCount; i++)
+		samplerNames[i] = "tex" + std::to_string(i);
+	char scaleName[] = "scale";
+
+	bool ok = true;
+	GLuint previousOutput = createTexture(config.resolution);
+	textures.push_back(previousOutput);
+	for (int p = 0; p < config.passCount && ok; p++)
+	{
+		int pass = compositor->createNewPass();
+		passes.push_back(pass);
+		ok = compositor->loadShaderSource(pass, source.c_str());
+		for (int i = 0; i < config.inputCount && ok; i++)
+		{
+			GLuint input = i == 0 ? previousOutput : createTexture(config.resolution);
+			if (i != 0) textures.push_back(input);
+			ok = compositor->setUniformTexture(pass, (char*)samplerNames[i].c_str(), input);
+		}
+		for (int o = 0; o < config.outputCount && ok; o++)
+		{
+			GLuint output = createTexture(config.resolution);
+			textures.push_back(output);
+			ok = compositor->setOutputTexture(pass, o, output);
+			if (o == 0) previousOutput = output;
+		}
+		ok = ok && compositor->setUniformValue4f(pass, scaleName, 0.5f, 0.5f, 0.5f, 1.0f);
+	}
+
+	int pipeline = compositor->createSequentialPipeline();
+	int emptyPipeline = compositor->createSequentialPipeline();
+	ok = ok && compositor->setPipeline(pipeline, std::vector<int>(passes.begin(), passes.begin() + config.pipelineLength));
+	ok = ok && compositor->setPipeline(emptyPipeline, std::vector<int>());
+
+	double uniformTime = 0.0, renderTime = 0.0, frameTime = 0.0, stateTime = 0.0;
+	const int warmupFrames = 3;
+	for (int f = 0; f < warmupFrames + frames && ok; f++)
+	{
+		if (f == warmupFrames) compositor->resetStateStats();
+
+		benchClock::time_point start = benchClock::now();
+		for (int p = 0; p < config.pipelineLength; p++)
+			for (int u = 0; u < config.uniformUpdates; u++)
+				compositor->setUniformValue4f(passes[p], scaleName, 0.5f, 0.5f, 0.5f, (GLfloat)(f + u));
+		benchClock::time_point uniformsDone = benchClock::now();
+		ok = compositor->renderPipeline(pipeline);
+		benchClock::time_point renderDone = benchClock::now();
+		glFinish();
+		benchClock::time_point frameDone = benchClock::now();
+
+		if (f < warmupFrames) continue;
+		uniformTime += microseconds(start, uniformsDone);
+		renderTime += microseconds(uniformsDone, renderDone);
+		frameTime += microseconds(start, frameDone);
+	}
+	Compositor::stateStats stats = compositor->getStateStats();
+
+	const int stateRepeats = 1000;
+	benchClock::time_point stateStart = benchClock::now();
+	for (int r = 0; r < stateRepeats && ok; r++)
+		ok = compositor->renderPipeline(emptyPipeline);
+	stateTime = microseconds(stateStart, benchClock::now());
+
+	if (!ok) fprintf(stderr, "error 0x%x %s\n", compositor->getLastError(), compositor->getLastShaderError().c_str());
+
+	delete compositor;
+	glDeleteTextures((GLsizei)textures.size(), &textures[0]);
+	if (!ok) return false;
+
+	int uniformCalls = config.pipelineLength * config.uniformUpdates;
+	result.submitPerFrame = (uniformTime + renderTime) / frames;
+	result.setUniformPerCall = uniformCalls > 0 ? uniformTime / ((double)frames * uniformCalls) : 0.0;
+	result.renderPipelinePerCall = renderTime / frames;
+	result.stateSaveRestorePerCall = stateTime / stateRepeats;
+	result.framePerFrame = frameTime / frames;
+	result.framesPerSecond = 1000000.0 / result.framePerFrame;
+	result.megapixelsPerSecond = result.framesPerSecond * config.pipelineLength * config.outputCount * (double)config.resolution * config.resolution / 1000000.0;
+	result.stateCallsPerFrame = (double)stats.callsIssued / frames;
+	result.stateCallsAvoidedPerFrame = (double)stats.callsAvoided / frames;
+	return true;
+}
+
+///
+/// \brief To measure streaming uploads.
+/// To upload frames of the given resolution to a stream texture, returning the bandwidth in MB/s from the first to the last frame 
+/// (including GPU time, the uploads are finished with glFinish) and the frames dropped because the pixel buffers were busy.
+///
+static bool runStream(int resolution, int frames, double& megabytesPerSecond, unsigned long long& droppedFrames)
+{
+	Compositor* compositor = new Compositor();
+	int stream = compositor->createStreamTexture(resolution, resolution, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+	std::vector<unsigned char> frame((size_t)resolution * resolution * 4, 128);
+
+	benchClock::time_point start = benchClock::now();
+	for (int f = 0; f < frames && stream > 0; f++)
+		compositor->uploadStreamFrame(stream, &frame[0]);
+	glFinish();
+	double time = microseconds(start, benchClock::now());
+
+	Compositor::streamStats stats = compositor->getStreamStats(stream);
+	delete compositor;
+	if (stream <= 0) return false;
+
+	megabytesPerSecond = time > 0.0 ? stats.bytes / time : 0.0;
+	droppedFrames = stats.droppedFrames;
+	return true;
+}
+
+///
+/// \brief To measure batch processing.
+/// To process the given number of thumbnails of the given resolution with one pass, first one renderPipeline per image (rebinding 
+/// the input and output textures and setting the parameter of each image), then all at once with a batch pass reading and writing 
+/// array textures, with the parameters in a uniform block. Returns the images per second of both (including GPU time).
+///
+static bool runBatch(int images, int resolution, int frames, double& singleImagesPerSecond, double& batchImagesPerSecond)
+{
+	static const char* singleSource =
+		"#version 330\n"
+		"in vec2 in_uv;\n"
+		"uniform sampler2D src;\n"
+		"uniform vec4 scale;\n"
+		"layout(location = 0) out vec4 color;\n"
+		"void main() { color = texture(src, in_uv) * scale; }\n";
+	static const char* batchSource =
+		"#version 330\n"
+		"in vec2 in_uv;\n"
+		"flat in int in_layer;\n"
+		"uniform sampler2DArray src;\n"
+		"layout(std140) uniform Images { vec4 scale[256]; };\n"
+		"layout(location = 0) out vec4 color;\n"
+		"void main() { color = texture(src, vec3(in_uv, in_layer)) * scale[in_layer]; }\n";
+
+	Compositor* compositor = new Compositor();
+	compositor->setResolution(resolution, resolution);
+	std::vector<GLuint> textures;
+	for (int i = 0; i < images * 2; i++)
+		textures.push_back(createTexture(resolution));
+	GLuint arrays[2];
+	glGenTextures(2, arrays);
+	for (int i = 0; i < 2; i++)
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[i]);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, resolution, resolution, images, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	std::vector<GLfloat> scales(images * 4, 0.5f);
+	char srcName[] = "src", scaleName[] = "scale", blockName[] = "Images";
+
+	int single = compositor->createNewPass();
+	int batch = compositor->createBatchPass(images);
+	int block = compositor->createUniformBlock(blockName, images * 4 * sizeof(GLfloat));
+	int singlePipeline = compositor->createSequentialPipeline();
+	int batchPipeline = compositor->createSequentialPipeline();
+	bool ok = batch >= 0 && block >= 0 && images <= 256;
+	ok = ok && compositor->loadShaderSource(single, singleSource) && compositor->loadShaderSource(batch, batchSource);
+	ok = ok && compositor->setUniformTexture(single, srcName, textures[0]) && compositor->setOutputTexture(single, 0, textures[images]);
+	ok = ok && compositor->setUniformTexture(batch, srcName, arrays[0]) && compositor->setOutputTexture(batch, 0, arrays[1]);
+	ok = ok && compositor->setPipeline(singlePipeline, std::vector<int>(1, single)) && compositor->setPipeline(batchPipeline, std::vector<int>(1, batch));
+
+	double singleTime = 0.0, batchTime = 0.0;
+	const int warmupFrames = 3;
+	for (int f = 0; f < warmupFrames + frames && ok; f++)
+	{
+		benchClock::time_point start = benchClock::now();
+		for (int i = 0; i < images && ok; i++)
+		{
+			ok = compositor->setUniformTexture(single, srcName, textures[i]) && compositor->setOutputTexture(single, 0, textures[images + i]);
+			ok = ok && compositor->setUniformValue4f(single, scaleName, scales[i * 4], scales[i * 4 + 1], scales[i * 4 + 2], scales[i * 4 + 3]);
+			ok = ok && compositor->renderPipeline(singlePipeline);
+		}
+		glFinish();
+		benchClock::time_point singleDone = benchClock::now();
+		ok = ok && compositor->setUniformBlockData(block, 0, &scales[0], (int)(scales.size() * sizeof(GLfloat)));
+		ok = ok && compositor->renderPipeline(batchPipeline);
+		glFinish();
+		benchClock::time_point batchDone = benchClock::now();
+
+		if (f < warmupFrames) continue;
+		singleTime += microseconds(start, singleDone);
+		batchTime += microseconds(singleDone, batchDone);
+	}
+
+	if (!ok) fprintf(stderr, "error 0x%x %s\n", compositor->getLastError(), compositor->getLastShaderError().c_str());
+
+	delete compositor;
+	glDeleteTextures((GLsizei)textures.size(), &textures[0]);
+	glDeleteTextures(2, arrays);
+	if (!ok) return false;
+
+	singleImagesPerSecond = singleTime > 0.0 ? 1000000.0 * images * frames / singleTime : 0.0;
+	batchImagesPerSecond = batchTime > 0.0 ? 1000000.0 * images * frames / batchTime : 0.0;
+	return true;
+}
+
+static std::string jsonString(const char* str)
+{
+	std::string escaped = "\"";
+	for (; str != NULL && *str != '\0'; str++)
+	{
+		if (*str == '"' || *str == '\\') escaped += '\\';
+		if ((unsigned char)*str >= 0x20) escaped += *str;
+	}
+	return escaped + "\"";
+}
+
+int main(int argc, char** argv)
+{
+	bool quick = false;
+	int frames = 50;
+	const char* outputFile = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--quick") == 0) { quick = true; frames = 10; }
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) frames = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) outputFile = argv[++i];
+		else
+		{
+			fprintf(stderr, "usage : %s [--quick] [--frames N] [--output file.json]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (!createContext())
+	{
+		fprintf(stderr, "cannot create a headless OpenGL context with EGL\n");
+		return 1;
+	}
+
+	//each sweep varies one parameter of the base configuration
+	const benchConfig base = { 4, 4, 1, 1, 256, 1 };
+	struct sweep{
+		const char* name;
+		int benchConfig::*parameter;
+		std::vector<int> values;
+	};
+	std::vector<sweep> sweeps;
+	sweep passCount = { "pass_count", &benchConfig::passCount, quick ? std::vector<int>{ 4, 64 } : std::vector<int>{ 4, 16, 64, 256 } };
+	sweep pipelineLength = { "pipeline_length", &benchConfig::pipelineLength, quick ? std::vector<int>{ 1, 8 } : std::vector<int>{ 1, 4, 16, 64 } };
+	sweep outputCount = { "mrt_count", &benchConfig::outputCount, quick ? std::vector<int>{ 1, 4 } : std::vector<int>{ 1, 2, 4, 8 } };
+	sweep inputCount = { "input_count", &benchConfig::inputCount, quick ? std::vector<int>{ 1, 4 } : std::vector<int>{ 1, 2, 4, 8 } };
+	sweep resolution = { "resolution", &benchConfig::resolution, quick ? std::vector<int>{ 64, 512 } : std::vector<int>{ 64, 256, 1024, 2048 } };
+	sweep uniformUpdates = { "uniform_updates", &benchConfig::uniformUpdates, quick ? std::vector<int>{ 0, 16 } : std::vector<int>{ 0, 1, 4, 16, 64 } };
+	sweeps.push_back(passCount);
+	sweeps.push_back(pipelineLength);
+	sweeps.push_back(outputCount);
+	sweeps.push_back(inputCount);
+	sweeps.push_back(resolution);
+	sweeps.push_back(uniformUpdates);
+
+	std::ostringstream json;
+	json << "{\n";
+	json << "\t\"benchmark_version\": 1,\n";
+	json << "\t\"gl_vendor\": " << jsonString((const char*)glGetString(GL_VENDOR)) << ",\n";
+	json << "\t\"gl_renderer\": " << jsonString((const char*)glGetString(GL_RENDERER)) << ",\n";
+	json << "\t\"gl_version\": " << jsonString((const char*)glGetString(GL_VERSION)) << ",\n";
+	json << "\t\"frames\": " << frames << ",\n";
+	json << "\t\"results\": [";
+
+	bool ok = true, first = true;
+	for (size_t s = 0; s < sweeps.size(); s++)
+	{
+		for (size_t v = 0; v < sweeps[s].values.size(); v++)
+		{
+			benchConfig config = base;
+			config.*sweeps[s].parameter = sweeps[s].values[v];
+			if (sweeps[s].parameter == &benchConfig::pipelineLength) config.passCount = std::max(config.passCount, config.pipelineLength);
+			config.pipelineLength = std::min(config.pipelineLength, config.passCount);
+
+			benchResult result = benchResult();
+			if (!runConfig(config, frames, result))
+			{
+				fprintf(stderr, "%s = %d failed\n", sweeps[s].name, sweeps[s].values[v]);
+				ok = false;
+				continue;
+			}
+			fprintf(stderr, "%s = %d : %.1f us submit, %.1f fps\n", sweeps[s].name, sweeps[s].values[v], result.submitPerFrame, result.framesPerSecond);
+
+			json << (first ? "\n" : ",\n");
+			first = false;
+			json << "\t\t{ \"sweep\": \"" << sweeps[s].name << "\", \"value\": " << sweeps[s].values[v]
+				<< ", \"pass_count\": " << config.passCount << ", \"pipeline_length\": " << config.pipelineLength
+				<< ", \"mrt_count\": " << config.outputCount << ", \"input_count\": " << config.inputCount
+				<< ", \"resolution\": " << config.resolution << ", \"uniform_updates\": " << config.uniformUpdates << ",\n"
+				<< "\t\t  \"cpu_submit_us_per_frame\": " << result.submitPerFrame
+				<< ", \"set_uniform_value4f_us_per_call\": " << result.setUniformPerCall
+				<< ", \"render_pipeline_us_per_call\": " << result.renderPipelinePerCall
+				<< ", \"state_save_restore_us_per_call\": " << result.stateSaveRestorePerCall << ",\n"
+				<< "\t\t  \"state_calls_per_frame\": " << result.stateCallsPerFrame
+				<< ", \"state_calls_avoided_per_frame\": " << result.stateCallsAvoidedPerFrame
+				<< ", \"frame_us\": " << result.framePerFrame
+				<< ", \"frames_per_second\": " << result.framesPerSecond
+				<< ", \"megapixels_per_second\": " << result.megapixelsPerSecond << " }";
+		}
+	}
+	json << "\n\t],\n";
+
+	json << "\t\"stream_upload\": [";
+	first = true;
+	std::vector<int> streamResolutions = quick ? std::vector<int>{ 512 } : std::vector<int>{ 256, 1024, 2048 };
+	for (size_t r = 0; r < streamResolutions.size(); r++)
+	{
+		double bandwidth = 0.0;
+		unsigned long long dropped = 0;
+		if (!runStream(streamResolutions[r], frames * 4, bandwidth, dropped))
+		{
+			fprintf(stderr, "stream resolution = %d failed\n", streamResolutions[r]);
+			ok = false;
+			continue;
+		}
+		fprintf(stderr, "stream resolution = %d : %.1f MB/s upload\n", streamResolutions[r], bandwidth);
+		json << (first ? "\n" : ",\n") << "\t\t{ \"resolution\": " << streamResolutions[r]
+			<< ", \"upload_megabytes_per_second\": " << bandwidth << ", \"dropped_frames\": " << dropped << " }";
+		first = false;
+	}
+	json << "\n\t],\n";
+
+	json << "\t\"batch\": [";
+	first = true;
+	std::vector<int> batchSizes = quick ? std::vector<int>{ 64 } : std::vector<int>{ 16, 64, 256 };
+	for (size_t b = 0; b < batchSizes.size(); b++)
+	{
+		const int thumbnailResolution = 128;
+		double singleRate = 0.0, batchRate = 0.0;
+		if (!runBatch(batchSizes[b], thumbnailResolution, frames, singleRate, batchRate))
+		{
+			fprintf(stderr, "batch images = %d failed\n", batchSizes[b]);
+			ok = false;
+			continue;
+		}
+		fprintf(stderr, "batch images = %d : %.1f images/s one pass per image, %.1f images/s batched\n", batchSizes[b], singleRate, batchRate);
+		json << (first ? "\n" : ",\n") << "\t\t{ \"images\": " << batchSizes[b] << ", \"resolution\": " << thumbnailResolution
+			<< ", \"single_images_per_second\": " << singleRate << ", \"batch_images_per_second\": " << batchRate << " }";
+		first = false;
+	}
+	json << "\n\t]\n}\n";
+
+	if (outputFile != NULL)
+	{
+		std::ofstream file(outputFile, std::ios::out | std::ios::trunc);
+		file << json.str();
+	}
+	else printf("%s", json.str().c_str());
+
+	return ok ? 0 : 1;
+}